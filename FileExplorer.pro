@@ -3,11 +3,33 @@ CONFIG += c++17
 TEMPLATE = app
 TARGET = FileExplorer
 
+include(core.pri)
+
 SOURCES += \
+    commandline.cpp \
+    directorymodel.cpp \
+    iconcache.cpp \
     main.cpp \
     mainwindow.cpp \
-    propertiesdialog.cpp
+    pathcompleter.cpp \
+    perfpanel.cpp \
+    propertiesdialog.cpp \
+    searchresultsmodel.cpp \
+    stallwatchdog.cpp \
+    statuscounter.cpp \
+    thumbnailer.cpp \
+    transferpanel.cpp
 
 HEADERS += \
+    commandline.h \
+    directorymodel.h \
+    iconcache.h \
     mainwindow.h \
-    propertiesdialog.h
+    pathcompleter.h \
+    perfpanel.h \
+    propertiesdialog.h \
+    searchresultsmodel.h \
+    stallwatchdog.h \
+    statuscounter.h \
+    thumbnailer.h \
+    transferpanel.h
@@ -0,0 +1,28 @@
+QT += core gui widgets concurrent
+CONFIG += c++17 console
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = explorer-bench
+
+# The benchmarks build the explorer's own sources, not copies of them
+include(../core.pri)
+INCLUDEPATH += ..
+
+SOURCES += \
+    benchrunner.cpp \
+    main.cpp \
+    treegenerator.cpp \
+    ../directorymodel.cpp \
+    ../iconcache.cpp \
+    ../propertiesdialog.cpp \
+    ../searchresultsmodel.cpp \
+    ../statuscounter.cpp
+
+HEADERS += \
+    benchrunner.h \
+    treegenerator.h \
+    ../directorymodel.h \
+    ../iconcache.h \
+    ../propertiesdialog.h \
+    ../searchresultsmodel.h \
+    ../statuscounter.h
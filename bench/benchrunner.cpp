@@ -0,0 +1,107 @@
+#include "benchrunner.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QTextStream>
+
+#include <algorithm>
+
+double BenchResult::minMs() const
+{
+    return samplesMs.isEmpty() ? 0 : *std::min_element(samplesMs.begin(), samplesMs.end());
+}
+
+double BenchResult::medianMs() const
+{
+    if (samplesMs.isEmpty())
+        return 0;
+    QList<double> sorted = samplesMs;
+    std::sort(sorted.begin(), sorted.end());
+    const qsizetype middle = sorted.size() / 2;
+    return sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+}
+
+QJsonObject BenchResult::toJson() const
+{
+    QJsonArray samples;
+    for (double sample : samplesMs)
+        samples.append(sample);
+
+    const double median = medianMs();
+    QJsonObject object {
+        { "name", name },
+        { "unit", unit },
+        { "iterations", samplesMs.size() },
+        { "items", items },
+        { "min_ms", minMs() },
+        { "median_ms", median },
+        { "samples_ms", samples },
+        { "per_second", median > 0 ? items * 1000.0 / median : 0.0 }
+    };
+    if (!extra.isEmpty())
+        object.insert("extra", extra);
+    return object;
+}
+
+BenchRunner::BenchRunner(int iterations, const QStringList &filters)
+    : iterations(qMax(1, iterations)), filters(filters)
+{
+}
+
+bool BenchRunner::wants(const QString &name) const
+{
+    if (filters.isEmpty())
+        return true;
+    for (const QString &filter : filters) {
+        if (name.contains(filter))
+            return true;
+    }
+    return false;
+}
+
+void BenchRunner::run(const QString &name, const Body &body, const Setup &setup,
+                      const QString &unit)
+{
+    run(name, iterations, body, setup, unit);
+}
+
+void BenchRunner::run(const QString &name, int count, const Body &body, const Setup &setup,
+                      const QString &unit)
+{
+    if (!wants(name))
+        return;
+
+    BenchResult result;
+    result.name = name;
+    result.unit = unit;
+    for (int i = 0; i < count; ++i) {
+        if (setup)
+            setup();
+        QElapsedTimer timer;
+        timer.start();
+        result.items = body(result.extra);
+        result.samplesMs.append(timer.nsecsElapsed() / 1e6);
+    }
+
+    QTextStream(stderr) << QString("%1 %2 ms median, %3 %4")
+                               .arg(name, -32)
+                               .arg(result.medianMs(), 10, 'f', 2)
+                               .arg(result.items)
+                               .arg(unit)
+                        << Qt::endl;
+    done.append(result);
+}
+
+QJsonObject BenchRunner::report(const QJsonObject &environment) const
+{
+    QJsonArray results;
+    for (const BenchResult &result : done)
+        results.append(result.toJson());
+
+    return QJsonObject {
+        { "format", "explorer-bench" },
+        { "format_version", 1 },
+        { "environment", environment },
+        { "results", results }
+    };
+}
@@ -0,0 +1,57 @@
+#ifndef BENCHRUNNER_H
+#define BENCHRUNNER_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+struct BenchResult
+{
+    QString name;
+    QString unit = "items";
+    QList<double> samplesMs;
+    qint64 items = 0;          // per iteration
+    QJsonObject extra;         // whatever else the case wants to keep
+
+    double minMs() const;
+    double medianMs() const;
+    QJsonObject toJson() const;
+};
+
+// Times benchmark cases and collects their results.
+//
+// Each case runs a fixed number of iterations; setup work runs before
+// every iteration but outside the timing. The median is the headline
+// number, with every sample kept in the report so noise can be judged.
+// Results are written as one JSON document, meant to be stored per
+// release and compared.
+class BenchRunner
+{
+public:
+    // The body returns how many items it handled; it may fill in extra
+    using Body = std::function<qint64(QJsonObject &extra)>;
+    using Setup = std::function<void()>;
+
+    BenchRunner(int iterations, const QStringList &filters);
+
+    // Whether name passes the filters; cases skip their own setup if not
+    bool wants(const QString &name) const;
+
+    void run(const QString &name, const Body &body, const Setup &setup = {},
+             const QString &unit = "items");
+    void run(const QString &name, int iterations, const Body &body, const Setup &setup = {},
+             const QString &unit = "items");
+
+    const QList<BenchResult> &results() const { return done; }
+    QJsonObject report(const QJsonObject &environment) const;
+
+private:
+    int iterations;
+    QStringList filters;
+    QList<BenchResult> done;
+};
+
+#endif
@@ -0,0 +1,547 @@
+#include "benchrunner.h"
+#include "treegenerator.h"
+
+#include "directorymodel.h"
+#include "entrysorter.h"
+#include "entrytable.h"
+#include "fastcopy.h"
+#include "iconcache.h"
+#include "parallelwalker.h"
+#include "propertiesdialog.h"
+#include "searchengine.h"
+#include "searchresultsmodel.h"
+#include "sizecalculator.h"
+#include "smallfilecopy.h"
+#include "statuscounter.h"
+#include "transferengine.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileIconProvider>
+#include <QFileSystemModel>
+#include <QJsonDocument>
+#include <QStandardItemModel>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+
+#include <atomic>
+#include <random>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int TimeoutMs = 10 * 60 * 1000;
+
+// Runs loop until something quits it; false if it timed out instead
+bool exec(QEventLoop &loop)
+{
+    QTimer::singleShot(TimeoutMs, &loop, [&loop]() { loop.exit(1); });
+    return loop.exec() == 0;
+}
+
+// Resident set size, for a rough view of what a model holds; -1 if unknown
+qint64 residentBytes()
+{
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+// An empty folder under the hidden work area, which walks skip
+QString scratch(const QString &root, const QString &name)
+{
+    const QString path = root + "/.work/" + name;
+    QDir(path).removeRecursively();
+    QDir().mkpath(path);
+    return path;
+}
+
+// The copy the main window did before transfers had an engine, kept as
+// the baseline the engine has to beat
+bool copyRecursively(const QString &sourcePath, const QString &destinationPath)
+{
+    QDir sourceDir(sourcePath);
+    if (!sourceDir.exists())
+        return false;
+
+    QDir destDir(destinationPath);
+    if (!destDir.exists() && !destDir.mkpath("."))
+        return false;
+
+    const QFileInfoList entries = sourceDir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllEntries);
+    for (const QFileInfo &entry : entries) {
+        const QString srcPath = entry.absoluteFilePath();
+        const QString destPath = destinationPath + "/" + entry.fileName();
+        if (entry.isDir()) {
+            if (!copyRecursively(srcPath, destPath))
+                return false;
+        } else {
+            if (QFile::exists(destPath))
+                QFile::remove(destPath);
+            if (!QFile::copy(srcPath, destPath))
+                return false;
+        }
+    }
+    return true;
+}
+
+qint64 entriesIn(const TreeGenerator &tree, std::initializer_list<TreeGenerator::Shape> shapes)
+{
+    qint64 entries = 0;
+    for (TreeGenerator::Shape shape : shapes)
+        entries += tree.stats(shape).files + tree.stats(shape).folders;
+    return entries;
+}
+
+//-------------------------------------------
+// Search and walking
+//-------------------------------------------
+
+void benchSearch(BenchRunner &runner, const TreeGenerator &tree, const QString &root)
+{
+    // The walker path startSearch takes when the folder has no index
+    auto search = [](const QString &path, SearchEngine::Mode mode, qint64 entries) {
+        return [path, mode, entries](QJsonObject &extra) -> qint64 {
+            SearchEngine engine;
+            QEventLoop loop;
+            qint64 hits = 0;
+            QObject::connect(&engine, &SearchEngine::resultsReady, &loop,
+                             [&hits](quint64, const QList<SearchHit> &batch) {
+                hits += batch.size();
+            });
+            QObject::connect(&engine, &SearchEngine::finished, &loop, [&loop]() { loop.quit(); });
+            engine.start(path, TreeGenerator::needle(), mode);
+            extra["completed"] = exec(loop);
+            extra["hits"] = hits;
+            return entries;
+        };
+    };
+
+    using Shape = TreeGenerator::Shape;
+    runner.run("search.name", search(root, SearchEngine::NameSearch,
+                                     entriesIn(tree, { Shape::Wide, Shape::Deep, Shape::Tiny,
+                                                       Shape::Huge })));
+    runner.run("search.content", search(tree.path(Shape::Tiny), SearchEngine::ContentSearch,
+                                        tree.stats(Shape::Tiny).files));
+
+    // Thread scaling of the walker on its own, one to all cores
+    QList<int> counts;
+    for (int threads = 1; threads < QThread::idealThreadCount(); threads *= 2)
+        counts.append(threads);
+    counts.append(QThread::idealThreadCount());
+
+    for (int threads : std::as_const(counts)) {
+        runner.run(QString("walker.threads.%1").arg(threads), [root, threads](QJsonObject &) {
+            std::atomic<qint64> entries { 0 };
+            ParallelWalker walker(threads);
+            walker.walk({ root }, [&entries](const WalkEntry &) {
+                ++entries;
+                return true;
+            });
+            return entries.load();
+        });
+    }
+}
+
+//-------------------------------------------
+// Listing models and status bar counts
+//-------------------------------------------
+
+void benchModels(BenchRunner &runner, const TreeGenerator &tree)
+{
+    const QString wide = tree.path(TreeGenerator::Wide);
+    const qint64 expected = tree.stats(TreeGenerator::Wide).topLevel;
+
+    runner.run("model.load.filesystemmodel", [&](QJsonObject &extra) {
+        const qint64 before = residentBytes();
+        QFileSystemModel model;
+        QEventLoop loop;
+        QModelIndex root;
+        QObject::connect(&model, &QFileSystemModel::rowsInserted, &loop,
+                         [&](const QModelIndex &parent) {
+            if (parent == root && model.rowCount(root) >= expected)
+                loop.quit();
+        });
+        root = model.setRootPath(wide);
+        extra["completed"] = exec(loop);
+        extra["rss_delta_bytes"] = before < 0 ? -1 : residentBytes() - before;
+        return qint64(model.rowCount(root));
+    });
+
+    runner.run("model.load.compact", [&](QJsonObject &extra) {
+        const qint64 before = residentBytes();
+        DirectoryModel model;
+        QEventLoop loop;
+        QObject::connect(&model, &DirectoryModel::firstRowsShown, &loop, [&](qint64 ms) {
+            extra["first_rows_ms"] = ms;
+        });
+        QObject::connect(&model, &DirectoryModel::loadFinished, &loop, [&](int, qint64 ms) {
+            extra["load_ms"] = ms;
+        });
+        QObject::connect(&model, &DirectoryModel::sortFinished, &loop, [&](int, qint64 ms) {
+            extra["sort_ms"] = ms;
+            loop.quit();
+        });
+        model.setRootPath(wide);
+        extra["completed"] = exec(loop);
+        extra["rss_delta_bytes"] = before < 0 ? -1 : residentBytes() - before;
+        extra["bytes_per_entry"] = model.rowCount() ? model.memoryUsage() / model.rowCount() : 0;
+        return qint64(model.rowCount());
+    });
+
+    // What updateStatusBar reads in each mode
+    runner.run("status.count.filesystemmodel", [&](QJsonObject &extra) {
+        QFileSystemModel model;
+        StatusCounter counter(&model);
+        QEventLoop loop;
+        QObject::connect(&counter, &StatusCounter::countsChanged, &loop, [&]() {
+            if (counter.counts().items >= expected)
+                loop.quit();
+        });
+        model.setRootPath(wide);
+        counter.setRootPath(wide);
+        extra["completed"] = exec(loop);
+        extra["bytes"] = counter.counts().bytes;
+        return qint64(counter.counts().items);
+    });
+
+    {
+        DirectoryModel model;
+        QEventLoop loop;
+        QObject::connect(&model, &DirectoryModel::sortFinished, &loop, [&loop]() { loop.quit(); });
+        model.setRootPath(wide);
+        exec(loop);
+
+        runner.run("status.count.compact", [&](QJsonObject &extra) {
+            const StatusCounts counts = model.counts();
+            extra["bytes"] = counts.bytes;
+            return qint64(counts.items);
+        });
+
+        int flip = 0;
+        runner.run("model.sort.compact", [&](QJsonObject &) {
+            model.sortBy(DirectoryModel::BySize, flip++ % 2 ? Qt::AscendingOrder : Qt::DescendingOrder);
+            exec(loop);
+            return qint64(model.rowCount());
+        });
+    }
+
+    {
+        QFileSystemModel model;
+        QEventLoop loop;
+        QModelIndex root;
+        QObject::connect(&model, &QFileSystemModel::directoryLoaded, &loop, [&loop]() { loop.quit(); });
+        root = model.setRootPath(wide);
+        exec(loop);
+
+        int flip = 0;
+        runner.run("model.sort.filesystemmodel", [&](QJsonObject &) {
+            model.sort(1, flip++ % 2 ? Qt::AscendingOrder : Qt::DescendingOrder);
+            return qint64(model.rowCount(root));
+        });
+    }
+}
+
+//-------------------------------------------
+// In-memory work: sorting, search rows, icons
+//-------------------------------------------
+
+void benchMemory(BenchRunner &runner, const TreeGenerator &tree, int scale)
+{
+    if (runner.wants("sort.entries")) {
+        // A million names like a camera folder, with folders mixed in
+        EntryTable table;
+        std::mt19937 random(7);
+        for (int i = 0; i < 1000000; ++i) {
+            const QByteArray name = "IMG_" + QByteArray::number(random() % 5000000)
+                                    + (i % 3 ? ".jpg" : ".png");
+            table.append(name.constData(), size_t(name.size()), qint64(random() % 10000000),
+                         1600000000 + qint64(random() % 100000000),
+                         i % 50 == 0 ? quint64(EntryTable::Dir) : 0);
+        }
+
+        const SortSpec byName { { SortField::FoldersFirst }, { SortField::Name } };
+        runner.run("sort.entries.name", [&](QJsonObject &) {
+            return qint64(EntrySorter::sort(table, byName).size());
+        });
+        const SortSpec bySize { { SortField::FoldersFirst }, { SortField::Size },
+                                { SortField::Name } };
+        runner.run("sort.entries.size", [&](QJsonObject &) {
+            return qint64(EntrySorter::sort(table, bySize).size());
+        });
+    }
+
+    if (runner.wants("search.fill")) {
+        QList<QList<SearchHit>> batches;
+        const int hits = 200000 * scale;
+        for (int i = 0; i < hits; ++i) {
+            if (i % 500 == 0)
+                batches.append(QList<SearchHit>());
+            SearchHit hit;
+            hit.info = QFileInfo(QString("/data/photos/%1/IMG_needle_%2.jpg").arg(2000 + i % 24).arg(i));
+            hit.isDir = i % 40 == 0;
+            batches.last().append(hit);
+        }
+
+        runner.run("search.fill", [&](QJsonObject &) {
+            SearchResultsModel model;
+            model.clear(TreeGenerator::needle());
+            for (const QList<SearchHit> &batch : std::as_const(batches))
+                model.append(batch);
+            return qint64(model.rowCount());
+        });
+
+        // What the results list used to do: an item and a provider icon per hit
+        runner.run("search.fill.standarditemmodel", [&](QJsonObject &) {
+            QStandardItemModel model;
+            QFileIconProvider provider;
+            for (const QList<SearchHit> &batch : std::as_const(batches)) {
+                for (const SearchHit &hit : batch) {
+                    QStandardItem *item = new QStandardItem(provider.icon(hit.info),
+                                                            hit.info.fileName());
+                    item->setData(hit.info.absoluteFilePath(), Qt::UserRole);
+                    item->setData(TreeGenerator::needle(), Qt::UserRole + 1);
+                    model.appendRow(item);
+                }
+            }
+            return qint64(model.rowCount());
+        });
+    }
+
+    if (runner.wants("icons.lookup")) {
+        QDir dir(tree.path(TreeGenerator::Wide));
+        const QFileInfoList entries = dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot);
+
+        // The first run fills the caches; later ones show the steady state
+        runner.run("icons.lookup", [&](QJsonObject &extra) {
+            qint64 found = 0;
+            for (const QFileInfo &entry : entries)
+                found += !IconCache::forEntry(entry.fileName(), entry.isDir()).isNull();
+            extra["with_icon"] = found;
+            return qint64(entries.size());
+        });
+
+        runner.run("icons.lookup.iconprovider", [&](QJsonObject &extra) {
+            QFileIconProvider provider;
+            qint64 found = 0;
+            for (const QFileInfo &entry : entries)
+                found += !provider.icon(entry).isNull();
+            extra["with_icon"] = found;
+            return qint64(entries.size());
+        });
+    }
+}
+
+//-------------------------------------------
+// Copying
+//-------------------------------------------
+
+void benchCopy(BenchRunner &runner, const TreeGenerator &tree, const QString &root)
+{
+    const QString tiny = tree.path(TreeGenerator::Tiny);
+    const qint64 tinyFiles = tree.stats(TreeGenerator::Tiny).files;
+
+    QString target;
+    auto freshTarget = [&](const QString &name) {
+        return [&target, &root, name]() { target = scratch(root, name); };
+    };
+
+    runner.run("copy.recursive.baseline", [&](QJsonObject &extra) {
+        extra["ok"] = copyRecursively(tiny, target + "/tiny");
+        return tinyFiles;
+    }, freshTarget("baseline"));
+
+    runner.run("copy.engine.tiny", [&](QJsonObject &extra) {
+        TransferEngine engine;
+        QEventLoop loop;
+        QObject::connect(&engine, &TransferEngine::jobProgress, &loop,
+                         [&](int, const TransferProgress &progress) {
+            extra["methods"] = progress.methods.join(",");
+        });
+        QObject::connect(&engine, &TransferEngine::jobFinished, &loop,
+                         [&](int, bool success) {
+            extra["ok"] = success;
+            loop.quit();
+        });
+        engine.enqueue(TransferEngine::Copy, { tiny }, target);
+        exec(loop);
+        return tinyFiles;
+    }, freshTarget("engine"));
+
+    if (runner.wants("copy.smallfiles")) {
+        QStringList sources;
+        QDirIterator it(tiny, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            sources.append(it.next());
+
+        QList<SmallFileCopy::Task> tasks;
+
+        runner.run("copy.smallfiles", [&](QJsonObject &extra) {
+            SmallFileCopy copier;
+            extra["ok"] = copier.copy(tasks, [](int, bool, qint64) { return true; });
+            extra["backend"] = SmallFileCopy::backendName(copier.backend());
+            return qint64(tasks.size());
+        }, [&]() {
+            // The copier wants target folders made beforehand
+            const QString dest = scratch(root, "smallfiles");
+            tasks.clear();
+            for (const QString &source : std::as_const(sources)) {
+                const QString target = dest + source.mid(tiny.size());
+                QDir().mkpath(QFileInfo(target).path());
+                tasks.append({ source, target });
+            }
+        });
+    }
+
+    const QString huge = tree.path(TreeGenerator::Huge);
+    const QStringList hugeFiles = QDir(huge).entryList(QDir::Files, QDir::Name);
+    runner.run("copy.fastcopy.huge", [&](QJsonObject &extra) {
+        FastCopy::Method method = FastCopy::NoMethod;
+        bool ok = true;
+        for (const QString &name : hugeFiles) {
+            ok &= FastCopy::copyFile(huge + "/" + name, target + "/" + name,
+                                     [](qint64, FastCopy::Method) { return true; }, &method);
+        }
+        extra["ok"] = ok;
+        extra["method"] = FastCopy::methodName(method);
+        return tree.stats(TreeGenerator::Huge).bytes;
+    }, freshTarget("huge"), "bytes");
+}
+
+//-------------------------------------------
+// Properties
+//-------------------------------------------
+
+void benchProperties(BenchRunner &runner, const TreeGenerator &tree, const QString &root)
+{
+    const QString wide = tree.path(TreeGenerator::Wide);
+    QStringList files;
+    QDirIterator it(wide, QDir::Files);
+    while (it.hasNext() && files.size() < 1000)
+        files.append(it.next());
+
+    runner.run("properties.file", [&](QJsonObject &) {
+        for (int i = 0; i < 100; ++i) {
+            PropertiesDialog dialog(files.value(i));
+        }
+        return qint64(100);
+    });
+
+    runner.run("properties.folder", [&](QJsonObject &) {
+        PropertiesDialog dialog(wide);
+        return qint64(1);
+    });
+
+    runner.run("properties.selection", [&](QJsonObject &) {
+        PropertiesDialog dialog(files);
+        return qint64(files.size());
+    });
+
+    // The background part of a folder's properties; runs after the first
+    // come from the size cache
+    runner.run("size.tree", [&](QJsonObject &extra) {
+        SizeCalculator calculator;
+        QEventLoop loop;
+        qint64 entries = 0;
+        QObject::connect(&calculator, &SizeCalculator::finished, &loop,
+                         [&](const FolderSize &size, bool fromCache) {
+            entries = size.files + size.folders;
+            extra["from_cache"] = fromCache;
+            loop.quit();
+        });
+        calculator.start(root);
+        exec(loop);
+        return entries;
+    });
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Dialogs and models need a GUI application, but never a screen
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    // Keeps the size cache and the rest apart from the real app's
+    app.setApplicationName("explorer-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks for File Explorer's hot paths");
+    parser.addHelpOption();
+    const QCommandLineOption rootOption("root", "Folder for the synthetic tree.", "path",
+                                        QDir::tempPath() + "/explorer-bench-tree");
+    const QCommandLineOption scaleOption("scale", "Tree size multiplier.", "n", "1");
+    const QCommandLineOption iterationsOption("iterations", "Runs per case.", "n", "5");
+    const QCommandLineOption outputOption("output", "JSON results file.", "file",
+                                          "bench-results.json");
+    parser.addOptions({ rootOption, scaleOption, iterationsOption, outputOption });
+    parser.addPositionalArgument("filter", "Only run cases whose name contains one of these.",
+                                 "[filter...]");
+    parser.process(app);
+
+    const int scale = qMax(1, parser.value(scaleOption).toInt());
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    const QString root = QDir(parser.value(rootOption)).absolutePath();
+
+    QTextStream err(stderr);
+    err << "Preparing tree in " << root << Qt::endl;
+    TreeGenerator tree(scale);
+    QElapsedTimer clock;
+    clock.start();
+    if (!tree.ensure(root)) {
+        err << "Could not create the tree in " << root << Qt::endl;
+        return 1;
+    }
+    err << "Tree ready after " << clock.elapsed() << " ms" << Qt::endl;
+
+    BenchRunner runner(iterations, parser.positionalArguments());
+    benchSearch(runner, tree, root);
+    benchModels(runner, tree);
+    benchMemory(runner, tree, scale);
+    benchCopy(runner, tree, root);
+    benchProperties(runner, tree, root);
+    QDir(root + "/.work").removeRecursively();
+
+    const QJsonObject environment {
+        { "timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate) },
+        { "qt", QString::fromLatin1(qVersion()) },
+        { "os", QSysInfo::prettyProductName() },
+        { "kernel", QSysInfo::kernelVersion() },
+        { "cpu", QSysInfo::currentCpuArchitecture() },
+        { "threads", QThread::idealThreadCount() },
+        { "io_uring", SmallFileCopy::ioUringAvailable() },
+        { "iterations", iterations },
+        { "root", root },
+        { "tree", tree.toJson() }
+    };
+
+    QFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly)) {
+        err << "Could not write " << out.fileName() << Qt::endl;
+        return 1;
+    }
+    out.write(QJsonDocument(runner.report(environment)).toJson());
+    err << "Results written to " << out.fileName() << Qt::endl;
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include "treegenerator.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+
+#include <cstring>
+#include <random>
+
+namespace {
+
+const int TreeVersion = 1;
+const quint32 Seed = 20240601;
+const char MarkerName[] = ".bench-tree.json";
+
+const char *const Words[] = {
+    "alpha", "branch", "cache", "delta", "engine", "folder", "green", "harbor",
+    "index", "jungle", "kernel", "ladder", "matrix", "north", "orbit", "pixel",
+    "quartz", "river", "signal", "timber", "update", "vector", "window", "yellow"
+};
+
+const char *const Prefixes[] = {
+    "report", "IMG", "notes", "build", "data", "photo", "draft", "log"
+};
+
+const char *const Suffixes[] = {
+    "txt", "jpg", "cpp", "md", "log", "png", "pdf", ""
+};
+
+template<typename T, size_t N>
+const T &pick(std::mt19937 &random, const T (&items)[N])
+{
+    return items[random() % N];
+}
+
+// Mixed prefixes, suffixes and number widths, so sorting by name, type
+// and numbers all have work to do
+QString fileName(std::mt19937 &random, qint64 number)
+{
+    QString name = QString::fromLatin1(pick(random, Prefixes));
+    if (number % 97 == 0)
+        name += "_" + TreeGenerator::needle();
+    name += "_" + QString::number(number);
+    const QString suffix = QString::fromLatin1(pick(random, Suffixes));
+    if (!suffix.isEmpty())
+        name += "." + suffix;
+    return name;
+}
+
+QByteArray text(std::mt19937 &random, int bytes, bool withNeedle)
+{
+    QByteArray data;
+    data.reserve(bytes + 64);
+    int line = 0;
+    while (data.size() < bytes) {
+        if (withNeedle && line == 7)
+            data += "the " + TreeGenerator::needle().toLatin1() + " is on this line";
+        for (int word = 0; word < 8; ++word) {
+            data += pick(random, Words);
+            data += ' ';
+        }
+        data += '\n';
+        ++line;
+    }
+    data.truncate(bytes);
+    return data;
+}
+
+bool writeFile(const QString &path, const QByteArray &data, TreeStats &stats)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+        return false;
+    ++stats.files;
+    stats.bytes += data.size();
+    return true;
+}
+
+bool makeDir(const QString &path, TreeStats &stats)
+{
+    if (!QDir().mkpath(path))
+        return false;
+    ++stats.folders;
+    return true;
+}
+
+} // namespace
+
+QJsonObject TreeStats::toJson() const
+{
+    return QJsonObject {
+        { "files", files },
+        { "folders", folders },
+        { "bytes", bytes },
+        { "top_level", topLevel }
+    };
+}
+
+TreeStats TreeStats::fromJson(const QJsonObject &object)
+{
+    TreeStats stats;
+    stats.files = object.value("files").toInteger();
+    stats.folders = object.value("folders").toInteger();
+    stats.bytes = object.value("bytes").toInteger();
+    stats.topLevel = object.value("top_level").toInteger();
+    return stats;
+}
+
+TreeGenerator::TreeGenerator(int scale)
+    : scale(qMax(1, scale))
+{
+}
+
+QString TreeGenerator::shapeName(Shape shape)
+{
+    switch (shape) {
+    case Wide:
+        return "wide";
+    case Deep:
+        return "deep";
+    case Tiny:
+        return "tiny";
+    case Huge:
+        return "huge";
+    }
+    return QString();
+}
+
+QString TreeGenerator::path(Shape shape) const
+{
+    return root + "/" + shapeName(shape);
+}
+
+QJsonObject TreeGenerator::toJson() const
+{
+    QJsonObject shapes;
+    for (int shape = 0; shape < ShapeCount; ++shape)
+        shapes.insert(shapeName(Shape(shape)), shapeStats[shape].toJson());
+    return QJsonObject {
+        { "version", TreeVersion },
+        { "scale", scale },
+        { "shapes", shapes }
+    };
+}
+
+bool TreeGenerator::ensure(const QString &rootPath)
+{
+    root = QDir::cleanPath(QDir(rootPath).absolutePath());
+    const QString marker = root + "/" + MarkerName;
+
+    QFile existing(marker);
+    if (existing.open(QIODevice::ReadOnly)) {
+        const QJsonObject saved = QJsonDocument::fromJson(existing.readAll()).object();
+        if (saved.value("version").toInt() == TreeVersion && saved.value("scale").toInt() == scale) {
+            const QJsonObject shapes = saved.value("shapes").toObject();
+            for (int shape = 0; shape < ShapeCount; ++shape)
+                shapeStats[shape] = TreeStats::fromJson(shapes.value(shapeName(Shape(shape))).toObject());
+            return true;
+        }
+        existing.close();
+        existing.remove();
+    }
+
+    for (int shape = 0; shape < ShapeCount; ++shape) {
+        const QString dir = path(Shape(shape));
+        QDir(dir).removeRecursively();
+        shapeStats[shape] = TreeStats();
+        if (!generate(Shape(shape), dir, shapeStats[shape]))
+            return false;
+    }
+
+    QFile out(marker);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+    out.write(QJsonDocument(toJson()).toJson());
+    return true;
+}
+
+bool TreeGenerator::generate(Shape shape, const QString &dir, TreeStats &stats) const
+{
+    std::mt19937 random(Seed + quint32(shape));
+    if (!QDir().mkpath(dir))
+        return false;
+
+    switch (shape) {
+    case Wide: {
+        const qint64 files = 20000LL * scale;
+        const qint64 folders = 200LL * scale;
+        for (qint64 i = 0; i < folders; ++i) {
+            if (!makeDir(dir + "/" + fileName(random, i).section('.', 0, 0) + "_dir", stats))
+                return false;
+        }
+        for (qint64 i = 0; i < files; ++i) {
+            if (!writeFile(dir + "/" + fileName(random, i),
+                           text(random, int(random() % 512), false), stats))
+                return false;
+        }
+        stats.topLevel = files + folders;
+        return true;
+    }
+    case Deep: {
+        const int branches = 8;
+        const int depth = 48;
+        const int filesPerLevel = 4 * scale;
+        qint64 number = 0;
+        for (int branch = 0; branch < branches; ++branch) {
+            QString level = dir + "/branch" + QString::number(branch);
+            for (int d = 0; d < depth; ++d) {
+                if (!makeDir(level, stats))
+                    return false;
+                for (int i = 0; i < filesPerLevel; ++i) {
+                    if (!writeFile(level + "/" + fileName(random, number++),
+                                   text(random, 256, false), stats))
+                        return false;
+                }
+                level += "/level" + QString::number(d + 1);
+            }
+        }
+        stats.topLevel = branches;
+        return true;
+    }
+    case Tiny: {
+        const int folders = 100 * scale;
+        const int filesPerFolder = 100;
+        qint64 number = 0;
+        for (int folder = 0; folder < folders; ++folder) {
+            const QString sub = dir + "/set" + QString::number(folder);
+            if (!makeDir(sub, stats))
+                return false;
+            for (int i = 0; i < filesPerFolder; ++i, ++number) {
+                const int bytes = 1024 + int(random() % 3072);
+                if (!writeFile(sub + "/" + fileName(random, number),
+                               text(random, bytes, number % 50 == 0), stats))
+                    return false;
+            }
+        }
+        stats.topLevel = folders;
+        return true;
+    }
+    case Huge: {
+        const int files = 3;
+        const qint64 bytes = 32LL * 1024 * 1024 * scale;
+        QByteArray block(1024 * 1024, Qt::Uninitialized);
+        for (int i = 0; i < files; ++i) {
+            QFile file(dir + "/huge" + QString::number(i) + ".bin");
+            if (!file.open(QIODevice::WriteOnly))
+                return false;
+            for (qint64 written = 0; written < bytes; written += block.size()) {
+                for (qsizetype b = 0; b < block.size(); b += 4) {
+                    const quint32 value = random();
+                    memcpy(block.data() + b, &value, 4);
+                }
+                if (file.write(block) != block.size())
+                    return false;
+            }
+            ++stats.files;
+            stats.bytes += bytes;
+        }
+        stats.topLevel = files;
+        return true;
+    }
+    }
+    return false;
+}
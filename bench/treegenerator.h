@@ -0,0 +1,58 @@
+#ifndef TREEGENERATOR_H
+#define TREEGENERATOR_H
+
+#include <QJsonObject>
+#include <QString>
+
+struct TreeStats
+{
+    qint64 files = 0;
+    qint64 folders = 0;
+    qint64 bytes = 0;
+    qint64 topLevel = 0;      // entries directly in the shape's folder
+
+    QJsonObject toJson() const;
+    static TreeStats fromJson(const QJsonObject &object);
+};
+
+// Builds the synthetic trees the benchmarks run on.
+//
+// Every shape comes from a fixed seed, so two runs at the same scale see
+// the same names, sizes and contents, on any machine:
+//
+//   wide  - one folder with tens of thousands of entries
+//   deep  - a few narrow branches nested dozens of levels down
+//   tiny  - many folders of 1-4 KiB text files, for copy and content search
+//   huge  - a few files of tens of MiB
+//
+// Roughly one name in a hundred contains needle(), and one tiny file in
+// fifty contains it in a line of text, so searches have a known number
+// of hits. A finished tree is recorded in a hidden marker file and kept
+// for later runs at the same scale.
+class TreeGenerator
+{
+public:
+    enum Shape { Wide, Deep, Tiny, Huge };
+    static constexpr int ShapeCount = 4;
+
+    explicit TreeGenerator(int scale = 1);
+
+    // Builds every shape below root, unless a run at this scale already did
+    bool ensure(const QString &root);
+
+    QString path(Shape shape) const;
+    TreeStats stats(Shape shape) const { return shapeStats[shape]; }
+    QJsonObject toJson() const;
+
+    static QString shapeName(Shape shape);
+    static QString needle() { return "needle"; }
+
+private:
+    bool generate(Shape shape, const QString &dir, TreeStats &stats) const;
+
+    int scale;
+    QString root;
+    TreeStats shapeStats[ShapeCount];
+};
+
+#endif
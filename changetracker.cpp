@@ -0,0 +1,387 @@
+#include "changetracker.h"
+#include "parallelwalker.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QtConcurrent>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+
+// Long enough to fold a burst into one ChangeSet, short enough to feel live
+const int FlushDelayMs = 250;
+
+#ifdef Q_OS_LINUX
+const uint32_t WatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                           | IN_CLOSE_WRITE | IN_ATTRIB | IN_ONLYDIR;
+
+qint64 directoryMTime(const QString &path)
+{
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0)
+        return -1;
+    return qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+#endif
+
+bool isUnder(const QString &path, const QString &dir)
+{
+    return path == dir || path.startsWith(dir.endsWith('/') ? dir : dir + "/");
+}
+
+} // namespace
+
+ChangeTracker::ChangeTracker(QObject *parent)
+    : QObject(parent)
+{
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FlushDelayMs);
+    connect(flushTimer, &QTimer::timeout, this, &ChangeTracker::flush);
+
+#ifdef Q_OS_LINUX
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0) {
+        notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated,
+                this, &ChangeTracker::readEvents);
+    }
+#endif
+}
+
+ChangeTracker::~ChangeTracker()
+{
+    stopping = true;
+    for (QFuture<void> &job : jobs)
+        job.waitForFinished();
+
+#ifdef Q_OS_LINUX
+    if (fd >= 0)
+        ::close(fd);
+#endif
+}
+
+void ChangeTracker::runJob(const std::function<void()> &job)
+{
+    jobs.removeIf([](const QFuture<void> &f) { return f.isFinished(); });
+    jobs.append(QtConcurrent::run(job));
+}
+
+//-------------------------------------------
+// Watches
+//-------------------------------------------
+bool ChangeTracker::addWatch(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    int wd = inotify_add_watch(fd, QFile::encodeName(path).constData(), WatchMask);
+    if (wd < 0) {
+        if (errno == ENOSPC)
+            limitReached = true;   // fs.inotify.max_user_watches
+        return false;
+    }
+
+    WatchedDir dir;
+    dir.path = path;
+    dir.mtime = directoryMTime(path);
+
+    QMutexLocker locker(&lock);
+    watches.insert(wd, dir);
+    watchByPath.insert(path, wd);
+    return true;
+#else
+    Q_UNUSED(path);
+    return false;
+#endif
+}
+
+void ChangeTracker::forgetWatchesUnder(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    QMutexLocker locker(&lock);
+    for (auto it = watchByPath.begin(); it != watchByPath.end();) {
+        if (isUnder(it.key(), path)) {
+            inotify_rm_watch(fd, it.value());
+            watches.remove(it.value());
+            it = watchByPath.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#else
+    Q_UNUSED(path);
+#endif
+}
+
+void ChangeTracker::watchTree(const QString &root)
+{
+    if (!isSupported() || roots.contains(root))
+        return;
+    roots.insert(root);
+
+    // One walk per root to place the watches, off the GUI thread
+    runJob([=]() {
+        if (!addWatch(root))
+            return;
+
+        ParallelWalker walker;
+        walker.setCancelCheck([this]() { return stopping.load() || limitReached.load(); });
+        walker.walk({ root }, [this](const WalkEntry &entry) {
+            if (entry.isDir && !entry.isSymLink)
+                addWatch(entry.filePath());
+            return true;
+        });
+    });
+}
+
+void ChangeTracker::unwatchTree(const QString &root)
+{
+    if (!roots.remove(root))
+        return;
+    forgetWatchesUnder(root);
+}
+
+//-------------------------------------------
+// Events
+//-------------------------------------------
+void ChangeTracker::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    bool overflowed = false;
+    QSet<int> touched;
+
+    for (;;) {
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n <= 0)
+            break;
+
+        for (char *p = buffer; p < buffer + n;) {
+            const struct inotify_event *ev = reinterpret_cast<struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                overflowed = true;
+                continue;
+            }
+
+            QString dir;
+            {
+                QMutexLocker locker(&lock);
+                auto it = watches.constFind(ev->wd);
+                if (it == watches.constEnd())
+                    continue;
+                dir = it->path;
+
+                if (ev->mask & IN_IGNORED) {
+                    watchByPath.remove(dir);
+                    watches.remove(ev->wd);
+                    continue;
+                }
+            }
+
+            touched.insert(ev->wd);
+            if (ev->len == 0)
+                continue;
+
+            const QString path = dir + "/" + QFile::decodeName(ev->name);
+            const bool isDir = ev->mask & IN_ISDIR;
+
+            if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                pendingAdded.insert(path);
+                pendingRemoved.remove(path);
+                if (isDir)
+                    scanNewDirectory(path);
+            } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                pendingRemoved.insert(path);
+                pendingAdded.remove(path);
+                if (isDir)
+                    forgetWatchesUnder(path);
+            }
+
+            pendingDirs.insert(dir);
+        }
+    }
+
+    // Folders restamped after the previous read may have changed again
+    // before that stat, with the events lost in this overflow
+    if (overflowed)
+        rescanChangedDirectories(lastStamped + touched);
+    restamp(touched);
+
+    // Not restarted on every event, so a steady stream still flushes
+    if (!flushTimer->isActive())
+        flushTimer->start();
+#endif
+}
+
+// Stamps are taken after the events are read, so they only ever cover
+// changes whose events were delivered. A folder changed between the read
+// and the stat is caught by the suspect set if the next read overflows.
+void ChangeTracker::restamp(const QSet<int> &touched)
+{
+#ifdef Q_OS_LINUX
+    QMutexLocker locker(&lock);
+    for (int wd : touched) {
+        auto it = watches.find(wd);
+        if (it != watches.end())
+            it->mtime = directoryMTime(it->path);
+    }
+    lastStamped = touched;
+#else
+    Q_UNUSED(touched);
+#endif
+}
+
+void ChangeTracker::addPending(const ChangeSet &changes)
+{
+    for (const QString &path : changes.added) {
+        pendingAdded.insert(path);
+        pendingRemoved.remove(path);
+    }
+    for (const QString &path : changes.removed)
+        pendingRemoved.insert(path);
+    for (const QString &dir : changes.dirs)
+        pendingDirs.insert(dir);
+    for (const QString &dir : changes.rescanned)
+        pendingRescanned.insert(dir);
+
+    if (!flushTimer->isActive())
+        flushTimer->start();
+}
+
+void ChangeTracker::flush()
+{
+    if (pendingAdded.isEmpty() && pendingRemoved.isEmpty() && pendingDirs.isEmpty()
+        && pendingRescanned.isEmpty())
+        return;
+
+    ChangeSet changes;
+    changes.added = pendingAdded.values();
+    changes.removed = pendingRemoved.values();
+    changes.dirs = pendingDirs.values();
+    changes.rescanned = pendingRescanned.values();
+
+    pendingAdded.clear();
+    pendingRemoved.clear();
+    pendingDirs.clear();
+    pendingRescanned.clear();
+
+    emit changed(changes);
+}
+
+//-------------------------------------------
+// Rescans
+//-------------------------------------------
+
+// A folder that just appeared may already have contents that were written
+// before its watch existed, so its subtree (and only that) is walked. When
+// the folder is part of a rescan, its contents are not reported: the
+// receiver lists it again anyway.
+void ChangeTracker::scanNewDirectory(const QString &path, bool report)
+{
+    runJob([=]() {
+        if (!addWatch(path))
+            return;
+
+        ChangeSet changes;
+        QMutex changesLock;
+
+        ParallelWalker walker;
+        walker.setCancelCheck([this]() { return stopping.load(); });
+        walker.walk({ path }, [&](const WalkEntry &entry) {
+            const QString filePath = entry.filePath();
+            if (entry.isDir && !entry.isSymLink)
+                addWatch(filePath);
+
+            if (report) {
+                QMutexLocker locker(&changesLock);
+                changes.added.append(filePath);
+            }
+            return true;
+        });
+
+        if (stopping.load() || !report)
+            return;
+
+        changes.dirs.append(path);
+        QMetaObject::invokeMethod(this, [=]() { addPending(changes); },
+                                  Qt::QueuedConnection);
+    });
+}
+
+// After a queue overflow the lost events cannot be recovered. Folder mtimes
+// change whenever an entry is created, removed or renamed in them, so
+// comparing them against the stamps finds the folders to list again without
+// reading any other directory. Those are reported as rescanned rather than
+// as added entries, so that the receiver can diff them against what it has
+// and apply removals as well.
+void ChangeTracker::rescanChangedDirectories(const QSet<int> &suspect)
+{
+#ifdef Q_OS_LINUX
+    runJob([=]() {
+        QList<QPair<int, WatchedDir>> snapshot;
+        {
+            QMutexLocker locker(&lock);
+            for (auto it = watches.cbegin(); it != watches.cend(); ++it)
+                snapshot.append({ it.key(), it.value() });
+        }
+
+        ChangeSet changes;
+        QStringList newDirs;
+        QStringList goneDirs;
+
+        for (const auto &[wd, dir] : std::as_const(snapshot)) {
+            if (stopping.load())
+                return;
+
+            qint64 mtime = directoryMTime(dir.path);
+            if (mtime == dir.mtime && !suspect.contains(wd))
+                continue;
+
+            {
+                QMutexLocker locker(&lock);
+                auto it = watches.find(wd);
+                if (it != watches.end())
+                    it->mtime = mtime;
+            }
+
+            changes.dirs.append(dir.path);
+            if (mtime < 0) {
+                goneDirs.append(dir.path);   // its parent is listed again
+                continue;
+            }
+            changes.rescanned.append(dir.path);
+
+            // Subfolders created during the overflow still need watches
+            const QFileInfoList entries = QDir(dir.path).entryInfoList(
+                QDir::NoDotAndDotDot | QDir::AllDirs);
+            for (const QFileInfo &info : entries) {
+                if (info.isSymLink())
+                    continue;
+                const QString path = info.absoluteFilePath();
+                QMutexLocker locker(&lock);
+                if (!watchByPath.contains(path))
+                    newDirs.append(path);
+            }
+        }
+
+        QMetaObject::invokeMethod(this, [=]() {
+            addPending(changes);
+            for (const QString &dir : goneDirs)
+                forgetWatchesUnder(dir);
+            for (const QString &dir : newDirs)
+                scanNewDirectory(dir, false);
+        }, Qt::QueuedConnection);
+    });
+#else
+    Q_UNUSED(suspect);
+#endif
+}
@@ -0,0 +1,92 @@
+#ifndef CHANGETRACKER_H
+#define CHANGETRACKER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QMutex>
+#include <QFuture>
+
+#include <atomic>
+#include <functional>
+
+class QSocketNotifier;
+class QTimer;
+
+// One coalesced burst of file system changes.
+struct ChangeSet
+{
+    QStringList added;     // new paths, including everything under new folders
+    QStringList removed;   // deleted or moved-away paths
+    QStringList dirs;      // folders whose direct contents changed
+    QStringList rescanned; // folders whose events were lost; list them again
+};
+
+// Watches directory trees with inotify and reports changes in bursts.
+//
+// Events are collected for a short while and handed out as one ChangeSet,
+// so a build that writes thousands of files produces a few signals rather
+// than thousands. A folder that appears (created or moved in) is scanned on
+// its own; nothing else is re-walked. Each folder's mtime is stamped when it
+// is watched and again after its events are read. If the kernel queue
+// overflows, every watched folder is stat'ed and those whose mtime moved
+// are reported as rescanned, for the receiver to diff against what it has.
+//
+// On platforms without inotify the tracker does nothing.
+class ChangeTracker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChangeTracker(QObject *parent = nullptr);
+    ~ChangeTracker() override;
+
+    bool isSupported() const { return fd >= 0; }
+    bool watchLimitReached() const { return limitReached.load(); }
+
+    void watchTree(const QString &root);
+    void unwatchTree(const QString &root);
+
+signals:
+    void changed(const ChangeSet &changes);
+
+private slots:
+    void readEvents();
+    void flush();
+
+private:
+    struct WatchedDir
+    {
+        QString path;
+        qint64 mtime = 0;
+    };
+
+    bool addWatch(const QString &path);
+    void forgetWatchesUnder(const QString &path);
+    void scanNewDirectory(const QString &path, bool report = true);
+    void rescanChangedDirectories(const QSet<int> &suspect);
+    void restamp(const QSet<int> &touched);
+    void addPending(const ChangeSet &changes);
+    void runJob(const std::function<void()> &job);
+
+    int fd = -1;
+    QSocketNotifier *notifier = nullptr;
+    QTimer *flushTimer;
+
+    QSet<QString> roots;
+    QMutex lock;                     // guards the two maps below
+    QHash<int, WatchedDir> watches;
+    QHash<QString, int> watchByPath;
+
+    QSet<QString> pendingAdded;
+    QSet<QString> pendingRemoved;
+    QSet<QString> pendingDirs;
+    QSet<QString> pendingRescanned;
+    QSet<int> lastStamped;           // restamped after the previous read
+
+    std::atomic<bool> limitReached { false };
+    std::atomic<bool> stopping { false };
+    QList<QFuture<void>> jobs;
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include "commandline.h"
+#include "contentscanner.h"
+#include "fileindex.h"
+#include "searchengine.h"
+#include "sizecalculator.h"
+#include "transferengine.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <cstring>
+
+namespace {
+
+const char *const Commands[] = { "--search", "--copy", "--move", "--du" };
+
+QByteArray compact(const QJsonObject &object)
+{
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+QStringList absolutePaths(const QStringList &paths)
+{
+    QStringList result;
+    for (const QString &path : paths)
+        result.append(QDir::cleanPath(QFileInfo(path).absoluteFilePath()));
+    return result;
+}
+
+int usage(const QString &message)
+{
+    QTextStream(stderr) << message << Qt::endl;
+    return 2;
+}
+
+//-------------------------------------------
+// --search
+//-------------------------------------------
+
+int search(const QCommandLineParser &parser, QFile &out)
+{
+    const QString text = parser.value("search");
+    const QString root = QDir::cleanPath(QFileInfo(parser.isSet("in") ? parser.value("in")
+                                                                      : QDir::currentPath())
+                                             .absoluteFilePath());
+    if (!QFileInfo(root).isDir())
+        return usage("Not a directory: " + root);
+
+    const auto mode = parser.isSet("content") ? SearchEngine::ContentSearch
+                                              : SearchEngine::NameSearch;
+    const qint64 limit = parser.value("limit").toLongLong();
+    if (mode == SearchEngine::ContentSearch && !ContentScanner(text).isValid())
+        return usage("Invalid pattern: " + text);
+
+    // Nothing keeps the window's index current while it is closed, so it
+    // is only used when asked for, and brought up to date first. It is
+    // never built here.
+    QSharedPointer<FileIndex> index;
+    if (mode == SearchEngine::NameSearch && parser.isSet("use-index")) {
+        index.reset(FileIndex::open(FileIndex::indexPathFor(root)));
+        if (index && !index->reconcile())
+            index.reset();
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+
+    // The document is written in pieces, hits streamed in between
+    QByteArray head = compact(QJsonObject {
+        { "command", "search" },
+        { "root", root },
+        { "query", text },
+        { "mode", mode == SearchEngine::ContentSearch ? "content" : "name" },
+        { "indexed", !index.isNull() }
+    });
+    head.chop(1);
+    out.write(head + ",\"hits\":[");
+
+    SearchEngine engine;
+    QEventLoop loop;
+    qint64 written = 0;
+    bool truncated = false;
+    QObject::connect(&engine, &SearchEngine::resultsReady, &loop,
+                     [&](quint64, const QList<SearchHit> &batch) {
+        for (const SearchHit &hit : batch) {
+            if (limit > 0 && written >= limit) {
+                truncated = true;
+                engine.cancel();
+                loop.quit();
+                return;
+            }
+            QJsonObject object {
+                { "path", hit.info.filePath() },
+                { "is_dir", hit.isDir }
+            };
+            if (hit.line > 0) {
+                object.insert("line", hit.line);
+                object.insert("offset", hit.offset);
+                object.insert("text", hit.lineText);
+            }
+            out.write((written++ ? "," : "") + compact(object));
+        }
+    });
+    QObject::connect(&engine, &SearchEngine::finished, &loop, [&loop]() { loop.quit(); });
+    engine.start(root, text, mode, index);
+    loop.exec();
+
+    QByteArray tail = compact(QJsonObject {
+        { "total", written },
+        { "truncated", truncated },
+        { "elapsed_ms", clock.elapsed() }
+    });
+    out.write("]," + tail.mid(1) + "\n");
+    return 0;
+}
+
+//-------------------------------------------
+// --copy and --move
+//-------------------------------------------
+
+int transfer(const QCommandLineParser &parser, QFile &out, bool move)
+{
+    const QStringList sources = absolutePaths(parser.positionalArguments());
+    if (sources.isEmpty())
+        return usage("Nothing to copy");
+    if (!parser.isSet("to"))
+        return usage("--to is required");
+    const QString destination = QDir::cleanPath(QFileInfo(parser.value("to")).absoluteFilePath());
+    if (!QFileInfo(destination).isDir())
+        return usage("Not a directory: " + destination);
+
+    QElapsedTimer clock;
+    clock.start();
+
+    TransferEngine engine;
+    QEventLoop loop;
+    TransferProgress last;
+    bool success = false;
+    QStringList errors;
+    QObject::connect(&engine, &TransferEngine::jobProgress, &loop,
+                     [&last](int, const TransferProgress &progress) { last = progress; });
+    QObject::connect(&engine, &TransferEngine::jobFinished, &loop,
+                     [&](int, bool ok, const QStringList &jobErrors) {
+        success = ok;
+        errors = jobErrors;
+        loop.quit();
+    });
+    engine.enqueue(move ? TransferEngine::Move : TransferEngine::Copy, sources, destination);
+    loop.exec();
+
+    out.write(compact(QJsonObject {
+        { "command", move ? "move" : "copy" },
+        { "sources", QJsonArray::fromStringList(sources) },
+        { "destination", destination },
+        { "success", success },
+        { "files", last.filesDone },
+        { "bytes", last.bytesDone },
+        { "methods", QJsonArray::fromStringList(last.methods) },
+        { "errors", QJsonArray::fromStringList(errors) },
+        { "elapsed_ms", clock.elapsed() }
+    }) + "\n");
+    return success ? 0 : 1;
+}
+
+//-------------------------------------------
+// --du
+//-------------------------------------------
+
+int diskUsage(const QCommandLineParser &parser, QFile &out)
+{
+    QStringList paths = absolutePaths(parser.positionalArguments());
+    if (paths.isEmpty())
+        paths.append(QDir::currentPath());
+
+    QElapsedTimer clock;
+    clock.start();
+
+    bool allFound = true;
+    QJsonArray results;
+    for (const QString &path : std::as_const(paths)) {
+        if (!QFileInfo::exists(path)) {
+            allFound = false;
+            results.append(QJsonObject { { "path", path }, { "error", "not found" } });
+            continue;
+        }
+
+        SizeCalculator calculator;
+        QEventLoop loop;
+        QJsonObject result { { "path", path } };
+        QObject::connect(&calculator, &SizeCalculator::finished, &loop,
+                         [&](const FolderSize &size, bool fromCache) {
+            result.insert("bytes", size.bytes);
+            result.insert("allocated", size.allocated);
+            result.insert("files", size.files);
+            result.insert("folders", size.folders);
+            result.insert("from_cache", fromCache);
+            loop.quit();
+        });
+        calculator.start(path);
+        loop.exec();
+        results.append(result);
+    }
+
+    out.write(compact(QJsonObject {
+        { "command", "du" },
+        { "results", results },
+        { "elapsed_ms", clock.elapsed() }
+    }) + "\n");
+    return allFound ? 0 : 1;
+}
+
+} // namespace
+
+bool CommandLine::wanted(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        for (const char *command : Commands) {
+            const size_t length = strlen(command);
+            if (strncmp(argv[i], command, length) == 0
+                && (argv[i][length] == '\0' || argv[i][length] == '='))
+                return true;
+        }
+    }
+    return false;
+}
+
+int CommandLine::run(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("File Explorer, headless. Results are written as JSON.");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "search", "Find names containing <text>.", "text" },
+        { "content", "With --search, look inside files instead." },
+        { "in", "With --search, the folder to search (default: current).", "dir" },
+        { "limit", "With --search, stop after <n> hits.", "n", "0" },
+        { "use-index", "With --search, use the window's name index for --in, updated "
+                       "first, instead of walking." },
+        { "copy", "Copy the given paths into --to." },
+        { "move", "Move the given paths into --to." },
+        { "to", "Target folder for --copy and --move.", "dir" },
+        { "du", "Add up the size of the given paths (default: current folder)." }
+    });
+    parser.addPositionalArgument("paths", "Sources for --copy and --move, folders for --du.",
+                                 "[paths...]");
+    parser.process(app);
+
+    int commands = 0;
+    for (const char *command : { "search", "copy", "move", "du" })
+        commands += parser.isSet(command);
+    if (commands != 1)
+        return usage("Give exactly one of --search, --copy, --move or --du");
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly))
+        return 1;
+
+    if (parser.isSet("search"))
+        return search(parser, out);
+    if (parser.isSet("copy") || parser.isSet("move"))
+        return transfer(parser, out, parser.isSet("move"));
+    return diskUsage(parser, out);
+}
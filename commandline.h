@@ -0,0 +1,29 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+// Headless mode for scripts and profiling, with no window and no display.
+//
+//   FileExplorer --search TEXT [--content] [--in DIR] [--limit N] [--use-index]
+//   FileExplorer --copy SOURCE... --to DIR
+//   FileExplorer --move SOURCE... --to DIR
+//   FileExplorer --du PATH...
+//
+// Each command drives the same engine the window uses (SearchEngine,
+// TransferEngine, SizeCalculator) under a QCoreApplication, and writes
+// one JSON document to stdout. Search hits are written as they arrive,
+// so a large result set is never held in memory. Searches walk the tree
+// unless --use-index asks for the window's name index, which is then
+// reconciled with the disk before use.
+//
+// Exit status is 0 on success, 1 if the operation failed and 2 for bad
+// arguments.
+class CommandLine
+{
+public:
+    // True if the arguments ask for a headless command
+    static bool wanted(int argc, char *argv[]);
+
+    static int run(int argc, char *argv[]);
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include "contentscanner.h"
+#include "namematcher.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+const qint64 BinaryProbeSize = 8 * 1024;
+const qint64 ChunkSize = 4 * 1024 * 1024;
+const qsizetype MaxLineCarry = 1024 * 1024;
+const int MaxLineTextLength = 300;
+
+bool looksBinary(const char *data, qint64 size)
+{
+    return std::memchr(data, '\0', size_t(qMin(size, BinaryProbeSize))) != nullptr;
+}
+
+// Index just past a bracketed argument opening at i ("{...}", "<...>" or
+// "'...'"), or i itself if there is none.
+int skipBracketed(const QString &pattern, int i)
+{
+    if (i >= pattern.size())
+        return i;
+    const QChar open = pattern.at(i);
+    const QChar close = open == '{' ? '}' : open == '<' ? '>' : open == '\'' ? '\'' : QChar();
+    if (close.isNull())
+        return i;
+    const int end = pattern.indexOf(close, i + 1);
+    return end < 0 ? int(pattern.size()) : end + 1;
+}
+
+// Longest run of ASCII characters that every match of the pattern must
+// contain. Only runs outside groups count, a character followed by a
+// quantifier is dropped, and any alternation or extended mode disables
+// the prefilter altogether. Escaped punctuation is literal; escapes with
+// a letter or digit are classes, code points or references and end a run.
+QString requiredLiteral(const QString &pattern)
+{
+    static const QRegularExpression extendedMode(QStringLiteral("\\(\\?[a-zA-Z^-]*x"));
+    if (pattern.contains('|') || pattern.contains(extendedMode))
+        return QString();
+
+    QString best;
+    QString run;
+    int depth = 0;
+
+    auto endRun = [&]() {
+        if (run.size() > best.size())
+            best = run;
+        run.clear();
+    };
+
+    for (int i = 0; i < pattern.size(); ++i) {
+        QChar c = pattern.at(i);
+
+        if (c == '\\') {
+            if (++i >= pattern.size())
+                break;
+            const QChar e = pattern.at(i);
+            if (e.unicode() < 0x80 && !e.isLetterOrNumber()) {
+                if (depth == 0 && e.isPrint())
+                    run.append(e);
+                else
+                    endRun();
+                continue;
+            }
+
+            endRun();
+            if (e == 'Q') {
+                // Quoted text; not worth unpicking
+                const int quoteEnd = pattern.indexOf(QStringLiteral("\\E"), i + 1);
+                i = quoteEnd < 0 ? int(pattern.size()) : quoteEnd + 1;
+            } else if (e == 'c') {
+                ++i;
+            } else if (e.isDigit()) {
+                while (i + 1 < pattern.size() && pattern.at(i + 1).isDigit())
+                    ++i;
+            } else if (e == 'x' && i + 1 < pattern.size() && pattern.at(i + 1) != '{') {
+                for (int n = 0; n < 2 && i + 1 < pattern.size()
+                                && isxdigit(pattern.at(i + 1).toLatin1()); ++n)
+                    ++i;
+            } else if (QStringLiteral("xopPNkg").contains(e)) {
+                int next = skipBracketed(pattern, i + 1);
+                if (next == i + 1 && (e == 'p' || e == 'P') && next < pattern.size()) {
+                    ++next;   // \pL
+                } else if (next == i + 1 && e == 'g') {
+                    if (next < pattern.size() && (pattern.at(next) == '-' || pattern.at(next) == '+'))
+                        ++next;
+                    while (next < pattern.size() && pattern.at(next).isDigit())
+                        ++next;   // \g1, \g-2
+                }
+                i = next - 1;
+            }
+        } else if (c == '(') {
+            endRun();
+            ++depth;
+        } else if (c == ')') {
+            endRun();
+            --depth;
+        } else if (c == '[') {
+            endRun();
+            // A ']' right after '[' or '[^' is a member, and members may
+            // be escaped
+            ++i;
+            if (i < pattern.size() && pattern.at(i) == '^')
+                ++i;
+            if (i < pattern.size() && pattern.at(i) == ']')
+                ++i;
+            while (i < pattern.size() && pattern.at(i) != ']') {
+                if (pattern.at(i) == '\\')
+                    ++i;
+                ++i;
+            }
+        } else if (c == '?' || c == '*' || c == '{') {
+            if (!run.isEmpty())
+                run.chop(1);
+            endRun();
+            if (c == '{') {
+                const int close = pattern.indexOf('}', i + 1);
+                i = close < 0 ? int(pattern.size()) : close;
+            }
+        } else if (c == '+' || c == '.' || c == '^' || c == '$') {
+            endRun();
+        } else if (depth == 0 && c.unicode() < 0x80 && c.isPrint()) {
+            run.append(c);
+        } else {
+            endRun();
+        }
+    }
+    endRun();
+    return best;
+}
+
+QString longestAsciiRun(const QString &text)
+{
+    QString best;
+    QString run;
+    for (QChar c : text) {
+        if (c.unicode() < 0x80) {
+            run.append(c);
+        } else {
+            if (run.size() > best.size())
+                best = run;
+            run.clear();
+        }
+    }
+    return run.size() > best.size() ? run : best;
+}
+
+} // namespace
+
+ContentScanner::ContentScanner(const QString &query)
+{
+    QString pattern;
+    QString literal;
+
+    if (query.size() > 2 && query.startsWith('/') && query.endsWith('/')) {
+        pattern = query.mid(1, query.size() - 2);
+        literal = requiredLiteral(pattern);
+    } else {
+        pattern = QRegularExpression::escape(query);
+        literal = longestAsciiRun(query);
+        prefilterIsExact = (literal == query);
+    }
+
+    regex = QRegularExpression(pattern, QRegularExpression::CaseInsensitiveOption);
+    valid = !query.isEmpty() && regex.isValid();
+    prefilter = literal.toLower().toUtf8();
+    if (prefilter.isEmpty())
+        prefilterIsExact = false;
+}
+
+//-------------------------------------------
+// Files
+//-------------------------------------------
+bool ContentScanner::scanFile(const QString &path, const MatchHandler &onMatch) const
+{
+    if (!valid)
+        return false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = file.size();
+    if (size > maxFileSize)
+        return false;
+    if (size == 0)
+        return true;
+
+    ScanState state;
+
+    if (size <= MapLimit) {
+        if (uchar *map = file.map(0, size)) {
+            const char *data = reinterpret_cast<const char *>(map);
+            bool binary = looksBinary(data, size);
+            if (!binary)
+                scanBuffer(data, qsizetype(size), 0, state, onMatch);
+            file.unmap(map);
+            return !binary;
+        }
+    }
+
+    // Too large to map (or mapping failed): read in chunks, carrying the
+    // unfinished last line over to the next chunk.
+    QByteArray buffer;
+    qint64 base = 0;
+    bool first = true;
+
+    for (;;) {
+        QByteArray chunk = file.read(ChunkSize);
+        if (chunk.isEmpty())
+            break;
+
+        if (first) {
+            if (looksBinary(chunk.constData(), chunk.size()))
+                return false;
+            first = false;
+        }
+
+        buffer.append(chunk);
+
+        qsizetype complete = buffer.lastIndexOf('\n') + 1;
+        if (complete == 0) {
+            if (buffer.size() < MaxLineCarry)
+                continue;
+            complete = buffer.size();   // give up on an endless line
+        }
+
+        if (!scanBuffer(buffer.constData(), complete, base, state, onMatch))
+            return true;
+
+        base += complete;
+        buffer.remove(0, complete);
+    }
+
+    if (!buffer.isEmpty())
+        scanBuffer(buffer.constData(), buffer.size(), base, state, onMatch);
+    return true;
+}
+
+//-------------------------------------------
+// Buffers
+//-------------------------------------------
+bool ContentScanner::scanBuffer(const char *data, qsizetype size, qint64 base,
+                                ScanState &state, const MatchHandler &onMatch) const
+{
+    const char *p = data;
+    const char *end = data + size;
+    const char *counted = data;   // state.line is the line number at 'counted'
+
+    while (p < end) {
+        const char *hit = p;
+        if (!prefilter.isEmpty()) {
+            qsizetype pos = NameMatcher::findAsciiCaseInsensitive(
+                p, end - p, prefilter.constData(), prefilter.size());
+            if (pos < 0)
+                break;
+            hit = p + pos;
+        }
+
+        const char *lineBegin = hit;
+        while (lineBegin > p && lineBegin[-1] != '\n')
+            --lineBegin;
+        const char *lineEnd = static_cast<const char *>(
+            std::memchr(hit, '\n', size_t(end - hit)));
+        if (!lineEnd)
+            lineEnd = end;
+
+        state.line += std::count(counted, lineBegin, '\n');
+        counted = lineBegin;
+
+        ContentMatch match;
+        qsizetype matchStart = 0;
+        if (verifyLine(lineBegin, lineEnd, hit, match, matchStart)) {
+            match.offset = base + (lineBegin - data) + matchStart;
+            match.line = state.line;
+            if (!onMatch(match) || ++state.matches >= maxMatchesPerFile)
+                return false;
+        }
+
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+
+    state.line += std::count(counted, end, '\n');
+    return true;
+}
+
+bool ContentScanner::verifyLine(const char *begin, const char *end, const char *hit,
+                                ContentMatch &match, qsizetype &matchStart) const
+{
+    qsizetype length = end - begin;
+    if (length > 0 && end[-1] == '\r')
+        --length;
+
+    if (prefilterIsExact) {
+        matchStart = hit - begin;
+        match.matchText = QString::fromUtf8(hit, prefilter.size());
+    } else {
+        const QString line = QString::fromUtf8(begin, length);
+        QRegularExpressionMatch m = regex.match(line);
+        if (!m.hasMatch())
+            return false;
+        matchStart = line.left(m.capturedStart()).toUtf8().size();
+        match.matchText = m.captured();
+    }
+
+    match.lineText = QString::fromUtf8(begin, length).trimmed().left(MaxLineTextLength);
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef CONTENTSCANNER_H
+#define CONTENTSCANNER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QRegularExpression>
+
+#include <functional>
+
+struct ContentMatch
+{
+    qint64 offset = 0;    // byte offset of the match in the file
+    qint64 line = 0;      // 1-based line number
+    QString lineText;
+    QString matchText;
+};
+
+// Finds lines containing a string inside one file.
+//
+// Plain text is matched case-insensitively; text written as /pattern/ is a
+// case-insensitive regular expression. Either way the longest ASCII run of
+// the query is searched first with the vectorized NameMatcher kernel, and
+// only lines containing it are looked at more closely.
+//
+// Files up to MapLimit are memory-mapped; larger ones (up to the size cap)
+// are read in chunks. Files with a NUL byte near the start are treated as
+// binary and skipped.
+class ContentScanner
+{
+public:
+    using MatchHandler = std::function<bool(const ContentMatch &match)>;
+
+    explicit ContentScanner(const QString &query);
+
+    bool isValid() const { return valid; }
+
+    void setMaxFileSize(qint64 bytes) { maxFileSize = bytes; }
+    void setMaxMatchesPerFile(int count) { maxMatchesPerFile = count; }
+
+    // Calls onMatch for every matching line until it returns false.
+    // Returns false if the file was skipped.
+    bool scanFile(const QString &path, const MatchHandler &onMatch) const;
+
+    static constexpr qint64 DefaultMaxFileSize = 64 * 1024 * 1024;
+    static constexpr qint64 MapLimit = 16 * 1024 * 1024;
+
+private:
+    struct ScanState
+    {
+        qint64 line = 1;
+        int matches = 0;
+    };
+
+    bool scanBuffer(const char *data, qsizetype size, qint64 base,
+                    ScanState &state, const MatchHandler &onMatch) const;
+    bool verifyLine(const char *begin, const char *end, const char *hit,
+                    ContentMatch &match, qsizetype &matchStart) const;
+
+    QByteArray prefilter;          // lower-case ASCII, may be empty
+    bool prefilterIsExact = false; // prefilter alone decides the match
+    QRegularExpression regex;
+    bool valid = true;
+
+    qint64 maxFileSize = DefaultMaxFileSize;
+    int maxMatchesPerFile = 100;
+};
+
+#endif
@@ -0,0 +1,41 @@
+# Engines with no GUI dependency, shared by the app, its headless
+# command line and the benchmarks
+QT += core concurrent
+CONFIG += c++17
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/changetracker.cpp \
+    $$PWD/contentscanner.cpp \
+    $$PWD/entrysorter.cpp \
+    $$PWD/fastcopy.cpp \
+    $$PWD/fileindex.cpp \
+    $$PWD/listingcache.cpp \
+    $$PWD/namematcher.cpp \
+    $$PWD/parallelwalker.cpp \
+    $$PWD/pathresolver.cpp \
+    $$PWD/perftrace.cpp \
+    $$PWD/searchengine.cpp \
+    $$PWD/sizecalculator.cpp \
+    $$PWD/smallfilecopy.cpp \
+    $$PWD/transferengine.cpp \
+    $$PWD/trash.cpp
+
+HEADERS += \
+    $$PWD/changetracker.h \
+    $$PWD/contentscanner.h \
+    $$PWD/entrysorter.h \
+    $$PWD/entrytable.h \
+    $$PWD/fastcopy.h \
+    $$PWD/fileindex.h \
+    $$PWD/listingcache.h \
+    $$PWD/namematcher.h \
+    $$PWD/parallelwalker.h \
+    $$PWD/pathresolver.h \
+    $$PWD/perftrace.h \
+    $$PWD/searchengine.h \
+    $$PWD/sizecalculator.h \
+    $$PWD/smallfilecopy.h \
+    $$PWD/transferengine.h \
+    $$PWD/trash.h
@@ -0,0 +1,484 @@
+#include "directorymodel.h"
+#include "statuscounter.h"
+#include "iconcache.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+const int ReloadDelayMs = 2000;
+const quint32 NoEntry = std::numeric_limits<quint32>::max();
+
+} // namespace
+
+DirectoryModel::DirectoryModel(QObject *parent)
+    : QAbstractListModel(parent),
+      cache(new ListingCache(this)),
+      watcher(new QFileSystemWatcher(this)),
+      reloadTimer(new QTimer(this))
+{
+    sortBy(ByName);
+
+    // A busy folder changes all the time; re-read it at most this often
+    reloadTimer->setSingleShot(true);
+    reloadTimer->setInterval(ReloadDelayMs);
+    connect(reloadTimer, &QTimer::timeout, this, &DirectoryModel::reload);
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, [this]() {
+        if (!reloadTimer->isActive())
+            reloadTimer->start();
+    });
+}
+
+DirectoryModel::~DirectoryModel()
+{
+    ++generation;
+    ++sortGeneration;
+    for (QFuture<void> &job : jobs)
+        job.waitForFinished();
+}
+
+void DirectoryModel::startJob(std::function<void()> job)
+{
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                              [](const QFuture<void> &done) { return done.isFinished(); }),
+               jobs.end());
+    jobs.push_back(QtConcurrent::run(std::move(job)));
+}
+
+void DirectoryModel::setRootPath(const QString &path)
+{
+    if (!root.isEmpty())
+        watcher->removePath(root);
+    root = path;
+    if (!root.isEmpty())
+        watcher->addPath(root);
+
+    // Switched off: nothing is shown, so nothing needs keeping
+    if (root.isEmpty())
+        cache->clear();
+
+    if (QSharedPointer<const Listing> listing = cache->find(root)) {
+        showListing(listing);
+        verifyListing();
+        return;
+    }
+    load();
+}
+
+// Shown at once, checked off the GUI thread: a stat can hang on a slow
+// mount. A folder that changed meanwhile is refreshed in place.
+void DirectoryModel::verifyListing()
+{
+    const quint64 current = generation.load();
+    const QString path = root;
+    const FolderStamp shown = stamp;
+    startJob([this, path, shown, current]() {
+        const FolderStamp onDisk = FolderStamp::of(path);
+        if (onDisk == shown)
+            return;
+        QMetaObject::invokeMethod(this, [this, current]() {
+            if (current == generation.load())
+                reload();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DirectoryModel::prefetch(const QString &path)
+{
+    if (path != root)
+        cache->prefetch(path, sortSpec);
+}
+
+void DirectoryModel::showListing(QSharedPointer<const Listing> listing)
+{
+    reloadTimer->stop();
+    ++generation;
+    ++sortGeneration;
+
+    const bool sorted = listing->spec == sortSpec
+                        && listing->order.size() == size_t(listing->table.count());
+
+    beginResetModel();
+    table = listing->table;
+    stamp = listing->stamp;
+    if (sorted) {
+        order = listing->order;
+    } else {
+        order.resize(size_t(table.count()));
+        std::iota(order.begin(), order.end(), 0u);
+    }
+    recount();
+    endResetModel();
+
+    loading = false;
+    emit loadFinished(table.count(), 0);
+    if (!sorted)
+        startSort();
+}
+
+// Keeps the sorted listing for the next visit
+void DirectoryModel::remember()
+{
+    auto listing = QSharedPointer<Listing>::create();
+    listing->table = table;
+    listing->order = order;
+    listing->spec = sortSpec;
+    listing->stamp = stamp;
+    cache->insert(root, listing);
+}
+
+// Reads the folder from scratch, showing rows as they come in
+void DirectoryModel::load()
+{
+    reloadTimer->stop();
+    const quint64 current = ++generation;
+    ++sortGeneration;
+
+    beginResetModel();
+    table.clear();
+    order.clear();
+    order.shrink_to_fit();
+    totals = StatusCounts();
+    endResetModel();
+
+    loading = false;
+    if (root.isEmpty())
+        return;
+
+    loading = true;
+    firstRowsSeen = false;
+    loadClock.start();
+
+    const QString path = root;
+    startJob([this, path, current]() {
+        auto stale = [this, current]() { return generation.load() != current; };
+        FolderStamp folderStamp;
+        const bool complete = ListingCache::readFolder(path, stale,
+                                                       [this, current](QSharedPointer<EntryTable> chunk) {
+            QMetaObject::invokeMethod(this, [this, current, chunk]() {
+                appendChunk(current, chunk);
+            }, Qt::QueuedConnection);
+        }, &folderStamp);
+
+        // A listing cut short is shown but never cached
+        if (!complete)
+            folderStamp = FolderStamp();
+        QMetaObject::invokeMethod(this, [this, current, folderStamp]() {
+            finishLoad(current, folderStamp);
+        }, Qt::QueuedConnection);
+    });
+}
+
+// Reads and sorts the folder in the background while the old rows stay
+void DirectoryModel::reload()
+{
+    reloadTimer->stop();
+    if (root.isEmpty() || table.count() == 0) {
+        load();
+        return;
+    }
+
+    // The load under way may predate the change; look again once it is done
+    if (loading) {
+        reloadTimer->start();
+        return;
+    }
+
+    const quint64 current = ++generation;
+    const QString path = root;
+    startJob([this, path, spec = sortSpec, current]() {
+        auto stale = [this, current]() { return generation.load() != current; };
+        auto fresh = QSharedPointer<Listing>::create();
+        fresh->spec = spec;
+        const bool complete = ListingCache::readFolder(path, stale,
+                                                       [&fresh](QSharedPointer<EntryTable> chunk) {
+            fresh->table.append(*chunk);
+        }, &fresh->stamp);
+        if (!complete)
+            return;
+        fresh->order = EntrySorter::sort(fresh->table, spec, stale);
+        if (stale())
+            return;
+        QMetaObject::invokeMethod(this, [this, current, fresh]() {
+            applyRefresh(current, fresh);
+        }, Qt::QueuedConnection);
+    });
+}
+
+// Swaps in a re-read listing as removals, updates and insertions, so the
+// view keeps its selection, current row and scroll position
+void DirectoryModel::applyRefresh(quint64 refreshGeneration, QSharedPointer<Listing> fresh)
+{
+    if (refreshGeneration != generation.load())
+        return;
+
+    const EntryTable &next = fresh->table;
+    QHash<QByteArrayView, quint32> byName;
+    byName.reserve(next.count());
+    for (quint32 entry = 0; entry < quint32(next.count()); ++entry)
+        byName.insert(next.name(entry), entry);
+
+    // Old entry -> new entry, by name
+    std::vector<quint32> newEntry(size_t(table.count()), NoEntry);
+    std::vector<bool> matched(size_t(next.count()), false);
+    for (quint32 entry = 0; entry < quint32(table.count()); ++entry) {
+        const auto it = byName.constFind(table.name(entry));
+        if (it != byName.cend()) {
+            newEntry[entry] = *it;
+            matched[*it] = true;
+        }
+    }
+
+    // Rows whose entry is gone, in runs, from the bottom up
+    for (int row = int(order.size()) - 1; row >= 0;) {
+        if (newEntry[order[row]] != NoEntry) {
+            --row;
+            continue;
+        }
+        int first = row;
+        while (first > 0 && newEntry[order[first - 1]] == NoEntry)
+            --first;
+        beginRemoveRows(QModelIndex(), first, row);
+        order.erase(order.begin() + first, order.begin() + row + 1);
+        endRemoveRows();
+        row = first - 1;
+    }
+
+    // The rows left point into the new table; sizes and dates may differ
+    for (quint32 &entry : order)
+        entry = newEntry[entry];
+    table = next;
+    stamp = fresh->stamp;
+    ++sortGeneration;   // a sort of the old table no longer fits
+    if (!order.empty())
+        emit dataChanged(index(0), index(int(order.size()) - 1));
+
+    // New entries are appended, then the sorted order puts them in place
+    std::vector<quint32> added;
+    for (quint32 entry = 0; entry < quint32(next.count()); ++entry) {
+        if (!matched[entry])
+            added.push_back(entry);
+    }
+    if (!added.empty()) {
+        beginInsertRows(QModelIndex(), int(order.size()), int(order.size() + added.size()) - 1);
+        order.insert(order.end(), added.begin(), added.end());
+        endInsertRows();
+    }
+
+    recount();
+    if (fresh->spec == sortSpec)
+        applyOrder(fresh->order);
+    else
+        startSort();
+}
+
+void DirectoryModel::appendChunk(quint64 chunkGeneration, QSharedPointer<EntryTable> chunk)
+{
+    if (chunkGeneration != generation.load())
+        return;
+
+    const int count = chunk->count();
+    const quint32 first = quint32(table.count());
+
+    beginInsertRows(QModelIndex(), int(order.size()), int(order.size()) + count - 1);
+    table.append(*chunk);
+    for (int i = 0; i < count; ++i)
+        order.push_back(first + quint32(i));
+    addCounts(first, quint32(table.count()));
+    endInsertRows();
+
+    if (!firstRowsSeen) {
+        firstRowsSeen = true;
+        emit firstRowsShown(loadClock.elapsed());
+    }
+}
+
+void DirectoryModel::finishLoad(quint64 loadGeneration, const FolderStamp &folderStamp)
+{
+    if (loadGeneration != generation.load())
+        return;
+
+    loading = false;
+    stamp = folderStamp;
+    emit loadFinished(int(order.size()), loadClock.elapsed());
+    if (table.count() == 0)
+        remember();
+    startSort();
+}
+
+void DirectoryModel::sortBy(SortKey key, Qt::SortOrder sortOrder)
+{
+    SortSpec spec { { SortField::FoldersFirst } };
+    switch (key) {
+    case ByName:
+        spec.append({ SortField::Name, sortOrder });
+        break;
+    case BySize:
+        spec.append({ SortField::Size, sortOrder });
+        break;
+    case ByModified:
+        spec.append({ SortField::Modified, sortOrder });
+        break;
+    case ByType:
+        spec.append({ SortField::Suffix, sortOrder });
+        break;
+    }
+    if (key != ByName)
+        spec.append({ SortField::Name });
+
+    setSortSpec(spec);
+}
+
+void DirectoryModel::setSortSpec(const SortSpec &spec)
+{
+    sortSpec = spec;
+    if (!loading)
+        startSort();
+}
+
+// Sorts a copy of the table on the pool, so the view stays live. Only
+// the name arena is shared; the offset, length, size and mtime arrays
+// are copied here, on the GUI thread, for every sort.
+void DirectoryModel::startSort()
+{
+    if (table.count() == 0)
+        return;
+
+    const quint64 current = ++sortGeneration;
+
+    QElapsedTimer clock;
+    clock.start();
+    startJob([this, snapshot = table, spec = sortSpec, current, clock]() {
+        auto stale = [this, current]() { return sortGeneration.load() != current; };
+        auto sorted = QSharedPointer<std::vector<quint32>>::create(
+            EntrySorter::sort(snapshot, spec, stale));
+        if (stale())
+            return;
+        QMetaObject::invokeMethod(this, [this, current, sorted, clock]() {
+            if (current != sortGeneration.load())
+                return;
+            applyOrder(*sorted);
+            emit sortFinished(int(order.size()), clock.elapsed());
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DirectoryModel::applyOrder(std::vector<quint32> &sorted)
+{
+    if (sorted.size() != order.size())
+        return;
+
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    const QModelIndexList before = persistentIndexList();
+    std::vector<quint32> entries;
+    entries.reserve(size_t(before.size()));
+    for (const QModelIndex &index : before)
+        entries.push_back(entryAt(index));
+
+    order.swap(sorted);
+
+    std::vector<quint32> rowOf(order.size());
+    for (size_t row = 0; row < order.size(); ++row)
+        rowOf[order[row]] = quint32(row);
+
+    QModelIndexList after;
+    after.reserve(before.size());
+    for (quint32 entry : entries)
+        after.append(index(int(rowOf[entry])));
+    changePersistentIndexList(before, after);
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+    remember();
+}
+
+QString DirectoryModel::fileName(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return QString();
+    return QString::fromUtf8(table.name(entryAt(index)));
+}
+
+QString DirectoryModel::filePath(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return QString();
+    return QDir(root).filePath(fileName(index));
+}
+
+bool DirectoryModel::isDir(const QModelIndex &index) const
+{
+    return index.isValid() && table.isDir(entryAt(index));
+}
+
+qint64 DirectoryModel::size(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+    return table.size(entryAt(index));
+}
+
+QDateTime DirectoryModel::lastModified(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return QDateTime();
+    return QDateTime::fromSecsSinceEpoch(table.mtime(entryAt(index)));
+}
+
+StatusCounts DirectoryModel::counts() const
+{
+    return totals;
+}
+
+void DirectoryModel::addCounts(quint32 first, quint32 end)
+{
+    for (quint32 entry = first; entry < end; ++entry) {
+        if (table.isDir(entry)) {
+            ++totals.folders;
+        } else {
+            ++totals.files;
+            totals.bytes += table.size(entry);
+        }
+    }
+    totals.items = int(order.size());
+}
+
+void DirectoryModel::recount()
+{
+    totals = StatusCounts();
+    addCounts(0, quint32(table.count()));
+}
+
+qint64 DirectoryModel::memoryUsage() const
+{
+    return table.memoryUsage() + qint64(order.capacity() * sizeof(quint32));
+}
+
+int DirectoryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(order.size());
+}
+
+QVariant DirectoryModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= int(order.size()))
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return fileName(index);
+    case Qt::DecorationRole:
+        return IconCache::forEntry(fileName(index), isDir(index));
+    default:
+        return QVariant();
+    }
+}
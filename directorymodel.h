@@ -0,0 +1,124 @@
+#ifndef DIRECTORYMODEL_H
+#define DIRECTORYMODEL_H
+
+#include <QAbstractListModel>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QSharedPointer>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "entrytable.h"
+#include "entrysorter.h"
+#include "listingcache.h"
+#include "statuscounter.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
+// A flat listing of one folder, for folders too big for QFileSystemModel.
+//
+// Entries are kept in an EntryTable, with no per-row object. Sorting
+// reorders a permutation of entry numbers, not the entries themselves,
+// and runs on the worker pool; the view keeps the old order until the
+// new one is ready.
+//
+// The folder is read in the background and handed over in chunks, so the
+// first rows show up long before a big folder is done. Rows are appended
+// in directory order while loading and sorted once at the end.
+//
+// A folder that changes while shown is read again in the background and
+// sorted there. The old rows stay until the new listing is ready; then
+// only vanished, new and changed entries are touched, and the selection
+// and current row follow their entries.
+//
+// Sorted listings are kept in a ListingCache. Opening a folder again,
+// or one that was prefetched, shows it at once; whether the folder has
+// changed since is checked in the background, and if it has, the
+// listing is refreshed in place.
+class DirectoryModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum SortKey { ByName, BySize, ByModified, ByType };
+
+    explicit DirectoryModel(QObject *parent = nullptr);
+    ~DirectoryModel() override;
+
+    void setRootPath(const QString &path);
+    QString rootPath() const { return root; }
+    void reload();
+
+    // Reads and sorts path in the background, for a quick open later
+    void prefetch(const QString &path);
+
+    // Folders first, then key, then name
+    void sortBy(SortKey key, Qt::SortOrder order = Qt::AscendingOrder);
+    void setSortSpec(const SortSpec &spec);
+
+    QString fileName(const QModelIndex &index) const;
+    QString filePath(const QModelIndex &index) const;
+    bool isDir(const QModelIndex &index) const;
+    qint64 size(const QModelIndex &index) const;
+    QDateTime lastModified(const QModelIndex &index) const;
+
+    bool isLoading() const { return loading; }
+
+    // Totals kept up to date as rows come and go; nothing is selected
+    StatusCounts counts() const;
+
+    // Bytes held for the listing, arena and arrays included
+    qint64 memoryUsage() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+signals:
+    void firstRowsShown(qint64 elapsedMs);
+    void loadFinished(int entries, qint64 elapsedMs);
+    void sortFinished(int entries, qint64 elapsedMs);
+
+private:
+    void load();
+    void verifyListing();
+    void startJob(std::function<void()> job);
+    void appendChunk(quint64 generation, QSharedPointer<EntryTable> chunk);
+    void finishLoad(quint64 generation, const FolderStamp &folderStamp);
+    void applyRefresh(quint64 generation, QSharedPointer<Listing> fresh);
+    void addCounts(quint32 first, quint32 end);
+    void recount();
+    void showListing(QSharedPointer<const Listing> listing);
+    void remember();
+    void startSort();
+    void applyOrder(std::vector<quint32> &sorted);
+    quint32 entryAt(const QModelIndex &index) const { return order[index.row()]; }
+
+    QString root;
+    bool loading = false;
+
+    // One slot per entry in read order, and row -> entry
+    EntryTable table;
+    std::vector<quint32> order;
+    SortSpec sortSpec;
+    FolderStamp stamp;
+    ListingCache *cache;
+    StatusCounts totals;
+
+    // Each load and refresh bumps the generation, each sort the sort
+    // generation; a new table outdates sorts too, a new sort leaves reads
+    // alone. Jobs are never waited for on the GUI thread: a stale one
+    // sees its generation gone and stops, and only the destructor waits.
+    std::vector<QFuture<void>> jobs;
+    std::atomic<quint64> generation { 0 };
+    std::atomic<quint64> sortGeneration { 0 };
+    QElapsedTimer loadClock;
+    bool firstRowsSeen = false;
+
+    QFileSystemWatcher *watcher;
+    QTimer *reloadTimer;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "entrysorter.h"
+#include "perftrace.h"
+
+#include <QCollator>
+#include <QLocale>
+#include <QThread>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+
+namespace {
+
+const int KeyBlockSize = 8192;
+const qsizetype MinParallelEntries = 32768;
+
+using CollationKeys = std::vector<std::optional<QCollatorSortKey>>;
+
+QCollator makeCollator()
+{
+    QCollator collator{ QLocale() };
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    collator.setNumericMode(true);
+    return collator;
+}
+
+// The part after the last dot, or empty
+QByteArrayView suffixOf(QByteArrayView name)
+{
+    const qsizetype dot = name.lastIndexOf('.');
+    return dot > 0 ? name.sliced(dot + 1) : QByteArrayView();
+}
+
+// One key per entry, built in blocks on the pool with a collator per
+// block, since a QCollator must not be shared between threads
+CollationKeys buildKeys(const EntryTable &table, bool suffixOnly,
+                        const std::function<bool()> &stale)
+{
+    CollationKeys keys(size_t(table.count()));
+
+    QList<int> blocks;
+    for (int first = 0; first < table.count(); first += KeyBlockSize)
+        blocks.append(first);
+
+    QtConcurrent::blockingMap(blocks, [&](int first) {
+        if (stale && stale())
+            return;
+        QCollator collator = makeCollator();
+        const int last = std::min(table.count(), first + KeyBlockSize);
+        for (int entry = first; entry < last; ++entry) {
+            QByteArrayView name = table.name(quint32(entry));
+            if (suffixOnly)
+                name = suffixOf(name);
+            keys[size_t(entry)] = collator.sortKey(QString::fromUtf8(name));
+        }
+    });
+    return keys;
+}
+
+// Sorts runs of the range at the same time, then merges neighbouring
+// runs pairwise until one is left. False if stale() turned true between
+// passes.
+template<typename Less>
+bool parallelSort(std::vector<quint32> &items, Less less, const std::function<bool()> &stale)
+{
+    const qsizetype size = qsizetype(items.size());
+    int runs = 1;
+    if (size >= MinParallelEntries) {
+        while (runs * 2 <= QThread::idealThreadCount())
+            runs *= 2;
+    }
+
+    QList<qsizetype> bounds;
+    for (int run = 0; run <= runs; ++run)
+        bounds.append(size * run / runs);
+
+    QList<int> starts;
+    for (int run = 0; run < runs; ++run)
+        starts.append(run);
+    QtConcurrent::blockingMap(starts, [&](int run) {
+        std::sort(items.begin() + bounds[run], items.begin() + bounds[run + 1], less);
+    });
+
+    for (int width = 1; width < runs; width *= 2) {
+        if (stale && stale())
+            return false;
+        QList<int> merges;
+        for (int run = 0; run + width < runs; run += 2 * width)
+            merges.append(run);
+        QtConcurrent::blockingMap(merges, [&](int run) {
+            const qsizetype end = bounds[std::min(runs, run + 2 * width)];
+            std::inplace_merge(items.begin() + bounds[run], items.begin() + bounds[run + width],
+                               items.begin() + end, less);
+        });
+    }
+    return true;
+}
+
+} // namespace
+
+std::vector<quint32> EntrySorter::sort(const EntryTable &table, const SortSpec &spec,
+                                       const std::function<bool()> &stale)
+{
+    PerfScope scope("sort entries", QString("%1 entries").arg(table.count()));
+
+    bool needNames = false;
+    bool needSuffixes = false;
+    for (const SortField &field : spec) {
+        needNames |= field.key == SortField::Name;
+        needSuffixes |= field.key == SortField::Suffix;
+    }
+
+    const CollationKeys names = needNames ? buildKeys(table, false, stale) : CollationKeys();
+    const CollationKeys suffixes = needSuffixes ? buildKeys(table, true, stale) : CollationKeys();
+    if (stale && stale())
+        return {};
+
+    std::vector<quint32> order(size_t(table.count()));
+    std::iota(order.begin(), order.end(), 0u);
+
+    auto compareField = [&](const SortField &field, quint32 a, quint32 b) {
+        switch (field.key) {
+        case SortField::FoldersFirst:
+            return int(table.isDir(b)) - int(table.isDir(a));
+        case SortField::Name:
+            return names[a]->compare(*names[b]);
+        case SortField::Suffix:
+            return suffixes[a]->compare(*suffixes[b]);
+        case SortField::Size:
+            return table.size(a) < table.size(b) ? -1 : (table.size(a) > table.size(b) ? 1 : 0);
+        case SortField::Modified:
+            return table.mtime(a) < table.mtime(b) ? -1 : (table.mtime(a) > table.mtime(b) ? 1 : 0);
+        }
+        return 0;
+    };
+
+    const bool done = parallelSort(order, [&](quint32 a, quint32 b) {
+        for (const SortField &field : spec) {
+            const int result = compareField(field, a, b);
+            if (result != 0)
+                return field.order == Qt::AscendingOrder ? result < 0 : result > 0;
+        }
+        return a < b;
+    }, stale);
+
+    if (!done || (stale && stale()))
+        return {};
+    return order;
+}
@@ -0,0 +1,43 @@
+#ifndef ENTRYSORTER_H
+#define ENTRYSORTER_H
+
+#include <QList>
+
+#include <functional>
+#include <vector>
+
+#include "entrytable.h"
+
+struct SortField
+{
+    enum Key { FoldersFirst, Name, Suffix, Size, Modified };
+
+    Key key;
+    Qt::SortOrder order = Qt::AscendingOrder;
+
+    bool operator==(const SortField &other) const
+    {
+        return key == other.key && order == other.order;
+    }
+};
+
+// Keys applied in turn, e.g. folders first, then suffix, then name
+using SortSpec = QList<SortField>;
+
+// Sorts the entries of a table for display.
+//
+// Names are compared by collation keys built once per entry, with the
+// locale's rules and numbers in names compared by value ("file2" before
+// "file10"). Keys are built and sorted in parallel: the entries are
+// split into one run per core, the runs are sorted at the same time and
+// then merged pairwise. Ties fall back to the entry number, so equal
+// entries keep their read order and the result is stable.
+class EntrySorter
+{
+public:
+    // Entry numbers of table in spec order; empty if stale() turned true
+    static std::vector<quint32> sort(const EntryTable &table, const SortSpec &spec,
+                                     const std::function<bool()> &stale = {});
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef ENTRYTABLE_H
+#define ENTRYTABLE_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// The entries of one folder as parallel arrays.
+//
+// Names live back to back in one UTF-8 arena. Size and kind share one
+// 64-bit word, and mtime is kept in whole seconds. An entry is just its
+// number; nothing is allocated per entry.
+struct EntryTable
+{
+    enum Kind : quint64 { Dir = 1, SymLink = 2 };
+    static const int KindBits = 2;
+
+    QByteArray names;
+    std::vector<quint32> nameOffsets;
+    std::vector<quint16> nameLengths;
+    std::vector<quint64> sizeAndKind;   // size << KindBits | kind
+    std::vector<quint32> mtimes;        // seconds since the epoch
+
+    int count() const { return int(nameOffsets.size()); }
+
+    QByteArrayView name(quint32 entry) const
+    {
+        return QByteArrayView(names.constData() + nameOffsets[entry], nameLengths[entry]);
+    }
+    bool isDir(quint32 entry) const { return sizeAndKind[entry] & Dir; }
+    qint64 size(quint32 entry) const { return qint64(sizeAndKind[entry] >> KindBits); }
+    quint32 mtime(quint32 entry) const { return mtimes[entry]; }
+
+    void append(const char *name, size_t length, qint64 size, qint64 mtime, quint64 kind)
+    {
+        length = std::min<size_t>(length, std::numeric_limits<quint16>::max());
+        nameOffsets.push_back(quint32(names.size()));
+        nameLengths.push_back(quint16(length));
+        names.append(name, qsizetype(length));
+        sizeAndKind.push_back(quint64(qMax<qint64>(0, size)) << KindBits | kind);
+        mtimes.push_back(quint32(qBound<qint64>(0, mtime, std::numeric_limits<quint32>::max())));
+    }
+
+    void append(const EntryTable &other)
+    {
+        const quint32 base = quint32(names.size());
+        names.append(other.names);
+        for (quint32 offset : other.nameOffsets)
+            nameOffsets.push_back(base + offset);
+        nameLengths.insert(nameLengths.end(), other.nameLengths.begin(), other.nameLengths.end());
+        sizeAndKind.insert(sizeAndKind.end(), other.sizeAndKind.begin(), other.sizeAndKind.end());
+        mtimes.insert(mtimes.end(), other.mtimes.begin(), other.mtimes.end());
+    }
+
+    // Empties the table and gives its memory back
+    void clear() { *this = EntryTable(); }
+
+    qint64 memoryUsage() const
+    {
+        return qint64(names.capacity())
+               + qint64(nameOffsets.capacity() * sizeof(quint32))
+               + qint64(nameLengths.capacity() * sizeof(quint16))
+               + qint64(sizeAndKind.capacity() * sizeof(quint64))
+               + qint64(mtimes.capacity() * sizeof(quint32));
+    }
+};
+
+#endif
@@ -0,0 +1,296 @@
+#include "fastcopy.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QStorageInfo>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <sys/syscall.h>
+#include <cstdio>
+#include <cerrno>
+#include <vector>
+#endif
+
+namespace {
+
+// Chunked so that progress, pause, cancel and throttling get a say
+// even when the kernel does the copying.
+const qint64 KernelChunkSize = 8 * 1024 * 1024;
+const qint64 BufferSize = 1024 * 1024;
+
+#ifdef Q_OS_LINUX
+// Errors meaning "this mechanism does not work here", as opposed to a
+// real I/O error.
+bool isUnsupported(int err)
+{
+    return err == ENOSYS || err == EXDEV || err == EINVAL || err == EOPNOTSUPP
+           || err == ENOTTY || err == EPERM || err == EBADF;
+}
+
+enum StepResult { StepDone, StepUnsupported, StepFailed, StepCancelled };
+
+template <typename CopyChunk>
+StepResult kernelLoop(CopyChunk copyChunk, FastCopy::Method method,
+                      const FastCopy::Progress &progress, qint64 &copied)
+{
+    bool first = true;
+    for (;;) {
+        ssize_t n = copyChunk(KernelChunkSize);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            // Only a refusal on the first call is a reason to fall back;
+            // later errors are real.
+            return first && isUnsupported(errno) ? StepUnsupported : StepFailed;
+        }
+        if (n == 0)
+            return StepDone;
+        first = false;
+        copied += n;
+        if (progress && !progress(n, method))
+            return StepCancelled;
+    }
+}
+
+StepResult readWriteLoop(int in, int out, const FastCopy::Progress &progress, qint64 &copied)
+{
+    std::vector<char> buffer(BufferSize);
+    for (;;) {
+        ssize_t n = ::read(in, buffer.data(), buffer.size());
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return StepFailed;
+        }
+        if (n == 0)
+            return StepDone;
+
+        for (ssize_t written = 0; written < n;) {
+            ssize_t w = ::write(out, buffer.data() + written, size_t(n - written));
+            if (w < 0) {
+                if (errno == EINTR)
+                    continue;
+                return StepFailed;
+            }
+            written += w;
+        }
+        copied += n;
+
+        if (progress && !progress(n, FastCopy::ReadWrite))
+            return StepCancelled;
+    }
+}
+
+bool copyLinux(const QString &source, const QString &target,
+               const FastCopy::Progress &progress, FastCopy::Method *used)
+{
+    const QByteArray targetPath = QFile::encodeName(target);
+
+    int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(in, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(in);
+        return false;
+    }
+
+    int out = ::open(targetPath.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     st.st_mode & 07777);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+
+    StepResult result = StepUnsupported;
+    FastCopy::Method method = FastCopy::NoMethod;
+    qint64 copied = 0;
+
+    // 1. Reflink: the whole file at once, no data read or written
+    if (::ioctl(out, FICLONE, in) == 0) {
+        method = FastCopy::Reflink;
+        copied = st.st_size;
+        result = (!progress || progress(st.st_size, method)) ? StepDone : StepCancelled;
+    }
+
+    // 2. copy_file_range: the kernel (or the file server) moves the data
+    if (result == StepUnsupported) {
+        method = FastCopy::CopyFileRange;
+        result = kernelLoop([&](qint64 chunk) {
+            return ::copy_file_range(in, nullptr, out, nullptr, size_t(chunk), 0);
+        }, method, progress, copied);
+    }
+
+    // 3. sendfile: still no round trip through user space
+    if (result == StepUnsupported) {
+        method = FastCopy::SendFile;
+        result = kernelLoop([&](qint64 chunk) {
+            return ::sendfile(out, in, nullptr, size_t(chunk));
+        }, method, progress, copied);
+    }
+
+    // Some file systems (procfs, sysfs, certain FUSE and network mounts)
+    // report end of file to the kernel paths early. Both offsets stand
+    // where the kernel stopped, so plain reads pick up the rest.
+    if (result == StepDone && copied < st.st_size && method != FastCopy::Reflink)
+        result = StepUnsupported;
+
+    // 4. Plain read/write
+    if (result == StepUnsupported) {
+        method = FastCopy::ReadWrite;
+        ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+        result = readWriteLoop(in, out, progress, copied);
+    }
+
+    // Still short: the source shrank or the read failed quietly
+    if (result == StepDone && copied < st.st_size)
+        result = StepFailed;
+
+    if (result == StepDone)
+        ::fchmod(out, st.st_mode & 07777);   // undo the umask, like QFile::copy
+
+    ::close(in);
+    bool closed = ::close(out) == 0;
+
+    if (result != StepDone || !closed) {
+        ::unlink(targetPath.constData());
+        return false;
+    }
+
+    if (used)
+        *used = method;
+    return true;
+}
+#else
+bool copyPortable(const QString &source, const QString &target,
+                  const FastCopy::Progress &progress, FastCopy::Method *used)
+{
+    QFile in(source);
+    QFile out(target);
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly))
+        return false;
+
+    const qint64 expected = in.size();
+    qint64 copied = 0;
+
+    QByteArray buffer(BufferSize, Qt::Uninitialized);
+    for (;;) {
+        qint64 n = in.read(buffer.data(), buffer.size());
+        if (n < 0 || (n > 0 && out.write(buffer.constData(), n) != n)) {
+            out.remove();
+            return false;
+        }
+        if (n == 0)
+            break;
+        copied += n;
+        if (progress && !progress(n, FastCopy::ReadWrite)) {
+            out.remove();
+            return false;
+        }
+    }
+
+    out.close();
+    out.setPermissions(in.permissions());
+    if (out.error() != QFileDevice::NoError || copied < expected) {
+        out.remove();
+        return false;
+    }
+
+    if (used)
+        *used = FastCopy::ReadWrite;
+    return true;
+}
+#endif
+
+} // namespace
+
+bool FastCopy::copyFile(const QString &source, const QString &target,
+                        const Progress &progress, Method *used)
+{
+#ifdef Q_OS_LINUX
+    return copyLinux(source, target, progress, used);
+#else
+    return copyPortable(source, target, progress, used);
+#endif
+}
+
+FastCopy::RenameResult FastCopy::renameNoReplace(const QString &source, const QString &target)
+{
+#ifdef Q_OS_LINUX
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+    const QByteArray from = QFile::encodeName(source);
+    const QByteArray to = QFile::encodeName(target);
+
+    int rc = -1;
+#ifdef SYS_renameat2
+    rc = int(::syscall(SYS_renameat2, AT_FDCWD, from.constData(), AT_FDCWD, to.constData(),
+                       RENAME_NOREPLACE));
+#else
+    errno = ENOSYS;
+#endif
+
+    // Older kernels and some file systems (FUSE, NFS) lack the flag
+    if (rc != 0 && (errno == ENOSYS || errno == EINVAL)) {
+        struct stat st;
+        if (::lstat(to.constData(), &st) == 0)
+            return TargetExists;
+        rc = ::rename(from.constData(), to.constData());
+    }
+
+    if (rc == 0)
+        return Renamed;
+    switch (errno) {
+    case EEXIST:
+    case ENOTEMPTY:
+        return TargetExists;
+    case EXDEV:
+        return CrossDevice;
+    default:
+        return RenameFailed;
+    }
+#else
+    if (QFileInfo::exists(target) || QFileInfo(target).isSymLink())
+        return TargetExists;
+    if (QDir().rename(source, target))
+        return Renamed;
+    return sameFileSystem(source, QFileInfo(target).absolutePath()) ? RenameFailed : CrossDevice;
+#endif
+}
+
+bool FastCopy::sameFileSystem(const QString &path, const QString &otherPath)
+{
+#ifdef Q_OS_LINUX
+    // lstat for the first path, so a symlink is judged by where it lives
+    struct stat a, b;
+    if (::lstat(QFile::encodeName(path).constData(), &a) != 0
+        || ::stat(QFile::encodeName(otherPath).constData(), &b) != 0)
+        return false;
+    return a.st_dev == b.st_dev;
+#else
+    QStorageInfo a(path), b(otherPath);
+    return a.isValid() && b.isValid() && a.rootPath() == b.rootPath();
+#endif
+}
+
+QString FastCopy::methodName(Method method)
+{
+    switch (method) {
+    case NoMethod:      return QString();
+    case Reflink:       return "reflink";
+    case CopyFileRange: return "copy_file_range";
+    case SendFile:      return "sendfile";
+    case ReadWrite:     return "read/write";
+    case Rename:        return "rename";
+    }
+    return QString();
+}
@@ -0,0 +1,57 @@
+#ifndef FASTCOPY_H
+#define FASTCOPY_H
+
+#include <QString>
+
+#include <functional>
+
+// Copies one regular file with the cheapest mechanism the kernel offers.
+//
+// On Linux the order is: FICLONE (a reflink that shares extents on btrfs,
+// XFS and other CoW file systems, so no data moves at all), copy_file_range
+// (in-kernel copy, server-side on NFS 4.2 and SMB), sendfile, and finally a
+// plain read/write loop. Each step falls back to the next when the kernel or
+// file system refuses it. Elsewhere only the read/write loop is used.
+// A kernel path that stops short of the source size is finished with
+// read/write; a copy that still comes up short fails.
+//
+// Moves within one file system never copy: renameNoReplace() turns them
+// into a single rename that cannot clobber an existing target.
+class FastCopy
+{
+public:
+    enum Method {
+        NoMethod,
+        Reflink,
+        CopyFileRange,
+        SendFile,
+        ReadWrite,
+        Rename
+    };
+
+    enum RenameResult {
+        Renamed,
+        TargetExists,
+        CrossDevice,     // copy and delete instead
+        RenameFailed
+    };
+
+    // Called after every chunk with the bytes just copied and the method
+    // that copied them. Returning false cancels the copy.
+    using Progress = std::function<bool(qint64 bytes, Method method)>;
+
+    // On failure or cancel, a partially written target is removed.
+    static bool copyFile(const QString &source, const QString &target,
+                         const Progress &progress, Method *used = nullptr);
+
+    // Atomic on Linux through renameat2(RENAME_NOREPLACE); file systems
+    // without that flag get an existence check followed by rename().
+    static RenameResult renameNoReplace(const QString &source, const QString &target);
+
+    // True when both paths are on the same device, judged by st_dev
+    static bool sameFileSystem(const QString &path, const QString &otherPath);
+
+    static QString methodName(Method method);
+};
+
+#endif
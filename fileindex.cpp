@@ -0,0 +1,553 @@
+#include "fileindex.h"
+#include "namematcher.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QVector>
+#include <QQueue>
+
+#include <algorithm>
+#include <utility>
+#include <cstring>
+
+namespace {
+
+const char IndexMagic[8] = { 'F', 'E', 'I', 'D', 'X', '0', '1', '\0' };
+const quint32 IndexVersion = 1;
+const quint32 NoParent = 0xFFFFFFFFu;
+
+// Overlay size, in paths, past which a rebuild is cheaper than carrying it
+const qsizetype MinOverlayRebuild = 20000;
+
+enum EntryFlag : quint32 {
+    EntryIsDir = 0x1
+};
+
+struct IndexHeader {
+    char magic[8];
+    quint32 version;
+    quint32 entryCount;
+    quint32 trigramCount;
+    quint32 rootSize;
+    qint64 builtAt;
+    quint64 rootOffset;
+    quint64 entriesOffset;
+    quint64 namesOffset;
+    quint64 namesSize;
+    quint64 foldedOffset;
+    quint64 foldedSize;
+    quint64 trigramsOffset;
+    quint64 postingsOffset;
+    quint64 postingsCount;
+};
+
+struct IndexEntry {
+    quint32 parent;
+    quint32 nameOffset;
+    quint32 foldedOffset;
+    quint16 nameSize;
+    quint16 foldedSize;
+    quint32 flags;
+};
+
+struct IndexTrigram {
+    quint32 key;
+    quint32 first;
+    quint32 count;
+};
+
+inline quint32 trigramKey(const char *p)
+{
+    return (quint32(uchar(p[0])) << 16) | (quint32(uchar(p[1])) << 8) | quint32(uchar(p[2]));
+}
+
+inline const IndexHeader *header(const uchar *data)
+{
+    return reinterpret_cast<const IndexHeader *>(data);
+}
+
+// True if count items of itemSize bytes at offset lie inside the file and
+// start on the boundary the mapped structs need.
+bool fits(quint64 offset, quint64 count, quint64 itemSize, quint64 alignment, quint64 fileSize)
+{
+    return offset % alignment == 0
+           && offset <= fileSize
+           && count <= (fileSize - offset) / itemSize;
+}
+
+// Case-folded UTF-8 used both when building and querying, so that
+// trigrams and substring checks compare like with like.
+inline QByteArray fold(const QString &name)
+{
+    return name.toLower().toUtf8();
+}
+
+} // namespace
+
+FileIndex::~FileIndex()
+{
+    if (data)
+        file.unmap(const_cast<uchar *>(data));
+}
+
+QString FileIndex::indexPathFor(const QString &rootPath)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/index";
+    QByteArray key = QDir::cleanPath(QDir(rootPath).absolutePath()).toUtf8();
+    QString name = QString::fromLatin1(
+        QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+    return dir + "/" + name + ".idx";
+}
+
+//-------------------------------------------
+// Build
+//-------------------------------------------
+bool FileIndex::build(const QString &rootPath, const QString &indexPath)
+{
+    QString root = QDir::cleanPath(QDir(rootPath).absolutePath());
+    if (!QFileInfo(root).isDir())
+        return false;
+
+    // Stamped with the start of the walk, so that anything changed while
+    // it ran is newer than the index and picked up by reconcile()
+    const qint64 started = QDateTime::currentMSecsSinceEpoch();
+
+    QVector<IndexEntry> entries;
+    QByteArray names;
+    QByteArray folded;
+    QHash<quint32, QVector<quint32>> trigrams;
+
+    // Breadth-first walk so that every parent is stored before its children.
+    QQueue<QPair<QString, quint32>> pending;
+    pending.enqueue({ root, NoParent });
+
+    while (!pending.isEmpty()) {
+        const auto [dirPath, dirId] = pending.dequeue();
+
+        QDirIterator it(dirPath, QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files);
+        while (it.hasNext()) {
+            it.next();
+            QFileInfo info = it.fileInfo();
+
+            if (quint64(entries.size()) >= NoParent)
+                return false;
+
+            QByteArray name = info.fileName().toUtf8();
+            QByteArray lower = fold(info.fileName());
+            if (name.size() > 0xFFFF || lower.size() > 0xFFFF)
+                continue;
+
+            IndexEntry e;
+            e.parent = dirId;
+            e.nameOffset = quint32(names.size());
+            e.foldedOffset = quint32(folded.size());
+            e.nameSize = quint16(name.size());
+            e.foldedSize = quint16(lower.size());
+            e.flags = info.isDir() ? EntryIsDir : 0;
+
+            quint32 id = quint32(entries.size());
+            entries.append(e);
+            names.append(name);
+            folded.append(lower);
+
+            // One posting per distinct trigram of the name.
+            for (int i = 0; i + 3 <= lower.size(); ++i) {
+                QVector<quint32> &list = trigrams[trigramKey(lower.constData() + i)];
+                if (list.isEmpty() || list.last() != id)
+                    list.append(id);
+            }
+
+            if (info.isDir() && !info.isSymLink())
+                pending.enqueue({ info.absoluteFilePath(), id });
+        }
+    }
+
+    QVector<quint32> keys = trigrams.keys();
+    std::sort(keys.begin(), keys.end());
+
+    QVector<IndexTrigram> table;
+    QVector<quint32> postings;
+    table.reserve(keys.size());
+    for (quint32 key : std::as_const(keys)) {
+        const QVector<quint32> &list = trigrams.value(key);
+        table.append({ key, quint32(postings.size()), quint32(list.size()) });
+        postings.append(list);
+    }
+
+    QByteArray rootUtf8 = root.toUtf8();
+
+    IndexHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, IndexMagic, sizeof(h.magic));
+    h.version = IndexVersion;
+    h.entryCount = quint32(entries.size());
+    h.trigramCount = quint32(table.size());
+    h.rootSize = quint32(rootUtf8.size());
+    h.builtAt = started;
+    h.rootOffset = sizeof(IndexHeader);
+    h.entriesOffset = h.rootOffset + ((rootUtf8.size() + 7) & ~7);
+    h.trigramsOffset = h.entriesOffset + quint64(entries.size()) * sizeof(IndexEntry);
+    h.postingsOffset = h.trigramsOffset + quint64(table.size()) * sizeof(IndexTrigram);
+    h.postingsCount = quint64(postings.size());
+    h.namesOffset = h.postingsOffset + quint64(postings.size()) * sizeof(quint32);
+    h.namesSize = quint64(names.size());
+    h.foldedOffset = h.namesOffset + h.namesSize;
+    h.foldedSize = quint64(folded.size());
+
+    QDir().mkpath(QFileInfo(indexPath).absolutePath());
+
+    QSaveFile out(indexPath);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray padding(int(h.entriesOffset - h.rootOffset) - rootUtf8.size(), '\0');
+
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    out.write(rootUtf8);
+    out.write(padding);
+    out.write(reinterpret_cast<const char *>(entries.constData()),
+              qint64(entries.size()) * sizeof(IndexEntry));
+    out.write(reinterpret_cast<const char *>(table.constData()),
+              qint64(table.size()) * sizeof(IndexTrigram));
+    out.write(reinterpret_cast<const char *>(postings.constData()),
+              qint64(postings.size()) * sizeof(quint32));
+    out.write(names);
+    out.write(folded);
+
+    return out.commit();
+}
+
+//-------------------------------------------
+// Open
+//-------------------------------------------
+FileIndex *FileIndex::open(const QString &indexPath)
+{
+    FileIndex *index = new FileIndex;
+    index->file.setFileName(indexPath);
+
+    if (!index->file.open(QIODevice::ReadOnly) || index->file.size() < qint64(sizeof(IndexHeader))) {
+        delete index;
+        return nullptr;
+    }
+
+    index->size = index->file.size();
+    index->data = index->file.map(0, index->size);
+    if (!index->data) {
+        delete index;
+        return nullptr;
+    }
+
+    if (!index->isConsistent()) {
+        delete index;
+        return nullptr;
+    }
+
+    const IndexHeader *h = header(index->data);
+    index->root = QString::fromUtf8(
+        reinterpret_cast<const char *>(index->data + h->rootOffset), h->rootSize);
+    index->built = QDateTime::fromMSecsSinceEpoch(h->builtAt);
+    return index;
+}
+
+// A truncated or corrupt file must never be dereferenced, so every section
+// and every offset stored in it is checked once against the mapped size.
+// Parents always precede their children, which also rules out cycles.
+bool FileIndex::isConsistent() const
+{
+    const IndexHeader *h = header(data);
+    const quint64 fileSize = quint64(size);
+    if (std::memcmp(h->magic, IndexMagic, sizeof(IndexMagic)) != 0
+        || h->version != IndexVersion
+        || h->rootOffset < sizeof(IndexHeader)
+        || !fits(h->rootOffset, h->rootSize, 1, 1, fileSize)
+        || !fits(h->entriesOffset, h->entryCount, sizeof(IndexEntry), alignof(IndexEntry), fileSize)
+        || !fits(h->trigramsOffset, h->trigramCount, sizeof(IndexTrigram), alignof(IndexTrigram), fileSize)
+        || !fits(h->postingsOffset, h->postingsCount, sizeof(quint32), alignof(quint32), fileSize)
+        || !fits(h->namesOffset, h->namesSize, 1, 1, fileSize)
+        || !fits(h->foldedOffset, h->foldedSize, 1, 1, fileSize))
+        return false;
+
+    const IndexEntry *entries = reinterpret_cast<const IndexEntry *>(data + h->entriesOffset);
+    for (quint32 id = 0; id < h->entryCount; ++id) {
+        const IndexEntry &e = entries[id];
+        if ((e.parent != NoParent && e.parent >= id)
+            || quint64(e.nameOffset) + e.nameSize > h->namesSize
+            || quint64(e.foldedOffset) + e.foldedSize > h->foldedSize)
+            return false;
+    }
+
+    const IndexTrigram *table = reinterpret_cast<const IndexTrigram *>(data + h->trigramsOffset);
+    for (quint32 i = 0; i < h->trigramCount; ++i) {
+        if (quint64(table[i].first) + table[i].count > h->postingsCount)
+            return false;
+    }
+
+    const quint32 *postings = reinterpret_cast<const quint32 *>(data + h->postingsOffset);
+    for (quint64 i = 0; i < h->postingsCount; ++i) {
+        if (postings[i] >= h->entryCount)
+            return false;
+    }
+    return true;
+}
+
+quint32 FileIndex::entryCount() const
+{
+    return header(data)->entryCount;
+}
+
+//-------------------------------------------
+// Query
+//-------------------------------------------
+QString FileIndex::pathOf(quint32 id) const
+{
+    const IndexHeader *h = header(data);
+    const IndexEntry *entries = reinterpret_cast<const IndexEntry *>(data + h->entriesOffset);
+    const char *names = reinterpret_cast<const char *>(data + h->namesOffset);
+
+    QStringList parts;
+    while (id != NoParent) {
+        const IndexEntry &e = entries[id];
+        parts.prepend(QString::fromUtf8(names + e.nameOffset, e.nameSize));
+        id = e.parent;
+    }
+    QString prefix = root.endsWith('/') ? root : root + "/";
+    return prefix + parts.join('/');
+}
+
+bool FileIndex::isRemoved(const QString &path) const
+{
+    if (removed.isEmpty())
+        return false;
+
+    // A removed folder hides everything that was indexed below it
+    QString p = path;
+    while (p.size() > root.size()) {
+        if (removed.contains(p))
+            return true;
+        p.truncate(p.lastIndexOf('/'));
+    }
+    return false;
+}
+
+QStringList FileIndex::query(const QString &text, int limit) const
+{
+    QStringList results;
+    QByteArray needle = fold(text);
+    if (needle.isEmpty() || !data)
+        return results;
+
+    QReadLocker locker(&overlayLock);
+
+    // Paths added since the build come first; they are few and recent
+    QSet<QString> seen;
+    if (!added.isEmpty()) {
+        NameMatcher matcher(text);
+        for (auto it = added.cbegin(); it != added.cend(); ++it) {
+            if (matcher.matches(QByteArrayView(it.value()))) {
+                results.append(it.key());
+                seen.insert(it.key());
+                if (limit >= 0 && results.size() >= limit)
+                    return results;
+            }
+        }
+    }
+
+    auto accept = [&](quint32 id) {
+        QString path = pathOf(id);
+        if (seen.contains(path) || isRemoved(path))
+            return true;
+        results.append(path);
+        return limit < 0 || results.size() < limit;
+    };
+
+    const IndexHeader *h = header(data);
+    const IndexEntry *entries = reinterpret_cast<const IndexEntry *>(data + h->entriesOffset);
+    const char *folded = reinterpret_cast<const char *>(data + h->foldedOffset);
+
+    auto matches = [&](quint32 id) {
+        const IndexEntry &e = entries[id];
+        if (e.foldedSize < needle.size())
+            return false;
+        const char *begin = folded + e.foldedOffset;
+        const char *end = begin + e.foldedSize;
+        return std::search(begin, end, needle.constBegin(), needle.constEnd()) != end;
+    };
+
+    if (needle.size() < 3) {
+        // Too short for trigrams; the folded names are contiguous, so a
+        // straight scan is still only a pass over memory.
+        for (quint32 id = 0; id < h->entryCount; ++id) {
+            if (matches(id) && !accept(id))
+                break;
+        }
+        return results;
+    }
+
+    const IndexTrigram *table = reinterpret_cast<const IndexTrigram *>(data + h->trigramsOffset);
+    const IndexTrigram *tableEnd = table + h->trigramCount;
+    const quint32 *postings = reinterpret_cast<const quint32 *>(data + h->postingsOffset);
+
+    // Every trigram of the query must be present; candidates come from
+    // the rarest one and are verified against the folded name.
+    const IndexTrigram *rarest = nullptr;
+    for (int i = 0; i + 3 <= needle.size(); ++i) {
+        quint32 key = trigramKey(needle.constData() + i);
+        const IndexTrigram *t = std::lower_bound(
+            table, tableEnd, key,
+            [](const IndexTrigram &a, quint32 k) { return a.key < k; });
+        if (t == tableEnd || t->key != key)
+            return results;
+        if (!rarest || t->count < rarest->count)
+            rarest = t;
+    }
+
+    const quint32 *it = postings + rarest->first;
+    const quint32 *end = it + rarest->count;
+    for (; it != end; ++it) {
+        if (matches(*it) && !accept(*it))
+            break;
+    }
+    return results;
+}
+
+//-------------------------------------------
+// Reconcile
+//-------------------------------------------
+
+// A folder gains or loses entries only when its mtime moves, so folders
+// not touched since the build are skipped after one stat. The others are
+// listed again and compared with what the index holds for them, mapped and
+// overlay alike: a new subfolder is walked in full, a vanished entry hides
+// everything indexed below it.
+bool FileIndex::reconcile(const QStringList &folders, const std::function<bool()> &cancelled)
+{
+    const IndexHeader *h = header(data);
+    const IndexEntry *entries = reinterpret_cast<const IndexEntry *>(data + h->entriesOffset);
+    const char *names = reinterpret_cast<const char *>(data + h->namesOffset);
+
+    // The breadth-first build stores each folder's entries as one run
+    QHash<quint32, QPair<quint32, quint32>> runs;   // folder id -> [first, end)
+    for (quint32 id = 0; id < h->entryCount;) {
+        const quint32 parent = entries[id].parent;
+        quint32 end = id + 1;
+        while (end < h->entryCount && entries[end].parent == parent)
+            ++end;
+        if (runs.contains(parent))
+            return false;
+        runs.insert(parent, { id, end });
+        id = end;
+    }
+
+    QSet<QString> wanted(folders.cbegin(), folders.cend());
+    QStringList added, removed;
+
+    auto relist = [&](QPair<quint32, quint32> run, const QString &dirPath) {
+        QFileInfo info(dirPath);
+        if (!info.isDir() || info.isSymLink())
+            return;
+        if (folders.isEmpty() && info.lastModified().toMSecsSinceEpoch() < h->builtAt)
+            return;
+
+        const QString prefix = dirPath.endsWith('/') ? dirPath : dirPath + "/";
+        QSet<QString> known;
+        {
+            QReadLocker locker(&overlayLock);
+            for (quint32 id = run.first; id < run.second; ++id) {
+                const QString name = QString::fromUtf8(names + entries[id].nameOffset,
+                                                       entries[id].nameSize);
+                if (!isRemoved(prefix + name))
+                    known.insert(name);
+            }
+            for (auto it = added.cbegin(); it != added.cend(); ++it) {
+                if (it.key().size() > prefix.size() && it.key().startsWith(prefix)
+                    && it.key().indexOf('/', prefix.size()) < 0)
+                    known.insert(it.key().mid(prefix.size()));
+            }
+        }
+
+        const QFileInfoList current = QDir(dirPath).entryInfoList(
+            QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files);
+        for (const QFileInfo &child : current) {
+            if (known.remove(child.fileName()))
+                continue;
+
+            added.append(prefix + child.fileName());
+            if (child.isDir() && !child.isSymLink()) {
+                QDirIterator it(child.absoluteFilePath(),
+                                QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files,
+                                QDirIterator::Subdirectories);
+                while (it.hasNext())
+                    added.append(it.next());
+            }
+        }
+        for (const QString &name : std::as_const(known))
+            removed.append(prefix + name);
+    };
+
+    auto visit = [&](quint32 dirId, const QString &dirPath) {
+        if (!folders.isEmpty() && !wanted.remove(dirPath))
+            return;
+        relist(runs.value(dirId), dirPath);
+    };
+
+    visit(NoParent, root);
+    for (quint32 id = 0; id < h->entryCount; ++id) {
+        if (cancelled && cancelled())
+            return false;
+        if (entries[id].flags & EntryIsDir)
+            visit(id, pathOf(id));
+    }
+
+    // Folders that only exist in the overlay have nothing mapped
+    for (const QString &dirPath : std::as_const(wanted))
+        relist({ 0, 0 }, dirPath);
+
+    if (!removed.isEmpty())
+        removePaths(removed);
+    if (!added.isEmpty())
+        addPaths(added);
+    return true;
+}
+
+bool FileIndex::overlayIsLarge() const
+{
+    QReadLocker locker(&overlayLock);
+    const qsizetype limit = qMax<qsizetype>(MinOverlayRebuild, entryCount() / 20);
+    return added.size() + removed.size() > limit;
+}
+
+//-------------------------------------------
+// Live overlay
+//-------------------------------------------
+// A path stays in removed when it comes back: for a folder, the mapped
+// entries below it describe the old contents and must stay hidden, and the
+// new contents arrive as overlay entries of their own.
+void FileIndex::addPaths(const QStringList &paths)
+{
+    QWriteLocker locker(&overlayLock);
+    for (const QString &path : paths)
+        added.insert(path, path.mid(path.lastIndexOf('/') + 1).toUtf8());
+}
+
+void FileIndex::removePaths(const QStringList &paths)
+{
+    QWriteLocker locker(&overlayLock);
+    for (const QString &path : paths) {
+        removed.insert(path);
+
+        // Drop overlay entries that lived in a removed folder too
+        const QString prefix = path + "/";
+        added.remove(path);
+        for (auto it = added.begin(); it != added.end();) {
+            if (it.key().startsWith(prefix))
+                it = added.erase(it);
+            else
+                ++it;
+        }
+    }
+}
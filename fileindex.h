@@ -0,0 +1,71 @@
+#ifndef FILEINDEX_H
+#define FILEINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QReadWriteLock>
+
+#include <functional>
+
+// Persistent filename index for one root directory.
+//
+// The index is written once by build() and then memory-mapped by open().
+// Every path component is stored once (entries point at their parent), and
+// a trigram table over the lower-cased names lets query() jump straight to
+// the few candidates that can contain the search text.
+//
+// The mapped file is never rewritten in place. Changes reported after the
+// build are kept in a small in-memory overlay that query() consults as well.
+// Changes made while nothing was watching are found by reconcile().
+class FileIndex
+{
+public:
+    ~FileIndex();
+
+    static QString indexPathFor(const QString &rootPath);
+    static bool build(const QString &rootPath, const QString &indexPath);
+    static FileIndex *open(const QString &indexPath);
+
+    QString rootPath() const { return root; }
+    QDateTime builtAt() const { return built; }
+    quint32 entryCount() const;
+
+    QStringList query(const QString &text, int limit = -1) const;
+
+    // Brings the overlay up to date with folders modified since builtAt(),
+    // or with exactly the given folders. Blocking; returns false if
+    // cancelled or the index needs a rebuild.
+    bool reconcile(const QStringList &folders = {},
+                   const std::function<bool()> &cancelled = {});
+
+    // True once the overlay has grown to where rebuilding is cheaper
+    // than consulting it on every query
+    bool overlayIsLarge() const;
+
+    void addPaths(const QStringList &paths);
+    void removePaths(const QStringList &paths);
+
+private:
+    FileIndex() = default;
+
+    bool isConsistent() const;
+    QString pathOf(quint32 id) const;
+    bool isRemoved(const QString &path) const;
+
+    QFile file;
+    const uchar *data = nullptr;
+    qint64 size = 0;
+
+    QString root;
+    QDateTime built;
+
+    mutable QReadWriteLock overlayLock;
+    QHash<QString, QByteArray> added;   // path -> UTF-8 file name
+    QSet<QString> removed;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "iconcache.h"
+
+#include <QFileIconProvider>
+#include <QHash>
+#include <QMimeDatabase>
+
+namespace {
+
+struct Icons
+{
+    QIcon folder;
+    QIcon file;
+    QHash<QString, QIcon> bySuffix;
+    QHash<QString, QIcon> byMimeType;
+};
+
+Icons &icons()
+{
+    static Icons shared = []() {
+        QFileIconProvider provider;
+        Icons result;
+        result.folder = provider.icon(QFileIconProvider::Folder);
+        result.file = provider.icon(QFileIconProvider::File);
+        return result;
+    }();
+    return shared;
+}
+
+QIcon iconForMimeType(Icons &cache, const QMimeType &type)
+{
+    auto it = cache.byMimeType.constFind(type.name());
+    if (it != cache.byMimeType.constEnd())
+        return it.value();
+
+    QIcon icon = QIcon::fromTheme(type.iconName());
+    if (icon.isNull())
+        icon = QIcon::fromTheme(type.genericIconName());
+    if (icon.isNull())
+        icon = cache.file;
+
+    cache.byMimeType.insert(type.name(), icon);
+    return icon;
+}
+
+} // namespace
+
+QIcon IconCache::folder()
+{
+    return icons().folder;
+}
+
+QIcon IconCache::forFile(const QString &fileName)
+{
+    Icons &cache = icons();
+
+    const int dot = fileName.lastIndexOf('.');
+    if (dot <= fileName.lastIndexOf('/') + 1)
+        return cache.file;
+
+    const QString suffix = fileName.mid(dot + 1).toLower();
+    auto it = cache.bySuffix.constFind(suffix);
+    if (it != cache.bySuffix.constEnd())
+        return it.value();
+
+    // Looked up by the suffix alone, as it is cached: the full name could
+    // match a longer pattern ("x.tar.gz") and file that type under "gz"
+    static const QMimeDatabase mimeDatabase;
+    const QMimeType type = mimeDatabase.mimeTypeForFile("file." + suffix,
+                                                        QMimeDatabase::MatchExtension);
+    const QIcon icon = type.isDefault() ? cache.file : iconForMimeType(cache, type);
+
+    cache.bySuffix.insert(suffix, icon);
+    return icon;
+}
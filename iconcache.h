@@ -0,0 +1,27 @@
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <QIcon>
+#include <QString>
+
+// Icons for file listings, shared by every model in the process.
+//
+// Files get the icon of their MIME type, worked out from the name alone,
+// so no file is opened or stat'ed. Each suffix is looked up once, the
+// last one alone ("x.tar.gz" shows as gzip), and suffixes of the same
+// type share one QIcon. Meant to be called from
+// data() or paint(), so only rows that are shown ever ask.
+//
+// GUI thread only.
+class IconCache
+{
+public:
+    static QIcon folder();
+    static QIcon forFile(const QString &fileName);   // a name or a path
+    static QIcon forEntry(const QString &fileName, bool isDir)
+    {
+        return isDir ? folder() : forFile(fileName);
+    }
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include "listingcache.h"
+#include "perftrace.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// A small first chunk gets rows on screen quickly; the rest go in bulk
+const int FirstChunkEntries = 256;
+const int ChunkEntries = 16384;
+
+const qint64 DefaultBudget = 256 * 1024 * 1024;
+const int MaxPrefetchJobs = 2;
+const int MaxPendingPrefetches = 4;
+
+#ifdef Q_OS_LINUX
+// Layout of the records returned by getdents64(2)
+struct LinuxDirent64
+{
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+const size_t DirentBufferSize = 64 * 1024;
+#endif
+
+} // namespace
+
+FolderStamp FolderStamp::of(const QString &path)
+{
+    FolderStamp stamp;
+#ifdef Q_OS_LINUX
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) == 0) {
+        stamp.inode = quint64(st.st_ino);
+        stamp.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+#else
+    const QFileInfo info(path);
+    if (info.exists())
+        stamp.mtimeNs = info.lastModified().toMSecsSinceEpoch() * 1000000;
+#endif
+    return stamp;
+}
+
+ListingCache::ListingCache(QObject *parent)
+    : QObject(parent), budget(DefaultBudget)
+{
+}
+
+ListingCache::~ListingCache()
+{
+    stopping = true;
+    for (QFuture<void> &job : jobs)
+        job.waitForFinished();
+}
+
+QSharedPointer<const Listing> ListingCache::find(const QString &path)
+{
+    auto it = listings.find(path);
+    if (it == listings.end())
+        return {};
+
+    QSharedPointer<const Listing> listing = it.value();
+    recent.removeOne(path);
+    recent.append(path);
+    return listing;
+}
+
+void ListingCache::insert(const QString &path, QSharedPointer<const Listing> listing)
+{
+    if (!listing->stamp.isValid())
+        return;
+
+    auto it = listings.find(path);
+    if (it != listings.end()) {
+        used -= it.value()->memoryUsage();
+        recent.removeOne(path);
+    }
+
+    listings.insert(path, listing);
+    used += listing->memoryUsage();
+    recent.append(path);
+    evict();
+}
+
+void ListingCache::clear()
+{
+    listings.clear();
+    recent.clear();
+    pending.clear();
+    used = 0;
+    ++clears;
+}
+
+void ListingCache::setMemoryBudget(qint64 bytes)
+{
+    budget = bytes;
+    evict();
+}
+
+void ListingCache::evict()
+{
+    while (used > budget && !recent.isEmpty()) {
+        const QString oldest = recent.takeFirst();
+        used -= listings.take(oldest)->memoryUsage();
+    }
+}
+
+void ListingCache::prefetch(const QString &path, const SortSpec &spec)
+{
+    if (path.isEmpty() || listings.contains(path) || inFlight.contains(path))
+        return;
+
+    pending.removeOne(path);
+    pending.append(path);
+    while (pending.size() > MaxPendingPrefetches)
+        pending.removeFirst();
+    prefetchSpec = spec;
+
+    startPrefetch();
+}
+
+// Newest requests first; what the user looked at last matters most
+void ListingCache::startPrefetch()
+{
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                              [](const QFuture<void> &job) { return job.isFinished(); }),
+               jobs.end());
+
+    while (int(inFlight.size()) < MaxPrefetchJobs && !pending.isEmpty()) {
+        const QString path = pending.takeLast();
+        inFlight.insert(path);
+
+        jobs.push_back(QtConcurrent::run([this, path, spec = prefetchSpec,
+                                          cleared = clears.load()]() {
+            auto stale = [this, cleared]() { return stopping.load() || clears.load() != cleared; };
+            auto listing = QSharedPointer<Listing>::create();
+            const bool complete = readFolder(path, stale, [&](QSharedPointer<EntryTable> chunk) {
+                listing->table.append(*chunk);
+            }, &listing->stamp);
+            if (complete) {
+                listing->order = EntrySorter::sort(listing->table, spec, stale);
+                listing->spec = spec;
+            }
+
+            QMetaObject::invokeMethod(this, [this, path, listing, complete, cleared]() {
+                inFlight.remove(path);
+                if (complete && !stopping && clears.load() == cleared)
+                    insert(path, listing);
+                startPrefetch();
+            }, Qt::QueuedConnection);
+        }));
+    }
+}
+
+bool ListingCache::readFolder(const QString &path, const std::function<bool()> &stale,
+                              const std::function<void(QSharedPointer<EntryTable>)> &deliver,
+                              FolderStamp *stamp)
+{
+    PerfScope scope("read folder", path);
+    auto chunk = QSharedPointer<EntryTable>::create();
+    int limit = FirstChunkEntries;
+
+    auto flushIfFull = [&]() {
+        if (chunk->count() < limit)
+            return;
+        deliver(chunk);
+        chunk = QSharedPointer<EntryTable>::create();
+        limit = ChunkEntries;
+    };
+
+#ifdef Q_OS_LINUX
+    const int fd = ::open(QFile::encodeName(path).constData(),
+                          O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat folder;
+    if (::fstat(fd, &folder) == 0) {
+        stamp->inode = quint64(folder.st_ino);
+        stamp->mtimeNs = qint64(folder.st_mtim.tv_sec) * 1000000000 + folder.st_mtim.tv_nsec;
+    }
+
+    // A failed getdents64 is not the end of the folder
+    bool complete = false;
+    std::vector<char> buffer(DirentBufferSize);
+    for (;;) {
+        const long n = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n == 0)
+            complete = true;
+        if (n <= 0 || stale())
+            break;
+
+        for (long offset = 0; offset < n;) {
+            const LinuxDirent64 *d =
+                reinterpret_cast<const LinuxDirent64 *>(buffer.data() + offset);
+            offset += d->d_reclen;
+
+            if (d->d_name[0] == '.')
+                continue;
+
+            struct stat st;
+            if (::fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+
+            quint64 kind = 0;
+            if (S_ISLNK(st.st_mode)) {
+                kind |= EntryTable::SymLink;
+                struct stat target;
+                if (::fstatat(fd, d->d_name, &target, 0) == 0)
+                    st = target;
+            }
+            if (S_ISDIR(st.st_mode))
+                kind |= EntryTable::Dir;
+
+            chunk->append(d->d_name, std::strlen(d->d_name),
+                          kind & EntryTable::Dir ? 0 : qint64(st.st_size),
+                          qint64(st.st_mtim.tv_sec), kind);
+            flushIfFull();
+        }
+    }
+    ::close(fd);
+    if (!complete)
+        return false;
+#else
+    if (!QFileInfo(path).isDir())
+        return false;
+    *stamp = FolderStamp::of(path);
+    QDirIterator it(path, QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files);
+    while (it.hasNext()) {
+        it.next();
+        if (stale())
+            return false;
+
+        const QFileInfo info = it.fileInfo();
+        quint64 kind = 0;
+        if (info.isSymLink())
+            kind |= EntryTable::SymLink;
+        if (info.isDir())
+            kind |= EntryTable::Dir;
+
+        const QByteArray name = info.fileName().toUtf8();
+        chunk->append(name.constData(), size_t(name.size()),
+                      info.isDir() ? 0 : info.size(),
+                      info.lastModified().toSecsSinceEpoch(), kind);
+        flushIfFull();
+    }
+#endif
+
+    if (stale())
+        return false;
+    if (chunk->count() > 0)
+        deliver(chunk);
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef LISTINGCACHE_H
+#define LISTINGCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QFuture>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "entrytable.h"
+#include "entrysorter.h"
+
+// When a folder was last changed, to tell whether a listing still holds
+struct FolderStamp
+{
+    quint64 inode = 0;
+    qint64 mtimeNs = 0;
+
+    bool isValid() const { return mtimeNs != 0; }
+    bool operator==(const FolderStamp &other) const
+    {
+        return inode == other.inode && mtimeNs == other.mtimeNs;
+    }
+    bool operator!=(const FolderStamp &other) const { return !(*this == other); }
+
+    static FolderStamp of(const QString &path);
+};
+
+// One folder as it was read, with its sort order if it has been sorted
+struct Listing
+{
+    EntryTable table;
+    std::vector<quint32> order;   // empty until sorted
+    SortSpec spec;
+    FolderStamp stamp;
+
+    qint64 memoryUsage() const
+    {
+        return table.memoryUsage() + qint64(order.capacity() * sizeof(quint32));
+    }
+};
+
+// Recently read folders, kept so going back to one is instant.
+//
+// Listings are dropped least recently used first once the memory budget
+// is exceeded. Each carries its folder's inode and mtime as read; find()
+// does not stat, so the caller compares the stamp off the GUI thread.
+// Adds, removes and renames change the stamp; a file changing size in
+// place does not.
+//
+// prefetch() reads and sorts folders the user is likely to open next on
+// the worker pool. Only the newest few requests are kept; older ones
+// are dropped if they have not started.
+class ListingCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ListingCache(QObject *parent = nullptr);
+    ~ListingCache() override;
+
+    // The listing last kept for path, or null; it may be out of date
+    QSharedPointer<const Listing> find(const QString &path);
+    void insert(const QString &path, QSharedPointer<const Listing> listing);
+
+    void prefetch(const QString &path, const SortSpec &spec);
+    void clear();
+
+    void setMemoryBudget(qint64 bytes);
+
+    // Reads path and hands entries over in chunks, the first one small.
+    // Hidden entries are left out, as in the QFileSystemModel listing.
+    // stamp is taken before reading, so a change during the read shows.
+    // False if the folder could not be read to the end or stale() turned
+    // true; what was delivered is then incomplete and must not be kept.
+    static bool readFolder(const QString &path, const std::function<bool()> &stale,
+                           const std::function<void(QSharedPointer<EntryTable>)> &deliver,
+                           FolderStamp *stamp);
+
+private:
+    void startPrefetch();
+    void evict();
+
+    QHash<QString, QSharedPointer<const Listing>> listings;
+    QStringList recent;           // least recently used first
+    qint64 budget;
+    qint64 used = 0;
+
+    QStringList pending;          // newest last
+    SortSpec prefetchSpec;
+    QSet<QString> inFlight;
+    std::vector<QFuture<void>> jobs;
+    std::atomic<bool> stopping { false };
+    std::atomic<quint64> clears { 0 };   // prefetches from before a clear() are dropped
+};
+
+#endif
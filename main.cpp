@@ -1,8 +1,13 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "commandline.h"
 
 int main(int argc, char *argv[])
 {
+    // Scripted runs never create a window, so they work without a display
+    if (CommandLine::wanted(argc, argv))
+        return CommandLine::run(argc, argv);
+
     QApplication app(argc, argv);
     MainWindow w;
     w.show();
@@ -1,15 +1,22 @@
 #include "mainwindow.h"
-#ifdef Q_OS_WIN
-#include <windows.h>
-#include <shellapi.h>
-#endif
 #include "propertiesdialog.h"
-#include <QStandardItemModel>
+#include "fileindex.h"
+#include "transferpanel.h"
+#include "statuscounter.h"
+#include "directorymodel.h"
+#include "thumbnailer.h"
+#include "iconcache.h"
+#include "searchresultsmodel.h"
+#include "pathresolver.h"
+#include "pathcompleter.h"
+#include "perftrace.h"
+#include "stallwatchdog.h"
+#include "perfpanel.h"
 #include <QStyledItemDelegate>
 
 #include <QPainter>
 #include <QStyleOptionViewItem>
-#include <QFileIconProvider>
+#include <QElapsedTimer>
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -24,6 +31,10 @@
 #include <QDirIterator>
 #include <QTreeWidgetItem>
 #include <QPushButton>
+#include <QComboBox>
+#include <QDockWidget>
+#include <QLabel>
+#include <QLocale>
 #include <QInputDialog>
 #include <QStandardPaths>
 #include <utility>   // for std::as_const
@@ -31,76 +42,129 @@
 #include <QtConcurrent>
 
 #include <QKeyEvent>
+#include <QScrollBar>
+#include <QTextLayout>
+#include <QCache>
+#include <functional>
 
 class HighlightDelegate : public QStyledItemDelegate {
 public:
     using QStyledItemDelegate::QStyledItemDelegate;
 
+    // Picture to show instead of the model's icon, if one is ready
+    std::function<QPixmap(const QModelIndex &)> thumbnailFor;
+    bool showThumbnails = false;
+
     void paint(QPainter *painter,
                const QStyleOptionViewItem &option,
                const QModelIndex &index) const override
     {
         painter->save();
 
-        QString text = index.data(Qt::DisplayRole).toString();
-        QString key  = index.data(Qt::UserRole + 1).toString();
-
+        // Search rows are painted from the cache alone: once a row has been
+        // laid out, its text, icon and thumbnail are not asked for again
         QStyleOptionViewItem opt(option);
-        initStyleOption(&opt, index);
-        opt.text.clear();
+        QString text;
+        const auto *results = qobject_cast<const SearchResultsModel *>(index.model());
+        const CachedRow *cached = results ? rowFor(*results, index, option.font) : nullptr;
+        if (cached) {
+            opt.index = index;
+            opt.features |= QStyleOptionViewItem::HasDecoration;
+            opt.icon = cached->icon;
+            if (showThumbnails) {
+                if (cached->thumbnail.isNull() && thumbnailFor) {
+                    const QPixmap thumbnail = thumbnailFor(index);
+                    if (!thumbnail.isNull())
+                        cached->thumbnail = QIcon(thumbnail);
+                }
+                if (!cached->thumbnail.isNull())
+                    opt.icon = cached->thumbnail;
+            }
+        } else {
+            initStyleOption(&opt, index);
+            text = std::exchange(opt.text, QString());
+            if (showThumbnails && thumbnailFor) {
+                const QPixmap thumbnail = thumbnailFor(index);
+                if (!thumbnail.isNull())
+                    opt.icon = QIcon(thumbnail);
+            }
+        }
 
         opt.widget->style()->drawControl(
             QStyle::CE_ItemViewItem, &opt, painter);
 
         QRect r = option.rect.adjusted(32, 0, 0, 0); // after icon
 
-        int pos = key.isEmpty()
-                      ? -1
-                      : text.toLower().indexOf(key.toLower());
-
-        if (pos >= 0) {
-            QFontMetrics fm(option.font);
-
-            painter->drawText(r, Qt::AlignVCenter,
-                              text.left(pos));
-
-            painter->setPen(Qt::red);
-            painter->drawText(
-                r.adjusted(fm.horizontalAdvance(text.left(pos)), 0, 0, 0),
-                Qt::AlignVCenter,
-                text.mid(pos, key.length()));
-
-            painter->setPen(Qt::black);
-            painter->drawText(
-                r.adjusted(fm.horizontalAdvance(
-                               text.left(pos + key.length())), 0, 0, 0),
-                Qt::AlignVCenter,
-                text.mid(pos + key.length()));
+        if (cached) {
+            // The layout is one unwrapped line; keep long ones in their cell
+            const qreal lineHeight = cached->layout.lineAt(0).height();
+            painter->setClipRect(r, Qt::IntersectClip);
+            cached->layout.draw(painter, QPointF(r.left(), r.top() + (r.height() - lineHeight) / 2),
+                                {}, r);
         } else {
             painter->drawText(r, Qt::AlignVCenter, text);
         }
 
         painter->restore();
     }
-};
-
 
+private:
+    struct CachedRow
+    {
+        QTextLayout layout;
+        QIcon icon;
+        mutable QIcon thumbnail;   // once the thumbnailer has one
+    };
 
-static QStringList selectedPaths(QListView *view,
-                                 QFileSystemModel *model,
-                                 QSortFilterProxyModel *proxy)
-{
-    QStringList paths;
-    QModelIndexList indexes = view->selectionModel()->selectedIndexes();
+    // Search rows are laid out once, highlights included, and then only
+    // drawn; the icon is looked up along with them. Rows never change
+    // between resets, so the row number and the model generation make a
+    // safe key.
+    const CachedRow *rowFor(const SearchResultsModel &results, const QModelIndex &index,
+                            const QFont &font) const
+    {
+        if (font != layoutFont || results.generation() != layoutGeneration) {
+            layouts.clear();
+            layoutFont = font;
+            layoutGeneration = results.generation();
+        }
+        const int row = index.row();
+        if (const CachedRow *cached = layouts.object(row))
+            return cached;
+
+        const QString text = index.data(Qt::DisplayRole).toString();
+        QList<QTextLayout::FormatRange> formats;
+        for (const SearchResultsModel::Span &span : results.spans(row)) {
+            QTextLayout::FormatRange range;
+            range.start = span.start;
+            range.length = span.length;
+            range.format.setForeground(Qt::red);
+            formats.append(range);
+        }
 
-    QSet<QString> unique;
-    for (const QModelIndex &proxyIdx : std::as_const(indexes)) {
-        QModelIndex srcIdx = proxy->mapToSource(proxyIdx);
-        unique.insert(model->filePath(srcIdx));
+        CachedRow *cached = new CachedRow;
+        QTextLayout *layout = &cached->layout;
+        layout->setText(text);
+        layout->setFont(font);
+        QTextOption textOption;
+        textOption.setWrapMode(QTextOption::NoWrap);
+        layout->setTextOption(textOption);
+        layout->setFormats(formats);
+        layout->beginLayout();
+        layout->createLine().setNumColumns(int(text.size()));
+        layout->endLayout();
+
+        cached->icon = IconCache::forEntry(results.path(row),
+                                           index.data(SearchResultsModel::IsDirRole).toBool());
+
+        layouts.insert(row, cached);
+        return cached;
     }
-    return unique.values();
-}
 
+    mutable QCache<int, CachedRow> layouts { 1024 };
+    mutable QFont layoutFont;
+    mutable quint64 layoutGeneration = 0;
+};
 
 
 
@@ -132,10 +196,92 @@ MainWindow::MainWindow(QWidget *parent)
     QModelIndex proxy = proxyModel->mapFromSource(src);
     list->setRootIndex(proxy);
 
-    list->setItemDelegate(new HighlightDelegate(list));
+    HighlightDelegate *delegate = new HighlightDelegate(list);
+    list->setItemDelegate(delegate);
+
+    // Optional flat listing for huge folders
+    dirModel = new DirectoryModel(this);
+    connect(dirModel, &QAbstractItemModel::rowsInserted, this, &MainWindow::updateStatusBar);
+    auto selectionStale = [this]() {
+        listSelectionStale = true;
+        updateStatusBar();
+    };
+    connect(dirModel, &QAbstractItemModel::modelReset, this, selectionStale);
+    connect(dirModel, &QAbstractItemModel::rowsRemoved, this, selectionStale);
+    connect(dirModel, &QAbstractItemModel::dataChanged, this, selectionStale);
+    connect(dirModel, &DirectoryModel::firstRowsShown, this, [this](qint64 elapsedMs) {
+        statusBar()->showMessage(QString("Loading… first rows after %1 ms").arg(elapsedMs));
+    });
+    connect(dirModel, &DirectoryModel::loadFinished, this, [this](int entries, qint64 elapsedMs) {
+        const qint64 perEntry = entries > 0 ? dirModel->memoryUsage() / entries : 0;
+        statusBar()->showMessage(QString("Loaded %1 items in %2 ms, %3 bytes per item")
+                                     .arg(entries).arg(elapsedMs).arg(perEntry));
+        PerfTrace::complete("listing load", QString("%1 (%2 items)").arg(dirModel->rootPath()).arg(entries),
+                            elapsedMs * 1000000);
+        updateStatusBar();
+    });
+    connect(dirModel, &DirectoryModel::sortFinished, this, [this](int entries, qint64 elapsedMs) {
+        statusBar()->showMessage(QString("Sorted %1 items in %2 ms").arg(entries).arg(elapsedMs));
+        PerfTrace::complete("listing sort", QString("%1 items").arg(entries), elapsedMs * 1000000);
+    });
+
+    searchModel = new SearchResultsModel(this);
+
+    // Thumbnails are asked for in view order as the list scrolls
+    thumbnailer = new Thumbnailer(this);
+    delegate->thumbnailFor = [this](const QModelIndex &index) {
+        return thumbnailer->thumbnail(pathAt(index));
+    };
+    connect(thumbnailer, &Thumbnailer::thumbnailReady,
+            list->viewport(), qOverload<>(&QWidget::update));
+    thumbnailTimer = new QTimer(this);
+    thumbnailTimer->setSingleShot(true);
+    thumbnailTimer->setInterval(30);
+    connect(thumbnailTimer, &QTimer::timeout, this, &MainWindow::scheduleThumbnails);
+
+    // Throttled rather than debounced, so a long scroll keeps loading
+    auto thumbnailsDue = [this]() {
+        if (!thumbnailTimer->isActive())
+            thumbnailTimer->start();
+    };
+    for (QScrollBar *bar : { list->verticalScrollBar(), list->horizontalScrollBar() }) {
+        connect(bar, &QScrollBar::valueChanged, this, thumbnailsDue);
+        connect(bar, &QScrollBar::rangeChanged, this, thumbnailsDue);
+    }
+    for (QAbstractItemModel *listing : { static_cast<QAbstractItemModel *>(proxyModel),
+                                         static_cast<QAbstractItemModel *>(dirModel),
+                                         static_cast<QAbstractItemModel *>(searchModel) }) {
+        connect(listing, &QAbstractItemModel::rowsInserted, this, thumbnailsDue);
+        connect(listing, &QAbstractItemModel::layoutChanged, this, thumbnailsDue);
+    }
+
+    searchEngine = new SearchEngine(this);
+    connect(searchEngine, &SearchEngine::resultsReady,
+            this, &MainWindow::onSearchResults);
+    connect(searchEngine, &SearchEngine::finished,
+            this, &MainWindow::onSearchFinished);
+
+    transferEngine = new TransferEngine(this);
+    connect(transferEngine, &TransferEngine::jobFinished,
+            this, &MainWindow::onTransferFinished);
+
+    // Each job is traced from queueing to its end
+    connect(transferEngine, &TransferEngine::jobAdded, this,
+            [this](int id, TransferEngine::JobKind kind, const QStringList &sources) {
+        static const char *const names[] = { "copy", "move", "trash", "delete" };
+        jobTraces.insert(id, PerfTrace::begin(names[kind],
+                                              QString("%1 item(s)").arg(sources.size())));
+    });
+
+    statusCounter = new StatusCounter(model, this);
+    statusCounter->setRootPath(currentPath);
+    statusCounter->setSelectionModel(list->selectionModel(), proxyModel);
+    connect(statusCounter, &StatusCounter::countsChanged,
+            this, &MainWindow::updateStatusBar);
 
-    //searchModel = new QStringListModel(this);
-    searchModel = new QStandardItemModel(this);
+    changeTracker = new ChangeTracker(this);
+    connect(changeTracker, &ChangeTracker::changed,
+            this, &MainWindow::onFileSystemChanged);
 
     // 2️⃣ Proxy model (SECOND)
 
@@ -164,6 +310,24 @@ currentPath = QDir::homePath();
     addressBar->setText(QDir::homePath());
     connect(addressBar, &QLineEdit::returnPressed, this, &MainWindow::navigateToPath);
 
+    pathResolver = new PathResolver(this);
+    connect(pathResolver, &PathResolver::resolved, this,
+            [this](quint64 request, const PathResolver::Result &result) {
+        if (request != openRequest)
+            return;
+        openRequest = 0;
+        statusBar()->clearMessage();
+        if (result.status != PathResolver::Ok) {
+            QMessageBox::warning(this, "Error", PathResolver::describe(result.status));
+            return;
+        }
+        setDirectory(result.path);
+    });
+
+    pathCompleter = new PathCompleter(addressBar, pathResolver, this);
+    pathCompleter->recordVisit(currentPath);
+    connect(pathCompleter, &PathCompleter::pathChosen, this, &MainWindow::openPath);
+
 
     //------------------------------
     // Search bar
@@ -185,8 +349,17 @@ currentPath = QDir::homePath();
             this, &MainWindow::startSearch);
 
 
+    searchScope = new QComboBox(this);
+    searchScope->addItem("Names", SearchEngine::NameSearch);
+    searchScope->addItem("Contents", SearchEngine::ContentSearch);
+    searchScope->setToolTip("Search file names or file contents.\n"
+                            "In contents mode, /pattern/ is a regular expression.");
+    connect(searchScope, &QComboBox::currentIndexChanged,
+            this, &MainWindow::startSearch);
+
     QHBoxLayout *searchLayout = new QHBoxLayout();
     searchLayout->addWidget(searchBar);
+    searchLayout->addWidget(searchScope);
 
 
     //------------------------------
@@ -194,6 +367,9 @@ currentPath = QDir::homePath();
     //------------------------------
     QToolBar *toolbar = addToolBar("Main Toolbar");
     QAction *backAct = toolbar->addAction("Back");
+    QAction *forwardAct = toolbar->addAction("Forward");
+    backAct->setShortcut(QKeySequence::Back);
+    forwardAct->setShortcut(QKeySequence::Forward);
     QAction *refreshAct = toolbar->addAction("Refresh");
     QAction *newFileAct = toolbar->addAction("New File");
     QAction *newFolderAct = toolbar->addAction("New Folder");
@@ -210,6 +386,27 @@ currentPath = QDir::homePath();
         else
             setThumbnailViewMode();
     });
+    sortBox = new QComboBox(this);
+    sortBox->addItem("Name", DirectoryModel::ByName);
+    sortBox->addItem("Size", DirectoryModel::BySize);
+    sortBox->addItem("Modified", DirectoryModel::ByModified);
+    sortBox->addItem("Type", DirectoryModel::ByType);
+    sortBox->setToolTip("Sort order, folders first");
+    toolbar->addWidget(sortBox);
+    connect(sortBox, &QComboBox::currentIndexChanged, this, &MainWindow::applySortOrder);
+
+    QAction *rebuildIndexAct = toolbar->addAction("Rebuild Index");
+    rebuildIndexAct->setToolTip("Walk the current folder again for the search index");
+    connect(rebuildIndexAct, &QAction::triggered, this, &MainWindow::rebuildSearchIndex);
+
+    QAction *compactAct = toolbar->addAction("Compact Listing");
+    compactAct->setCheckable(true);
+    connect(compactAct, &QAction::toggled, this, [this](bool on) {
+        compactListing = on;
+        if (!inSearchMode)
+            showDirectory();
+        updateStatusBar();
+    });
 
     // keyboards sequence
     // ===============================
@@ -264,6 +461,7 @@ currentPath = QDir::homePath();
 
 
     connect(backAct, &QAction::triggered, this, &MainWindow::goBack);
+    connect(forwardAct, &QAction::triggered, this, &MainWindow::goForward);
     connect(refreshAct, &QAction::triggered, this, &MainWindow::refreshView);
     connect(newFileAct, &QAction::triggered, this, &MainWindow::createFile);
     connect(newFolderAct, &QAction::triggered, this, &MainWindow::createFolder);
@@ -287,9 +485,39 @@ currentPath = QDir::homePath();
     mainLayout->addWidget(rightContainer);
     setCentralWidget(central);
 
+    //------------------------------
+    // Transfers (shown on first paste)
+    //------------------------------
+    transferDock = new QDockWidget("Transfers", this);
+    transferDock->setWidget(new TransferPanel(transferEngine, transferDock));
+    addDockWidget(Qt::BottomDockWidgetArea, transferDock);
+    transferDock->hide();
+
+    //------------------------------
+    // Performance (Ctrl+Shift+P)
+    //------------------------------
+    watchdog = new StallWatchdog(this);
+    perfDock = new QDockWidget("Performance", this);
+    perfDock->setWidget(new PerfPanel(watchdog, perfDock));
+    addDockWidget(Qt::BottomDockWidgetArea, perfDock);
+    perfDock->hide();
+    QAction *perfAct = perfDock->toggleViewAction();
+    perfAct->setShortcut(QKeySequence("Ctrl+Shift+P"));
+    perfAct->setShortcutContext(Qt::ApplicationShortcut);
+    addAction(perfAct);
+
+    // Trashing is a quick rename, not worth popping the panel up for
+    connect(transferEngine, &TransferEngine::jobAdded,
+            this, [this](int, TransferEngine::JobKind kind) {
+                if (kind != TransferEngine::Trash)
+                    transferDock->show();
+            });
+
     //------------------------------
     // Status Bar
     //------------------------------
+    statusLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(statusLabel);
     statusBar()->showMessage("Ready");
     updateStatusBar();
 
@@ -404,25 +632,98 @@ QModelIndex MainWindow::currentIndex() const
     return list->currentIndex();
 }
 
+// Full path of a row in whichever model the view is showing
+QString MainWindow::pathAt(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return QString();
+    if (inSearchMode)
+        return index.data(Qt::UserRole).toString();
+    if (compactListing)
+        return dirModel->filePath(index);
+    return model->filePath(proxyModel->mapToSource(index));
+}
+
+QStringList MainWindow::selectedPaths() const
+{
+    const QModelIndexList indexes = list->selectionModel()->selectedIndexes();
+
+    QSet<QString> unique;
+    for (const QModelIndex &index : indexes)
+        unique.insert(pathAt(index));
+    return unique.values();
+}
+
+// The folder under the cursor is a likely next step too
+void MainWindow::prefetchCurrent()
+{
+    if (!compactListing || inSearchMode)
+        return;
+
+    const QModelIndex index = list->currentIndex();
+    if (dirModel->isDir(index))
+        dirModel->prefetch(dirModel->filePath(index));
+}
+
+// Puts the current folder in the view, through whichever listing is on
+void MainWindow::showDirectory()
+{
+    if (compactListing) {
+        if (list->model() != dirModel) {
+            list->setModel(dirModel);
+            listSelectionStale = true;
+            statusCounter->setSelectionModel(nullptr, nullptr);
+        }
+        if (dirModel->rootPath() != currentPath)
+            dirModel->setRootPath(currentPath);
+        list->setRootIndex(QModelIndex());
+        connect(list->selectionModel(), &QItemSelectionModel::selectionChanged,
+                this, &MainWindow::updateListSelection, Qt::UniqueConnection);
+        connect(list->selectionModel(), &QItemSelectionModel::currentChanged,
+                this, &MainWindow::prefetchCurrent, Qt::UniqueConnection);
+
+        // Up is a likely next step
+        const QDir parent = QFileInfo(currentPath).dir();
+        if (parent.absolutePath() != currentPath)
+            dirModel->prefetch(parent.absolutePath());
+    } else {
+        if (list->model() != proxyModel) {
+            list->setModel(proxyModel);
+            statusCounter->setSelectionModel(list->selectionModel(), proxyModel);
+        }
+        list->setRootIndex(proxyModel->mapFromSource(model->index(currentPath)));
+        statusCounter->setRootPath(currentPath);
+
+        // Drop the flat listing's arrays once it is switched off
+        if (!dirModel->rootPath().isEmpty())
+            dirModel->setRootPath(QString());
+    }
+
+    // Lets the view lay out a million rows without measuring each one
+    list->setUniformItemSizes(compactListing);
+}
+
 
 void MainWindow::setDirectory(const QString &path)
 {
     if (path == currentPath)
         return;
 
+    PerfScope scope("navigate", path);
+
     // Only push history if user navigated normally
-    if (!navigatingBack) {
+    if (!navigatingHistory) {
         backHistory.append(currentPath);
         forwardHistory.clear();
     }
 
-    navigatingBack = false;
+    navigatingHistory = false;
 
     currentPath = path;
+    pathCompleter->recordVisit(path);
 
-    QModelIndex srcIndex = model->index(path);
-    QModelIndex proxyIndex = proxyModel->mapFromSource(srcIndex);
-    list->setRootIndex(proxyIndex);
+    if (!inSearchMode)
+        showDirectory();
 
     addressBar->setText(path);
     startSearch();
@@ -430,70 +731,17 @@ void MainWindow::setDirectory(const QString &path)
 }
 
 
-QString MainWindow::generateUniqueName(const QString &dirPath, const QString &fileName)
-{
-    QFileInfo info(fileName);
-    QString base = info.completeBaseName();
-    QString ext  = info.suffix();
-
-    QString newName = base + "_copy";
-    if (!ext.isEmpty())
-        newName += "." + ext;
-
-    int counter = 1;
-    QString fullPath = dirPath + "/" + newName;
-
-    while (QFile::exists(fullPath)) {
-        newName = base + "_copy_" + QString::number(counter++);
-        if (!ext.isEmpty())
-            newName += "." + ext;
-        fullPath = dirPath + "/" + newName;
-    }
-
-    return newName;
-}
-bool MainWindow::copyDirectoryRecursively(const QString &sourcePath,
-                                          const QString &destinationPath)
+void MainWindow::navigateToPath()
 {
-    QDir sourceDir(sourcePath);
-    if (!sourceDir.exists())
-        return false;
-
-    QDir destDir(destinationPath);
-    if (!destDir.exists()) {
-        if (!destDir.mkpath("."))
-            return false;
-    }
-
-    QFileInfoList entries = sourceDir.entryInfoList(
-        QDir::NoDotAndDotDot | QDir::AllEntries);
-
-    for (const QFileInfo &entry : std::as_const(entries)) {
-        QString srcPath = entry.absoluteFilePath();
-        QString destPath = destinationPath + "/" + entry.fileName();
-
-        if (entry.isDir()) {
-            if (!copyDirectoryRecursively(srcPath, destPath))
-                return false;
-        } else {
-            if (QFile::exists(destPath))
-                QFile::remove(destPath);   // safety overwrite
-
-            if (!QFile::copy(srcPath, destPath))
-                return false;
-        }
-    }
-    return true;
+    openPath(addressBar->text());
 }
 
-void MainWindow::navigateToPath()
+// Opens path once the resolver says it is there; a newer request
+// replaces one still waiting
+void MainWindow::openPath(const QString &path)
 {
-    QString path = addressBar->text().trimmed();
-    if (!QDir(path).exists()) {
-        QMessageBox::warning(this, "Error", "Directory does not exist.");
-        return;
-    }
-    setDirectory(path);
+    openRequest = pathResolver->resolve(path);
+    statusBar()->showMessage("Opening " + PathResolver::normalize(path) + "…");
 }
 
 void MainWindow::onListDoubleClicked(const QModelIndex &index)
@@ -512,11 +760,10 @@ void MainWindow::onListDoubleClicked(const QModelIndex &index)
     }
 
 
-    QModelIndex srcIndex = proxyModel->mapToSource(index);
-    QFileInfo info = model->fileInfo(srcIndex);
+    const QString path = pathAt(index);
 
-    if (info.isDir())
-        setDirectory(info.absoluteFilePath());
+    if (QFileInfo(path).isDir())
+        setDirectory(path);
     else
         openItem();
 }
@@ -528,7 +775,7 @@ void MainWindow::goBack()
     if (backHistory.isEmpty())
         return;
 
-    navigatingBack = true;
+    navigatingHistory = true;
 
     QString prevPath = backHistory.takeLast();
     forwardHistory.append(currentPath);
@@ -536,18 +783,43 @@ void MainWindow::goBack()
     setDirectory(prevPath);
 }
 
+void MainWindow::goForward()
+{
+    if (forwardHistory.isEmpty())
+        return;
+
+    navigatingHistory = true;
+
+    QString nextPath = forwardHistory.takeLast();
+    backHistory.append(currentPath);
+
+    setDirectory(nextPath);
+}
+
 
 
 void MainWindow::refreshView()
 {
-    QModelIndex srcIndex = model->index(currentDirPath());
-    QModelIndex proxyIndex = proxyModel->mapFromSource(srcIndex);
-    list->setRootIndex(proxyIndex);
+    PerfScope scope("refresh", currentPath);
+    thumbnailer->clear();
+    // The flat listing has no per-file watching; refresh re-reads it
+    if (compactListing)
+        dirModel->reload();
+    if (!inSearchMode)
+        showDirectory();
 
     startSearch();
     updateStatusBar();
 }
 
+// The change tracker keeps indexes current; this is for when it could not
+void MainWindow::rebuildSearchIndex()
+{
+    const QString root = currentDirPath();
+    statusBar()->showMessage("Rebuilding the search index for " + root + "…");
+    buildSearchIndex(root);
+}
+
 
 
 
@@ -601,8 +873,7 @@ void MainWindow::renameItem()
     if (!idx.isValid())
         return;
 
-    QModelIndex srcIdx = proxyModel->mapToSource(idx);
-    QString oldPath = model->filePath(srcIdx);
+    QString oldPath = pathAt(idx);
 
     QFileInfo info(oldPath);
     QString oldName = info.fileName();
@@ -678,7 +949,7 @@ void MainWindow::copyItem()
         return;
     }
 
-    copiedPaths = selectedPaths(list, model, proxyModel);
+    copiedPaths = selectedPaths();
     cutMode = false;
 }
 
@@ -691,7 +962,7 @@ void MainWindow::cutItem()
         return;
     }
 
-    copiedPaths = selectedPaths(list, model, proxyModel);
+    copiedPaths = selectedPaths();
     cutMode = true;
 }
 
@@ -701,50 +972,30 @@ void MainWindow::pasteItem()
     if (copiedPaths.isEmpty())
         return;
 
-    QString destDir = currentDirPath();
-
-    for (const QString &srcPath : std::as_const(copiedPaths)) {
+    PerfScope scope("paste", QString("%1 item(s)").arg(copiedPaths.size()));
+    transferEngine->enqueue(cutMode ? TransferEngine::Move : TransferEngine::Copy,
+                            copiedPaths, currentDirPath());
 
-        QFileInfo srcInfo(srcPath);
-        QString destPath = destDir + "/" + srcInfo.fileName();
-
-        //  If pasting into SAME directory, auto-rename
-        if (QFile::exists(destPath)) {
-            QString newName = generateUniqueName(destDir, srcInfo.fileName());
-            destPath = destDir + "/" + newName;
-        }
-
-        bool success = false;
-
-        if (srcInfo.isDir()) {
-            success = copyDirectoryRecursively(srcPath, destPath);
-        } else {
-            success = QFile::copy(srcPath, destPath);
-        }
-
-        if (!success) {
-            QMessageBox::warning(
-                this,
-                "Paste Failed",
-                "Unable to paste: " + srcInfo.fileName()
-                );
-        }
-    }
-
-    //  Cut → remove originals
+    //  Cut → originals go away once the move is done
     if (cutMode) {
-        for (const QString &srcPath : std::as_const(copiedPaths)) {
-            QFileInfo info(srcPath);
-            if (info.isDir())
-                QDir(srcPath).removeRecursively();
-            else
-                QFile::remove(srcPath);
-        }
         cutMode = false;
         copiedPaths.clear();
     }
+}
 
-    refreshView();
+void MainWindow::onTransferFinished(int id, bool success, const QStringList &errors)
+{
+    PerfTrace::end(jobTraces.take(id), success ? QString() : "failed");
+
+    if (!success && !errors.isEmpty()) {
+        QStringList shown = errors.mid(0, 10);
+        if (errors.size() > shown.size())
+            shown.append(QString("... and %1 more").arg(errors.size() - shown.size()));
+
+        QMessageBox::warning(this, "Transfer Failed", shown.join('\n'));
+    }
+
+    updateStatusBar();
 }
 
 
@@ -757,8 +1008,7 @@ void MainWindow::openItem()
     if (!idx.isValid())
         return;
 
-    QModelIndex srcIdx = proxyModel->mapToSource(idx);
-    QString path = model->filePath(srcIdx);
+    QString path = pathAt(idx);
 
     QDesktopServices::openUrl(QUrl::fromLocalFile(path));
 }
@@ -768,11 +1018,35 @@ void MainWindow::openItem()
 //-------------------------------------------
 void MainWindow::showProperties()
 {
-    QModelIndex srcIdx = proxyModel->mapToSource(currentIndex());
-    QString path = model->filePath(srcIdx);
+    QStringList paths = selectedPaths();
+
+    // Nothing selected: the folder being shown
+    if (paths.isEmpty())
+        paths.append(currentDirPath());
+
+    // Timed up to the dialog showing, not while the user reads it
+    QScopedPointer<PropertiesDialog> dlg;
+    {
+        PerfScope scope("properties", QString("%1 item(s)").arg(paths.size()));
+        if (paths.size() == 1)
+            dlg.reset(new PropertiesDialog(paths.first(), this));
+        else
+            dlg.reset(new PropertiesDialog(paths, this));
+    }
+    dlg->exec();
+}
+
+//-------------------------------------------
+// Sorting
+//-------------------------------------------
+void MainWindow::applySortOrder()
+{
+    const auto key = DirectoryModel::SortKey(sortBox->currentData().toInt());
+    dirModel->sortBy(key);
 
-    PropertiesDialog dlg(path, this);
-    dlg.exec();
+    // QFileSystemModel columns: name, size, type, date modified
+    static const int columns[] = { 0, 1, 3, 2 };
+    model->sort(columns[key]);
 }
 
 //-------------------------------------------
@@ -780,21 +1054,59 @@ void MainWindow::showProperties()
 //-------------------------------------------
 void MainWindow::updateStatusBar()
 {
-    QDir dir(currentDirPath());
-    QFileInfoList listItems = dir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files);
+    PerfScope scope("status refresh");
+    StatusCounts counts = statusCounter->counts();
+    QLocale locale;
+
+    // The flat listing keeps its totals; the selection is recounted only
+    // after rows changed under it
+    if (compactListing && !inSearchMode) {
+        counts = dirModel->counts();
+        if (listSelectionStale) {
+            listSelected = 0;
+            listSelectedBytes = 0;
+            countListSelection(list->selectionModel()->selection(), 1);
+            listSelectionStale = false;
+        }
+        counts.selected = listSelected;
+        counts.selectedBytes = listSelectedBytes;
+    }
+
+    QString text = QString("%1 items — %2 folders, %3 files (%4)")
+                       .arg(counts.items)
+                       .arg(counts.folders)
+                       .arg(counts.files)
+                       .arg(locale.formattedDataSize(counts.bytes));
+    if (counts.selected > 0)
+        text += QString(" — %1 selected (%2)")
+                    .arg(counts.selected)
+                    .arg(locale.formattedDataSize(counts.selectedBytes));
+
+    // Search results come from anywhere below; say where the search started
+    text += " — " + currentDirPath();
 
-    int fileCount = 0, folderCount = 0;
-    for (auto &i : listItems) {
-        if (i.isDir()) folderCount++; else fileCount++;
+    statusLabel->setText(text);
+}
+
+void MainWindow::updateListSelection(const QItemSelection &selected,
+                                     const QItemSelection &deselected)
+{
+    if (list->model() == dirModel && !listSelectionStale) {
+        countListSelection(selected, 1);
+        countListSelection(deselected, -1);
     }
+    updateStatusBar();
+}
 
-    statusBar()->showMessage(
-        QString("%1 items — %2 folders, %3 files — %4")
-            .arg(listItems.size())
-            .arg(folderCount)
-            .arg(fileCount)
-            .arg(currentDirPath())
-        );
+void MainWindow::countListSelection(const QItemSelection &selection, int sign)
+{
+    for (const QItemSelectionRange &range : selection) {
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            const QModelIndex index = dirModel->index(row);
+            listSelected += sign;
+            listSelectedBytes += dirModel->isDir(index) ? 0 : sign * dirModel->size(index);
+        }
+    }
 }
 
 //-------------------------------------------
@@ -804,73 +1116,176 @@ void MainWindow::startSearch()
 {
     QString text = searchBar->text().trimmed();
 
+    if (searchTrace)
+        PerfTrace::end(std::exchange(searchTrace, 0), "superseded");
+
     // Exit search mode
     if (text.isEmpty()) {
+        searchEngine->cancel();
         if (inSearchMode) {
-            list->setModel(proxyModel);
-
-            QModelIndex src = model->index(currentDirPath());
-            QModelIndex proxy = proxyModel->mapFromSource(src);
-            list->setRootIndex(proxy);
-
             inSearchMode = false;
+            showDirectory();
         }
         return;
     }
 
     inSearchMode = true;
-    list->setEnabled(false);
+    searchModel->clear(text);
+    searchFillNs = 0;
+    list->setModel(searchModel);
+    statusCounter->setSelectionModel(nullptr, nullptr);
+    list->setRootIndex(QModelIndex());
+    list->setUniformItemSizes(false);
     statusBar()->showMessage("Searching...");
 
-    QtConcurrent::run([=]() {
+    QString root = currentDirPath();
+    auto mode = SearchEngine::Mode(searchScope->currentData().toInt());
 
-        QList<QFileInfo> matches;
+    // The name index only answers name searches
+    QSharedPointer<FileIndex> index;
+    if (mode == SearchEngine::NameSearch)
+        index = searchIndexFor(root);
 
-        QDirIterator it(
-            currentDirPath(),
-            QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files,
-            QDirIterator::Subdirectories
-            );
+    PerfScope scope("search start", root);
+    searchTrace = PerfTrace::begin("search", QString("\"%1\" in %2").arg(text, root));
+    searchGeneration = searchEngine->start(root, text, mode, index);
+}
 
-        while (it.hasNext()) {
-            it.next();
-            QFileInfo info = it.fileInfo();
+void MainWindow::onSearchResults(quint64 generation, const QList<SearchHit> &batch)
+{
+    // Batches of a superseded query may still be queued
+    if (generation != searchGeneration)
+        return;
 
-            if (info.fileName().contains(text, Qt::CaseInsensitive)) {
-                matches.append(info);
-            }
-        }
+    QElapsedTimer clock;
+    clock.start();
 
-        QMetaObject::invokeMethod(this, [=]() {
+    searchModel->append(batch);
+    searchFillNs += clock.nsecsElapsed();
 
-            searchModel->clear();
-            QFileIconProvider iconProvider;
+    statusBar()->showMessage(
+        QString("Searching... %1 item(s) found").arg(searchModel->rowCount())
+        );
+}
 
-            for (const QFileInfo &info : matches) {
-                QStandardItem *item =
-                    new QStandardItem(
-                        iconProvider.icon(info),   // ✅ icon
-                        info.fileName()             // ✅ name only
-                        );
+void MainWindow::onSearchFinished(quint64 generation, int total)
+{
+    if (generation != searchGeneration)
+        return;
 
-                item->setData(info.absoluteFilePath(), Qt::UserRole); // hidden path
-                item->setData(text, Qt::UserRole + 1);                // for highlight
+    PerfTrace::end(std::exchange(searchTrace, 0), QString("%1 found").arg(total));
+    statusBar()->showMessage(
+        QString("Found %1 item(s), listed in %2 ms").arg(total).arg(searchFillNs / 1000000)
+        );
+}
 
-                searchModel->appendRow(item);
-            }
+//-------------------------------------------
+// Search index
+//-------------------------------------------
+QSharedPointer<FileIndex> MainWindow::searchIndexFor(const QString &root)
+{
+    auto it = searchIndexes.constFind(root);
+    if (it != searchIndexes.constEnd())
+        return it.value();
+
+    QSharedPointer<FileIndex> index(FileIndex::open(FileIndex::indexPathFor(root)));
+    if (index) {
+        // Nothing watched the tree while we were closed; catch up on
+        // folders modified since the build before trusting the index
+        addSearchIndex(root, index);
+        QtConcurrent::run([=]() {
+            if (!index->reconcile() || index->overlayIsLarge())
+                QMetaObject::invokeMethod(this, [=]() { buildSearchIndex(root); },
+                                          Qt::QueuedConnection);
+        });
+        return index;
+    }
 
-            list->setModel(searchModel);
-            list->setRootIndex(QModelIndex());
-            list->setEnabled(true);
+    // First search under this root: walk this time, index for next time
+    buildSearchIndex(root);
+    return {};
+}
+
+void MainWindow::buildSearchIndex(const QString &root)
+{
+    if (indexBuilds.contains(root))
+        return;
+    indexBuilds.insert(root, {});
 
-            statusBar()->showMessage(
-                QString("Found %1 item(s)").arg(matches.size())
-                );
+    // Watch first, so that nothing changed during the walk goes unseen
+    changeTracker->watchTree(root);
 
+    QtConcurrent::run([=]() {
+        QString path = FileIndex::indexPathFor(root);
+        QSharedPointer<FileIndex> index(
+            FileIndex::build(root, path) ? FileIndex::open(path) : nullptr);
+
+        QMetaObject::invokeMethod(this, [=]() {
+            const QList<ChangeSet> missed = indexBuilds.take(root);
+            if (!index)
+                return;
+            for (const ChangeSet &changes : missed)
+                applyChanges(root, index, changes);
+            addSearchIndex(root, index);
         }, Qt::QueuedConnection);
     });
 }
 
+void MainWindow::addSearchIndex(const QString &root, QSharedPointer<FileIndex> index)
+{
+    searchIndexes.insert(root, index);
+    changeTracker->watchTree(root);
+}
+
+void MainWindow::applyChanges(const QString &root, QSharedPointer<FileIndex> index,
+                              const ChangeSet &changes)
+{
+    const QString prefix = root.endsWith('/') ? root : root + "/";
+    auto under = [&](const QStringList &paths) {
+        QStringList result;
+        for (const QString &path : paths) {
+            if (path.startsWith(prefix) || path == root)
+                result.append(path);
+        }
+        return result;
+    };
+
+    const QStringList removed = under(changes.removed);
+    const QStringList added = under(changes.added);
+    if (!removed.isEmpty())
+        index->removePaths(removed);
+    if (!added.isEmpty())
+        index->addPaths(added);
+
+    // Lost events: diff the folders against the index, off the GUI thread
+    const QStringList rescanned = under(changes.rescanned);
+    if (!rescanned.isEmpty()) {
+        QtConcurrent::run([=]() {
+            if (!index->reconcile(rescanned) || index->overlayIsLarge())
+                QMetaObject::invokeMethod(this, [=]() { buildSearchIndex(root); },
+                                          Qt::QueuedConnection);
+        });
+    }
+
+    // Keep serving this index until the rebuilt one replaces it
+    if (index->overlayIsLarge())
+        buildSearchIndex(root);
+}
+
+//-------------------------------------------
+// Live file system changes
+//-------------------------------------------
+void MainWindow::onFileSystemChanged(const ChangeSet &changes)
+{
+    for (auto it = searchIndexes.cbegin(); it != searchIndexes.cend(); ++it)
+        applyChanges(it.key(), it.value(), changes);
+
+    // A build in progress may have walked past these already; they are
+    // replayed onto its index, in order, once it is ready
+    for (auto it = indexBuilds.begin(); it != indexBuilds.end(); ++it)
+        it->append(changes);
+}
+
 
 
 
@@ -882,11 +1297,13 @@ void MainWindow::startSearch()
 void MainWindow::setListViewMode()
 {
     thumbnailMode = false;
+    static_cast<HighlightDelegate *>(list->itemDelegate())->showThumbnails = false;
 
     list->setViewMode(QListView::ListMode);
     list->setIconSize(QSize(32, 32));
     list->setGridSize(QSize());   // reset
     list->setSpacing(2);
+    scheduleThumbnails();
 
     statusBar()->showMessage("Switched to List View");
 }
@@ -894,16 +1311,55 @@ void MainWindow::setListViewMode()
 void MainWindow::setThumbnailViewMode()
 {
     thumbnailMode = true;
+    static_cast<HighlightDelegate *>(list->itemDelegate())->showThumbnails = true;
 
     // Thumbnail mode
     list->setViewMode(QListView::IconMode);
     list->setIconSize(QSize(96, 96));   // Thumbnail size
     list->setGridSize(QSize(120, 120)); // Grid space for items
     list->setSpacing(10);
+    scheduleThumbnails();
 
     statusBar()->showMessage("Switched to Thumbnail View");
 }
 
+// Rows on screen first, then about a screen further on. Rows are laid
+// out in order, so the first visible one can be found by bisection
+// instead of asking the view about every row.
+void MainWindow::scheduleThumbnails()
+{
+    if (!thumbnailMode) {
+        thumbnailer->setWanted(QStringList());
+        return;
+    }
+
+    const QAbstractItemModel *shown = list->model();
+    const QModelIndex root = list->rootIndex();
+    const QRect area = list->viewport()->rect();
+    const int rows = shown->rowCount(root);
+
+    int low = 0;
+    int high = rows;
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        if (list->visualRect(shown->index(middle, 0, root)).bottom() < area.top())
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    QStringList visible;
+    QStringList ahead;
+    for (int row = low; row < rows; ++row) {
+        const QModelIndex index = shown->index(row, 0, root);
+        const QRect rect = list->visualRect(index);
+        if (rect.top() > area.bottom() + area.height())
+            break;
+        (rect.top() > area.bottom() ? ahead : visible).append(pathAt(index));
+    }
+    thumbnailer->setWanted(visible + ahead);
+}
+
 void MainWindow::keyPressEvent(QKeyEvent *event)
 {
     if (event->key() == Qt::Key_Delete) {
@@ -926,34 +1382,20 @@ void MainWindow::deleteItemInternal(bool permanent)
         return;
     }
 
-    QStringList paths = selectedPaths(list, model, proxyModel);
+    QStringList paths = selectedPaths();
     if (paths.isEmpty())
         return;
 
     QString msg = permanent
                       ? "Permanently delete selected items?\n(This cannot be undone)"
-                      : "Delete selected items?\n(Moved to Recycle Bin)";
+                      : "Delete selected items?\n(Moved to Trash)";
 
     if (QMessageBox::question(this, "Delete", msg) != QMessageBox::Yes)
         return;
 
-#ifdef Q_OS_WIN
-    for (const QString &path : std::as_const(paths)) {
-        std::wstring wpath = path.toStdWString();
-        wpath.push_back(L'\0');
-
-        SHFILEOPSTRUCTW op = {};
-        op.wFunc = FO_DELETE;
-        op.pFrom = wpath.c_str();
-        op.fFlags = permanent
-                        ? FOF_NOCONFIRMATION | FOF_NOERRORUI | FOF_SILENT
-                        : FOF_ALLOWUNDO | FOF_NOCONFIRMATION | FOF_NOERRORUI | FOF_SILENT;
-
-        SHFileOperationW(&op);
-    }
-#endif
-
-    refreshView();
+    // Runs in the background; the views pick up the removals on their own
+    PerfScope scope("delete", QString("%1 item(s)").arg(paths.size()));
+    transferEngine->enqueue(permanent ? TransferEngine::Delete : TransferEngine::Trash, paths);
 }
 void MainWindow::deleteItem()
 {
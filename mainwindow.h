@@ -12,9 +12,28 @@
 #include <QStatusBar>
 #include <QSortFilterProxyModel>
 #include <QTreeWidgetItem>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QFileInfo>
+#include <QItemSelection>
+
+#include "searchengine.h"
+#include "changetracker.h"
+#include "transferengine.h"
 
 #include <QTimer>
-class QStandardItemModel;
+class SearchResultsModel;
+class QComboBox;
+class QDockWidget;
+class QLabel;
+class FileIndex;
+class StatusCounter;
+class DirectoryModel;
+class Thumbnailer;
+class PathResolver;
+class PathCompleter;
+class StallWatchdog;
 
 class MainWindow : public QMainWindow
 {
@@ -26,7 +45,9 @@ private slots:
     void navigateToPath();
     void onListDoubleClicked(const QModelIndex &index);
     void goBack();
+    void goForward();
     void refreshView();
+    void rebuildSearchIndex();
 
     void createFile();
     void createFolder();
@@ -44,6 +65,10 @@ private slots:
 
     void sidebarItemClicked(QTreeWidgetItem *item);
     void startSearch();
+    void onSearchResults(quint64 generation, const QList<SearchHit> &batch);
+    void onSearchFinished(quint64 generation, int total);
+    void onFileSystemChanged(const ChangeSet &changes);
+    void onTransferFinished(int id, bool success, const QStringList &errors);
     void updateStatusBar();
 
 private:
@@ -60,37 +85,93 @@ private:
 
 
 
-    QStandardItemModel *searchModel;
+    SearchResultsModel *searchModel;
 
     bool inSearchMode = false;
 
+    SearchEngine *searchEngine;
+    quint64 searchGeneration = 0;
+    quint64 searchTrace = 0;      // PerfTrace id of the running search
+    qint64 searchFillNs = 0;      // GUI time spent adding result rows
+
+    // Persistent filename indexes, one per searched root
+    QHash<QString, QSharedPointer<FileIndex>> searchIndexes;
+    QHash<QString, QList<ChangeSet>> indexBuilds;   // root -> changes seen during the walk
+    QSharedPointer<FileIndex> searchIndexFor(const QString &root);
+    void buildSearchIndex(const QString &root);
+    void addSearchIndex(const QString &root, QSharedPointer<FileIndex> index);
+    void applyChanges(const QString &root, QSharedPointer<FileIndex> index,
+                      const ChangeSet &changes);
+
+    // Keeps indexes current without rescanning
+    ChangeTracker *changeTracker;
+
     QFileSystemModel *model;
     QListView *list;
+
+    // Flat listing for folders too big for the file system model
+    DirectoryModel *dirModel;
+    bool compactListing = false;
+    void showDirectory();
+    void prefetchCurrent();
+
+    // Selection totals of the flat listing, kept up from selection changes
+    // and recounted only after rows changed under the selection
+    int listSelected = 0;
+    qint64 listSelectedBytes = 0;
+    bool listSelectionStale = true;
+    void updateListSelection(const QItemSelection &selected, const QItemSelection &deselected);
+    void countListSelection(const QItemSelection &selection, int sign);
+
+    QComboBox *sortBox;
+    void applySortOrder();
     QLineEdit *addressBar;
 
+    // Typed paths are checked off the GUI thread
+    PathResolver *pathResolver;
+    PathCompleter *pathCompleter;
+    quint64 openRequest = 0;
+    void openPath(const QString &path);
+
     // Search
     QLineEdit *searchBar;
+    QComboBox *searchScope;
 
     // Sidebar
     QTreeWidget *sidebar;
     QStringList copiedPaths;
     bool cutMode = false;
 
+    // Paste runs in the background
+    TransferEngine *transferEngine;
+    QDockWidget *transferDock;
+    QHash<int, quint64> jobTraces;
+
+    // Timings of recent operations and GUI stalls, for hang reports
+    StallWatchdog *watchdog;
+    QDockWidget *perfDock;
+
+    // Status bar numbers, kept from the model's signals
+    StatusCounter *statusCounter;
+    QLabel *statusLabel;
+
     QStringList backHistory;
     QStringList forwardHistory;
-    bool navigatingBack = false;
+    bool navigatingHistory = false;
 
 
     QString currentDirPath() const;
     QModelIndex currentIndex() const;
-    QString generateUniqueName(const QString &dirPath, const QString &name);
-    bool copyDirectoryRecursively(const QString &sourcePath,
-                                  const QString &destinationPath);
+    QString pathAt(const QModelIndex &index) const;
+    QStringList selectedPaths() const;
 
     void setDirectory(const QString &path);
     bool thumbnailMode = false;
     void setListViewMode();
     void setThumbnailViewMode();
+    void scheduleThumbnails();
+    Thumbnailer *thumbnailer;
+    QTimer *thumbnailTimer;
     void populateSidebar();
     QString getKnownLocation(const QString &name);
     //void showSearchResults(const QStringList &results);
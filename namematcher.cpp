@@ -0,0 +1,116 @@
+#include "namematcher.h"
+
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NAMEMATCHER_SSE2
+#endif
+
+namespace {
+
+inline char asciiLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+bool isAscii(QByteArrayView bytes)
+{
+    for (char c : bytes) {
+        if (uchar(c) >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+bool equalsFolded(const char *haystack, const char *needleLower, qsizetype size)
+{
+    for (qsizetype i = 0; i < size; ++i) {
+        if (asciiLower(haystack[i]) != needleLower[i])
+            return false;
+    }
+    return true;
+}
+
+#ifdef NAMEMATCHER_SSE2
+// Lower-cases 'A'..'Z' in 16 bytes at once. Bytes >= 0x80 compare as
+// negative and are left alone.
+inline __m128i foldBlock(__m128i v)
+{
+    const __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                          _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+} // namespace
+
+NameMatcher::NameMatcher(const QString &text)
+    : text(text), lower(text.toLower().toUtf8())
+{
+    asciiOnly = isAscii(lower);
+}
+
+qsizetype NameMatcher::findAsciiCaseInsensitive(const char *haystack, qsizetype size,
+                                                const char *needleLower, qsizetype needleSize)
+{
+    if (needleSize == 0)
+        return 0;
+    if (needleSize > size)
+        return -1;
+
+    qsizetype i = 0;
+
+#ifdef NAMEMATCHER_SSE2
+    // Compare the first and last needle byte against 16 candidate positions
+    // at a time; only positions where both agree get a full comparison.
+    const __m128i first = _mm_set1_epi8(needleLower[0]);
+    const __m128i last = _mm_set1_epi8(needleLower[needleSize - 1]);
+
+    for (; i + needleSize - 1 + 16 <= size; i += 16) {
+        const __m128i a = foldBlock(_mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(haystack + i)));
+        const __m128i b = foldBlock(_mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(haystack + i + needleSize - 1)));
+
+        uint mask = uint(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+
+        while (mask) {
+            const qsizetype pos = i + qCountTrailingZeroBits(mask);
+            if (equalsFolded(haystack + pos + 1, needleLower + 1, qMax<qsizetype>(needleSize - 2, 0)))
+                return pos;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Scalar fallback, and the tail the vector loop cannot load safely
+    for (; i + needleSize <= size; ++i) {
+        if (equalsFolded(haystack + i, needleLower, needleSize))
+            return i;
+    }
+    return -1;
+}
+
+bool NameMatcher::matches(QByteArrayView utf8Name) const
+{
+    if (!asciiOnly)
+        return QString::fromUtf8(utf8Name).contains(text, Qt::CaseInsensitive);
+
+    if (findAsciiCaseInsensitive(utf8Name.data(), utf8Name.size(),
+                                 lower.constData(), lower.size()) >= 0)
+        return true;
+
+    // Unicode case folding can map a few non-ASCII letters onto ASCII ones
+    // (the Kelvin sign folds to 'k'), so only pure-ASCII names can be
+    // rejected without decoding.
+    if (isAscii(utf8Name))
+        return false;
+    return QString::fromUtf8(utf8Name).contains(text, Qt::CaseInsensitive);
+}
+
+bool NameMatcher::matches(const QString &name) const
+{
+    return name.contains(text, Qt::CaseInsensitive);
+}
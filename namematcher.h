@@ -0,0 +1,33 @@
+#ifndef NAMEMATCHER_H
+#define NAMEMATCHER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QByteArrayView>
+
+// Case-insensitive substring test on raw UTF-8 file names.
+//
+// For ASCII search text the name bytes are scanned directly with a
+// vectorized kernel, so no QString is built per name. Names with non-ASCII
+// bytes that the fast scan rejects, and non-ASCII search text, go through
+// QString::contains so results stay identical to Qt::CaseInsensitive.
+class NameMatcher
+{
+public:
+    explicit NameMatcher(const QString &text);
+
+    bool matches(QByteArrayView utf8Name) const;
+    bool matches(const QString &name) const;
+
+    // Offset of needle in haystack ignoring ASCII case, or -1.
+    // needleLower must already be lower case.
+    static qsizetype findAsciiCaseInsensitive(const char *haystack, qsizetype size,
+                                              const char *needleLower, qsizetype needleSize);
+
+private:
+    QString text;
+    QByteArray lower;
+    bool asciiOnly;
+};
+
+#endif
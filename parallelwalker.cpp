@@ -0,0 +1,301 @@
+#include "parallelwalker.h"
+
+#include <QDirIterator>
+#include <QFile>
+#include <QMutex>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QWaitCondition>
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct WorkQueue
+{
+    QMutex lock;
+    std::deque<QString> dirs;
+#ifdef Q_OS_LINUX
+    std::vector<char> direntBuffer;   // owned by the worker, not the lock
+#endif
+};
+
+#ifdef Q_OS_LINUX
+// Layout of the records returned by getdents64(2)
+struct LinuxDirent64
+{
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+const size_t DirentBufferSize = 64 * 1024;
+#endif
+
+class WalkState
+{
+public:
+    WalkState(int threads, QDir::Filters filters,
+              const ParallelWalker::Visitor &visitor,
+              const ParallelWalker::CancelCheck &isCancelled)
+        : filters(filters), visitor(visitor), isCancelled(isCancelled)
+    {
+        for (int i = 0; i < threads; ++i)
+            queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    void push(int worker, const QString &dir)
+    {
+        pending.fetch_add(1);
+        {
+            QMutexLocker locker(&queues[worker]->lock);
+            queues[worker]->dirs.push_back(dir);
+        }
+        if (idle.load() > 0)
+            idleCondition.wakeOne();
+    }
+
+    void work(int self)
+    {
+        QString dir;
+        while (!cancelled()) {
+            if (popLocal(self, dir) || steal(self, dir)) {
+                read(self, dir);
+                if (pending.fetch_sub(1) == 1)
+                    idleCondition.wakeAll();   // last directory done
+                continue;
+            }
+
+            if (pending.load() == 0)
+                return;
+
+            // Someone is still reading and may push more work; the timeout
+            // covers a wake-up that lands between our check and the wait.
+            QMutexLocker locker(&idleMutex);
+            idle.fetch_add(1);
+            idleCondition.wait(&idleMutex, 2);
+            idle.fetch_sub(1);
+        }
+    }
+
+private:
+    bool cancelled() const
+    {
+        return isCancelled && isCancelled();
+    }
+
+    bool popLocal(int self, QString &dir)
+    {
+        WorkQueue &q = *queues[self];
+        QMutexLocker locker(&q.lock);
+        if (q.dirs.empty())
+            return false;
+        dir = std::move(q.dirs.back());
+        q.dirs.pop_back();
+        return true;
+    }
+
+    bool steal(int self, QString &dir)
+    {
+        const int n = int(queues.size());
+        for (int i = 1; i < n; ++i) {
+            WorkQueue &q = *queues[(self + i) % n];
+            QMutexLocker locker(&q.lock);
+            if (q.dirs.empty())
+                continue;
+            dir = std::move(q.dirs.front());
+            q.dirs.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    // Resolves the entry type from d_type, falling back to fstatat only
+    // when the file system does not say or the entry is a symlink.
+    // Returns false when the filters exclude the entry.
+    bool classify(int dirFd, const char *name, unsigned char type, WalkEntry &entry) const
+    {
+        struct stat st;
+        if (type == DT_UNKNOWN) {
+            if (::fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                return false;
+            type = IFTODT(st.st_mode);
+        }
+
+        entry.isSymLink = (type == DT_LNK);
+        if (entry.isSymLink) {
+            if (filters.testFlag(QDir::NoSymLinks))
+                return false;
+            if (::fstatat(dirFd, name, &st, 0) != 0) {
+                entry.isDir = false;                     // broken link
+                return filters.testFlag(QDir::System);
+            }
+            type = IFTODT(st.st_mode);
+        }
+
+        entry.isDir = (type == DT_DIR);
+        if (entry.isDir)
+            return filters.testFlag(QDir::Dirs) || filters.testFlag(QDir::AllDirs);
+        if (type == DT_REG)
+            return filters.testFlag(QDir::Files);
+        return filters.testFlag(QDir::System);
+    }
+
+    void read(int self, const QString &dirPath)
+    {
+        int fd = ::open(QFile::encodeName(dirPath).constData(),
+                        O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        std::vector<char> &buffer = queues[self]->direntBuffer;
+        if (buffer.empty())
+            buffer.resize(DirentBufferSize);
+
+        const bool showHidden = filters.testFlag(QDir::Hidden);
+        WalkEntry entry;
+        entry.dirPath = dirPath;
+        entry.dirFd = fd;
+
+        for (;;) {
+            long n = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            if (n <= 0)
+                break;
+
+            for (long offset = 0; offset < n;) {
+                if (cancelled()) {
+                    ::close(fd);
+                    return;
+                }
+
+                const LinuxDirent64 *d =
+                    reinterpret_cast<const LinuxDirent64 *>(buffer.data() + offset);
+                offset += d->d_reclen;
+
+                const char *name = d->d_name;
+                if (name[0] == '.') {
+                    if (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))
+                        continue;
+                    if (!showHidden)
+                        continue;
+                }
+
+                if (!classify(fd, name, d->d_type, entry))
+                    continue;
+
+                entry.rawName = QByteArrayView(name, qsizetype(std::strlen(name)));
+                bool descend = visitor(entry);
+                if (descend && entry.isDir && !entry.isSymLink)
+                    push(self, entry.filePath());
+            }
+        }
+
+        ::close(fd);
+    }
+#else
+    void read(int self, const QString &dirPath)
+    {
+        QDirIterator it(dirPath, filters);
+        WalkEntry entry;
+        entry.dirPath = dirPath;
+
+        while (it.hasNext()) {
+            if (cancelled())
+                return;
+            it.next();
+            QFileInfo info = it.fileInfo();
+
+            const QByteArray name = info.fileName().toUtf8();
+            entry.rawName = name;
+            entry.isDir = info.isDir();
+            entry.isSymLink = info.isSymLink();
+
+            bool descend = visitor(entry);
+            if (descend && entry.isDir && !entry.isSymLink)
+                push(self, info.absoluteFilePath());
+        }
+    }
+#endif
+
+    QDir::Filters filters;
+    const ParallelWalker::Visitor &visitor;
+    const ParallelWalker::CancelCheck &isCancelled;
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::atomic<int> pending { 0 };
+    std::atomic<int> idle { 0 };
+    QMutex idleMutex;
+    QWaitCondition idleCondition;
+};
+
+// Helper threads outlive a walk, so a search per keystroke does not start
+// and join a fresh set of threads each time. Walks running at the same time
+// share the pool; when it is busy a walk simply runs on fewer threads.
+QThreadPool &helperPool()
+{
+    static QThreadPool pool;
+    static const bool configured = [] {
+        pool.setMaxThreadCount(2 * qMax(1, QThread::idealThreadCount()));
+        pool.setExpiryTimeout(60000);
+        return true;
+    }();
+    Q_UNUSED(configured);
+    return pool;
+}
+
+} // namespace
+
+ParallelWalker::ParallelWalker(int threadCount)
+    : threads(threadCount > 0 ? threadCount : qMax(1, QThread::idealThreadCount()))
+{
+}
+
+void ParallelWalker::walk(const QStringList &roots, const Visitor &visitor)
+{
+    WalkState state(threads, dirFilters, visitor, isCancelled);
+
+    // Spread the roots so every worker starts with something to do
+    for (int i = 0; i < roots.size(); ++i)
+        state.push(i % threads, QDir::cleanPath(roots.at(i)));
+
+    QThreadPool &pool = helperPool();
+    QSemaphore helpersDone;
+    std::vector<QRunnable *> helpers;
+    for (int i = 1; i < threads; ++i) {
+        QRunnable *helper = QRunnable::create([&state, &helpersDone, i]() {
+            state.work(i);
+            helpersDone.release();
+        });
+        helper->setAutoDelete(false);
+        pool.start(helper);
+        helpers.push_back(helper);
+    }
+
+    state.work(0);   // the calling thread is worker 0
+
+    // Helpers still queued behind other walks are not needed any more
+    int started = 0;
+    for (QRunnable *helper : helpers) {
+        if (!pool.tryTake(helper))
+            ++started;
+    }
+    helpersDone.acquire(started);
+    qDeleteAll(helpers);
+}
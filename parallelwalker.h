@@ -0,0 +1,69 @@
+#ifndef PARALLELWALKER_H
+#define PARALLELWALKER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArrayView>
+#include <QDir>
+
+#include <functional>
+
+// One directory entry as seen by the visitor. rawName is the UTF-8 file
+// name and is only valid during the visitor call; name() and filePath()
+// decode it for the few entries that need a QString. dirFd is the open
+// descriptor of dirPath on Linux (-1 elsewhere), for *at() calls during the
+// visitor call.
+struct WalkEntry
+{
+    QString dirPath;
+    QByteArrayView rawName;
+    bool isDir = false;
+    bool isSymLink = false;
+    int dirFd = -1;
+
+    QString name() const { return QString::fromUtf8(rawName); }
+    QString filePath() const
+    {
+        return dirPath.endsWith('/') ? dirPath + name() : dirPath + "/" + name();
+    }
+};
+
+// Recursive directory traversal spread over several threads.
+//
+// Each worker keeps its own deque of directories still to be read. A worker
+// takes from the back of its own deque (depth-first, so it stays in the
+// subtree it just read) and, when that runs dry, steals from the front of
+// another worker's deque, where the oldest and usually largest subtrees sit.
+// The calling thread is one worker; the others come from a pool shared by
+// all walkers, whose threads stay alive between walks.
+//
+// The visitor is called concurrently from all workers and must be
+// thread-safe. For directories, its return value says whether to descend.
+//
+// On Linux directories are read with getdents64 and entry types come from
+// d_type, so an ordinary entry costs no stat. Only symlinks (to tell whether
+// they point at a directory) and file systems that report DT_UNKNOWN are
+// stat'ed. The fast path honours the Files, Dirs/AllDirs, Hidden, System
+// and NoSymLinks filters.
+class ParallelWalker
+{
+public:
+    using Visitor = std::function<bool(const WalkEntry &entry)>;
+    using CancelCheck = std::function<bool()>;
+
+    explicit ParallelWalker(int threadCount = 0);
+
+    void setFilters(QDir::Filters filters) { dirFilters = filters; }
+    void setCancelCheck(const CancelCheck &check) { isCancelled = check; }
+
+    int threadCount() const { return threads; }
+
+    void walk(const QStringList &roots, const Visitor &visitor);
+
+private:
+    int threads;
+    QDir::Filters dirFilters = QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files;
+    CancelCheck isCancelled;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "pathcompleter.h"
+
+#include <QAbstractItemView>
+#include <QCompleter>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLineEdit>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringListModel>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace {
+
+const quint32 VisitsMagic = 0x46565354;   // "FVST"
+const quint32 VisitsVersion = 1;
+
+const int MaxVisits = 1000;
+const int MaxSuggestions = 12;
+const int MaxHistorySuggestions = 6;
+const int CachedFolders = 64;
+const int FolderRefreshSecs = 30;
+
+struct Typed
+{
+    QString parent;      // the folder being typed into
+    QString stem;        // the partial name after it
+    QString prefix;      // what visited paths must start with
+};
+
+// Splits typed text at its last separator, without any I/O
+Typed split(const QString &text)
+{
+    Typed typed;
+    const QString path = PathResolver::normalize(text);
+    if (path.isEmpty())
+        return typed;
+
+    if (text.endsWith('/') || path.endsWith('/')) {
+        typed.parent = path;
+        typed.prefix = path.endsWith('/') ? path : path + "/";
+        return typed;
+    }
+
+    const qsizetype slash = path.lastIndexOf('/');
+    typed.parent = path.left(slash);
+    if (typed.parent.isEmpty() || typed.parent.endsWith(':'))
+        typed.parent = path.left(slash + 1);
+    typed.stem = path.mid(slash + 1);
+    typed.prefix = path;
+    return typed;
+}
+
+QString join(const QString &parent, const QString &name)
+{
+    return parent.endsWith('/') ? parent + name : parent + "/" + name;
+}
+
+} // namespace
+
+PathCompleter::PathCompleter(QLineEdit *edit, PathResolver *resolver, QObject *parent)
+    : QObject(parent), edit(edit), resolver(resolver)
+{
+    folders.setMaxCost(CachedFolders);
+
+    suggestionModel = new QStringListModel(this);
+    completer = new QCompleter(suggestionModel, this);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    completer->setMaxVisibleItems(MaxSuggestions);
+    completer->setWidget(edit);
+
+    saveTimer = new QTimer(this);
+    saveTimer->setSingleShot(true);
+    saveTimer->setInterval(2000);
+    connect(saveTimer, &QTimer::timeout, this, &PathCompleter::save);
+
+    connect(edit, &QLineEdit::textEdited, this, &PathCompleter::onTextEdited);
+    connect(resolver, &PathResolver::resolved, this, &PathCompleter::onResolved);
+    connect(completer, QOverload<const QString &>::of(&QCompleter::activated),
+            this, [this](const QString &path) {
+        this->edit->setText(path);
+        emit pathChosen(path);
+    });
+
+    load();
+}
+
+PathCompleter::~PathCompleter()
+{
+    if (saveTimer->isActive())
+        save();
+}
+
+void PathCompleter::recordVisit(const QString &path)
+{
+    Visit &visit = visits[path];
+    ++visit.count;
+    visit.lastVisit = QDateTime::currentSecsSinceEpoch();
+
+    if (visits.size() > MaxVisits) {
+        const qint64 now = visit.lastVisit;
+        auto weakest = visits.begin();
+        for (auto it = visits.begin(); it != visits.end(); ++it) {
+            if (score(*it, now) < score(*weakest, now))
+                weakest = it;
+        }
+        visits.erase(weakest);
+    }
+
+    saveTimer->start();
+}
+
+// Visits count for less as they age; a week-old one is worth half
+double PathCompleter::score(const Visit &visit, qint64 now) const
+{
+    const double ageDays = double(std::max<qint64>(0, now - visit.lastVisit)) / 86400.0;
+    return visit.count / (1.0 + ageDays / 7.0);
+}
+
+QStringList PathCompleter::suggestions(const QString &text) const
+{
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const Typed typed = split(text);
+
+    struct Ranked
+    {
+        double score;
+        QString path;
+    };
+    std::vector<Ranked> visited;
+    for (auto it = visits.cbegin(); it != visits.cend(); ++it) {
+        if (it.key().startsWith(typed.prefix, Qt::CaseInsensitive)
+            && it.key().compare(typed.prefix, Qt::CaseInsensitive) != 0)
+            visited.push_back({ score(*it, now), it.key() });
+    }
+
+    const int limit = typed.parent.isEmpty() ? MaxSuggestions : MaxHistorySuggestions;
+    const size_t kept = std::min(visited.size(), size_t(limit));
+    std::partial_sort(visited.begin(), visited.begin() + kept, visited.end(),
+                      [](const Ranked &a, const Ranked &b) { return a.score > b.score; });
+
+    QStringList result;
+    for (size_t i = 0; i < kept; ++i)
+        result.append(visited[i].path);
+
+    if (const Folders *listing = folders.object(typed.parent)) {
+        for (const QString &name : listing->names) {
+            if (result.size() >= MaxSuggestions)
+                break;
+            if (!name.startsWith(typed.stem, Qt::CaseInsensitive))
+                continue;
+            const QString path = join(typed.parent, name);
+            if (!result.contains(path))
+                result.append(path);
+        }
+    }
+    return result;
+}
+
+void PathCompleter::onTextEdited(const QString &text)
+{
+    const Typed typed = split(text);
+    if (!typed.parent.isEmpty()) {
+        const Folders *listing = folders.object(typed.parent);
+        if (!listing || listing->fetched.secsTo(QDateTime::currentDateTimeUtc()) > FolderRefreshSecs)
+            fetchFolders(typed.parent);
+    }
+    showSuggestions();
+}
+
+void PathCompleter::fetchFolders(const QString &parent)
+{
+    for (const QString &folder : std::as_const(fetching)) {
+        if (folder == parent)
+            return;
+    }
+    fetching.insert(resolver->listFolders(parent), parent);
+}
+
+void PathCompleter::onResolved(quint64 request, const PathResolver::Result &result)
+{
+    const auto it = fetching.find(request);
+    if (it == fetching.end())
+        return;
+    const QString folder = it.value();
+    fetching.erase(it);
+
+    // A failed listing is kept too, empty, so it is not asked for again
+    // on every key press
+    Folders *listing = new Folders;
+    listing->fetched = QDateTime::currentDateTimeUtc();
+    if (result.status == PathResolver::Ok) {
+        listing->names = result.folders;
+        std::sort(listing->names.begin(), listing->names.end(),
+                  [](const QString &a, const QString &b) {
+            return a.compare(b, Qt::CaseInsensitive) < 0;
+        });
+    }
+    folders.insert(folder, listing);
+
+    if (edit->hasFocus() && split(edit->text()).parent == folder)
+        showSuggestions();
+}
+
+void PathCompleter::showSuggestions()
+{
+    const QStringList list = suggestions(edit->text());
+    suggestionModel->setStringList(list);
+    if (list.isEmpty())
+        completer->popup()->hide();
+    else
+        completer->complete();
+}
+
+QString PathCompleter::filePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/visits.dat";
+}
+
+void PathCompleter::load()
+{
+    QFile file(filePath());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (magic != VisitsMagic || version != VisitsVersion)
+        return;
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString path;
+        Visit visit;
+        in >> path >> visit.count >> visit.lastVisit;
+        visits.insert(path, visit);
+    }
+    if (in.status() != QDataStream::Ok)
+        visits.clear();
+}
+
+void PathCompleter::save()
+{
+    QDir().mkpath(QFileInfo(filePath()).absolutePath());
+
+    QSaveFile file(filePath());
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out << VisitsMagic << VisitsVersion << quint32(visits.size());
+    for (auto it = visits.cbegin(); it != visits.cend(); ++it)
+        out << it.key() << it->count << it->lastVisit;
+    file.commit();
+}
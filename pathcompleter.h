@@ -0,0 +1,77 @@
+#ifndef PATHCOMPLETER_H
+#define PATHCOMPLETER_H
+
+#include <QObject>
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QStringList>
+
+#include "pathresolver.h"
+
+class QCompleter;
+class QLineEdit;
+class QStringListModel;
+class QTimer;
+
+// Path suggestions for the address bar.
+//
+// Suggestions come from memory only, so they are ready as soon as a key
+// is pressed: first folders visited before, ranked by how often and how
+// recently, then subfolders of the folder being typed, from listings
+// kept here. A listing that is missing or old is fetched through the
+// PathResolver and the popup is refreshed when it arrives, so a hung
+// mount never stalls typing.
+//
+// Visit counts are saved in the cache directory between sessions.
+class PathCompleter : public QObject
+{
+    Q_OBJECT
+public:
+    PathCompleter(QLineEdit *edit, PathResolver *resolver, QObject *parent = nullptr);
+    ~PathCompleter() override;
+
+    void recordVisit(const QString &path);
+
+    // Best matches for what has been typed so far, best first
+    QStringList suggestions(const QString &text) const;
+
+signals:
+    void pathChosen(const QString &path);
+
+private:
+    struct Visit
+    {
+        quint32 count = 0;
+        qint64 lastVisit = 0;   // seconds since the epoch
+    };
+
+    struct Folders
+    {
+        QStringList names;      // sorted, case-insensitively
+        QDateTime fetched;
+    };
+
+    void onTextEdited(const QString &text);
+    void onResolved(quint64 request, const PathResolver::Result &result);
+    void fetchFolders(const QString &parent);
+    void showSuggestions();
+    double score(const Visit &visit, qint64 now) const;
+
+    static QString filePath();
+    void load();
+    void save();
+
+    QLineEdit *edit;
+    PathResolver *resolver;
+    QCompleter *completer;
+    QStringListModel *suggestionModel;
+
+    QHash<QString, Visit> visits;
+    QTimer *saveTimer;
+
+    QCache<QString, Folders> folders;
+    QHash<quint64, QString> fetching;    // request -> folder
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "pathresolver.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPointer>
+#include <QTimer>
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// Threads stuck on a dead mount are never reclaimed; past this many on
+// one mount, new checks there fail at once instead of piling up more.
+// Completion listings count apart from checks.
+const int MaxWaitingChecks = 4;
+const int MaxWaitingListings = 2;
+const int MaxWaitingThreads = 32;      // over all mounts
+
+#ifdef Q_OS_LINUX
+// Mount points in /proc/self/mounts escape space, tab, newline and
+// backslash as octal
+QString unescapeMountPoint(const QByteArray &field)
+{
+    QByteArray point;
+    for (qsizetype i = 0; i < field.size(); ++i) {
+        if (field.at(i) == '\\' && i + 3 < field.size()) {
+            point.append(char(field.mid(i + 1, 3).toInt(nullptr, 8)));
+            i += 3;
+        } else {
+            point.append(field.at(i));
+        }
+    }
+    return QFile::decodeName(point);
+}
+#endif
+
+PathResolver::Result check(const QString &path, bool list)
+{
+    PathResolver::Result result;
+    result.path = path;
+
+    const QFileInfo info(path);
+    if (!info.exists())
+        result.status = PathResolver::NotFound;
+    else if (!info.isDir())
+        result.status = PathResolver::NotADirectory;
+    else if (!QDir(path).isReadable())
+        result.status = PathResolver::NoPermission;
+    else
+        result.status = PathResolver::Ok;
+
+    if (list && result.status == PathResolver::Ok)
+        result.folders = QDir(path).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::NoSort);
+    return result;
+}
+
+} // namespace
+
+PathResolver::PathResolver(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QString PathResolver::normalize(const QString &input)
+{
+    QString path = input.trimmed();
+    if (path == "~" || path.startsWith("~/"))
+        path = QDir::homePath() + path.mid(1);
+    if (path.isEmpty())
+        return path;
+    return QDir::cleanPath(QDir::isAbsolutePath(path) ? path
+                                                      : QDir::current().absoluteFilePath(path));
+}
+
+QString PathResolver::describe(Status status)
+{
+    switch (status) {
+    case Ok:
+        return QString();
+    case NotFound:
+        return "Directory does not exist.";
+    case NotADirectory:
+        return "Not a directory.";
+    case NoPermission:
+        return "You do not have permission to open this directory.";
+    case TimedOut:
+        return "The location is not responding.";
+    }
+    return QString();
+}
+
+// Judged from the mount table alone; nothing on the mount is touched
+QString PathResolver::mountOf(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    QFile mounts("/proc/self/mounts");
+    if (mounts.open(QIODevice::ReadOnly)) {
+        QString best;
+        const QList<QByteArray> lines = mounts.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            const QList<QByteArray> fields = line.split(' ');
+            if (fields.size() < 2)
+                continue;
+            const QString point = unescapeMountPoint(fields.at(1));
+            if (point.size() > best.size()
+                && (point == "/" || path == point || path.startsWith(point + '/')))
+                best = point;
+        }
+        if (!best.isEmpty())
+            return best;
+    }
+#endif
+    // Elsewhere the top two levels stand in: "/Volumes/nas", "//server/share"
+    qsizetype end = path.startsWith("//") ? 2 : 0;
+    for (int level = 0; level < 2 && end >= 0; ++level)
+        end = path.indexOf('/', end + 1);
+    return end < 0 ? path : path.left(end);
+}
+
+quint64 PathResolver::resolve(const QString &path)
+{
+    return start(normalize(path), false);
+}
+
+quint64 PathResolver::listFolders(const QString &path)
+{
+    return start(normalize(path), true);
+}
+
+quint64 PathResolver::start(const QString &path, bool list)
+{
+    const quint64 request = ++nextRequest;
+    const QString key = (list ? "L" : "R") + path;
+    pending.insert(request, { key, path });
+
+    QTimer::singleShot(timeoutMs, this, [this, request]() { expire(request); });
+
+    if (inFlight.contains(key))
+        return request;
+
+    const QString budget = (list ? "L" : "R") + mountOf(path);
+    const int limit = list ? MaxWaitingListings : MaxWaitingChecks;
+    if (waiting.value(budget) >= limit || waitingTotal >= MaxWaitingThreads) {
+        QTimer::singleShot(0, this, [this, request]() { expire(request); });
+        return request;
+    }
+
+    // The pointer is only read back on the GUI thread
+    inFlight.insert(key, budget);
+    ++waiting[budget];
+    ++waitingTotal;
+    QPointer<PathResolver> self(this);
+    std::thread([self, key, path, list]() {
+        const Result result = check(path, list);
+        QCoreApplication *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(app, [self, key, result]() {
+            if (self)
+                self->finish(key, result);
+        }, Qt::QueuedConnection);
+    }).detach();
+
+    return request;
+}
+
+void PathResolver::finish(const QString &key, const Result &result)
+{
+    const QString budget = inFlight.take(key);
+    if (--waiting[budget] <= 0)
+        waiting.remove(budget);
+    --waitingTotal;
+
+    QList<quint64> answered;
+    for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+        if (it->key == key)
+            answered.append(it.key());
+    }
+    std::sort(answered.begin(), answered.end());
+    for (quint64 request : std::as_const(answered)) {
+        pending.remove(request);
+        emit resolved(request, result);
+    }
+}
+
+void PathResolver::expire(quint64 request)
+{
+    auto it = pending.find(request);
+    if (it == pending.end())
+        return;
+
+    Result result;
+    result.path = it->path;
+    result.status = TimedOut;
+    pending.erase(it);
+    emit resolved(request, result);
+}
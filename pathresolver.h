@@ -0,0 +1,72 @@
+#ifndef PATHRESOLVER_H
+#define PATHRESOLVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+
+// Checks typed paths without touching the file system on the GUI thread.
+//
+// A stat() on a hung network mount can block for minutes, and nothing
+// can cancel it. Each check therefore runs on a thread of its own that is
+// left to finish whenever it can; if no answer comes within the timeout
+// the request is reported as TimedOut and a late answer is ignored.
+// Checks for a path already in flight are not started twice.
+//
+// Only a few threads are ever left waiting on one stuck mount; past that,
+// new checks on that mount time out at once while other mounts carry on.
+// Folder listings for completion have a budget of their own, so typing
+// into a dead share cannot use up the checks that navigation needs.
+class PathResolver : public QObject
+{
+    Q_OBJECT
+public:
+    enum Status { Ok, NotFound, NotADirectory, NoPermission, TimedOut };
+
+    struct Result
+    {
+        QString path;             // cleaned, absolute
+        Status status = NotFound;
+        QStringList folders;      // subfolder names, for listFolders()
+    };
+
+    explicit PathResolver(QObject *parent = nullptr);
+
+    void setTimeout(int ms) { timeoutMs = ms; }
+
+    // Whether path is a folder the user may open; answers in resolved()
+    quint64 resolve(const QString &path);
+
+    // The names of path's visible subfolders; answers in resolved()
+    quint64 listFolders(const QString &path);
+
+    // Expands ~ and makes input absolute and clean, without any I/O
+    static QString normalize(const QString &input);
+
+    // User-facing wording for a failed status
+    static QString describe(Status status);
+
+signals:
+    void resolved(quint64 request, const PathResolver::Result &result);
+
+private:
+    quint64 start(const QString &path, bool list);
+    void finish(const QString &key, const Result &result);
+    static QString mountOf(const QString &path);
+    void expire(quint64 request);
+
+    struct Pending
+    {
+        QString key;
+        QString path;
+    };
+
+    int timeoutMs = 3000;
+    quint64 nextRequest = 0;
+    QHash<quint64, Pending> pending;
+    QHash<QString, QString> inFlight;   // key -> budget, until its thread returns
+    QHash<QString, int> waiting;        // threads out per budget
+    int waitingTotal = 0;
+};
+
+#endif
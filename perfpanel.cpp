@@ -0,0 +1,229 @@
+#include "perfpanel.h"
+#include "perftrace.h"
+#include "stallwatchdog.h"
+
+#include <QAbstractTableModel>
+#include <QColor>
+#include <QTreeView>
+#include <QScrollBar>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QLabel>
+#include <QTimer>
+#include <QFile>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+
+#include <algorithm>
+#include <deque>
+
+namespace {
+
+enum Column {
+    TimeColumn,
+    NameColumn,
+    DurationColumn,
+    ThreadColumn,
+    DetailColumn
+};
+
+const int RefreshMs = 1000;
+const size_t MaxRows = 8192;             // as many as the trace holds
+
+} // namespace
+
+// Rows are newest first; the events are kept oldest first, so new ones
+// go on the end and old ones come off the front
+class PerfPanel::EventModel : public QAbstractTableModel
+{
+public:
+    using QAbstractTableModel::QAbstractTableModel;
+
+    // Returns how many rows were added on top
+    int append(const QList<PerfTrace::Event> &fresh, const QHash<quint32, QString> &names)
+    {
+        threadNames = names;
+        if (fresh.isEmpty())
+            return 0;
+
+        // More than fit replaces everything
+        const qsizetype skip = std::max<qsizetype>(0, fresh.size() - qsizetype(MaxRows));
+        const size_t added = size_t(fresh.size() - skip);
+        const size_t total = events.size() + added;
+        const size_t dropped = total > MaxRows ? total - MaxRows : 0;
+        if (dropped > 0) {
+            const int last = int(events.size()) - 1;
+            beginRemoveRows(QModelIndex(), last - int(dropped) + 1, last);
+            events.erase(events.begin(), events.begin() + qsizetype(dropped));
+            endRemoveRows();
+        }
+
+        beginInsertRows(QModelIndex(), 0, int(added) - 1);
+        events.insert(events.end(), fresh.cbegin() + skip, fresh.cend());
+        endInsertRows();
+        return int(added);
+    }
+
+    void clear()
+    {
+        beginResetModel();
+        events.clear();
+        endResetModel();
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : int(events.size());
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : DetailColumn + 1;
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (!index.isValid() || index.row() >= int(events.size()))
+            return QVariant();
+        const PerfTrace::Event &event = events[events.size() - 1 - size_t(index.row())];
+
+        switch (role) {
+        case Qt::DisplayRole:
+            switch (index.column()) {
+            case TimeColumn:
+                return QString::number(event.startNs / 1e9, 'f', 3);
+            case NameColumn:
+                return event.name;
+            case DurationColumn:
+                return event.kind == PerfTrace::Instant
+                           ? QString()
+                           : QString::number(event.durationNs / 1e6, 'f', 1);
+            case ThreadColumn:
+                return threadNames.value(event.thread);
+            case DetailColumn:
+                return event.detail;
+            }
+            return QVariant();
+        case Qt::TextAlignmentRole:
+            if (index.column() == DurationColumn)
+                return QVariant(Qt::AlignRight | Qt::AlignVCenter);
+            return QVariant();
+        case Qt::ForegroundRole:
+            if (event.name.startsWith("GUI "))
+                return QColor(Qt::red);
+            return QVariant();
+        default:
+            return QVariant();
+        }
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override
+    {
+        static const QStringList labels { "Time (s)", "Operation", "Duration (ms)", "Thread",
+                                          "Detail" };
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+            return QVariant();
+        return labels.value(section);
+    }
+
+private:
+    std::deque<PerfTrace::Event> events;
+    QHash<quint32, QString> threadNames;
+};
+
+PerfPanel::PerfPanel(StallWatchdog *watchdog, QWidget *parent)
+    : QWidget(parent), watchdog(watchdog)
+{
+    events = new EventModel(this);
+    eventList = new QTreeView(this);
+    eventList->setRootIsDecorated(false);
+    eventList->setUniformRowHeights(true);
+    eventList->setVerticalScrollMode(QAbstractItemView::ScrollPerItem);
+    eventList->setModel(events);
+
+    thresholdBox = new QSpinBox(this);
+    thresholdBox->setRange(50, 10000);
+    thresholdBox->setSingleStep(50);
+    thresholdBox->setSuffix(" ms");
+    thresholdBox->setValue(watchdog->threshold());
+    thresholdBox->setToolTip("Report the GUI thread as stalled after this long");
+    connect(thresholdBox, &QSpinBox::valueChanged, watchdog, &StallWatchdog::setThreshold);
+
+    QPushButton *clearBtn = new QPushButton("Clear", this);
+    QPushButton *exportBtn = new QPushButton("Export Trace...", this);
+    connect(clearBtn, &QPushButton::clicked, this, &PerfPanel::clearTrace);
+    connect(exportBtn, &QPushButton::clicked, this, &PerfPanel::exportTrace);
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    buttons->addWidget(new QLabel("Stall threshold:", this));
+    buttons->addWidget(thresholdBox);
+    buttons->addStretch();
+    buttons->addWidget(clearBtn);
+    buttons->addWidget(exportBtn);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(eventList);
+    layout->addLayout(buttons);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(RefreshMs);
+    connect(refreshTimer, &QTimer::timeout, this, &PerfPanel::refresh);
+
+    // A stall is worth seeing at once
+    connect(watchdog, &StallWatchdog::stalled, this, [this]() {
+        if (isVisible())
+            refresh();
+    });
+}
+
+void PerfPanel::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refresh();
+    refreshTimer->start();
+}
+
+void PerfPanel::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    refreshTimer->stop();
+}
+
+void PerfPanel::refresh()
+{
+    if (PerfTrace::recorded() == shown)
+        return;
+
+    quint64 recorded = 0;
+    const QList<PerfTrace::Event> fresh = PerfTrace::eventsAfter(shown, &recorded);
+    shown = recorded;
+
+    // Rows go in on top; whoever scrolled down keeps looking at the same ones
+    QScrollBar *bar = eventList->verticalScrollBar();
+    const int position = bar->value();
+    const int added = events->append(fresh, PerfTrace::threadNames());
+    if (position > 0)
+        bar->setValue(position + added);
+}
+
+void PerfPanel::exportTrace()
+{
+    const QString fileName = QFileDialog::getSaveFileName(
+        this, "Export Trace", "explorer-trace.json", "Chrome trace (*.json)");
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(PerfTrace::toChromeTrace()) < 0) {
+        QMessageBox::warning(this, "Export Failed", file.errorString());
+        return;
+    }
+}
+
+void PerfPanel::clearTrace()
+{
+    PerfTrace::clear();
+    events->clear();
+}
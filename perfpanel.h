@@ -0,0 +1,44 @@
+#ifndef PERFPANEL_H
+#define PERFPANEL_H
+
+#include <QWidget>
+
+class QTreeView;
+class QSpinBox;
+class QTimer;
+class StallWatchdog;
+
+// Shows the PerfTrace ring buffer, newest first, with GUI stalls marked.
+// The stall threshold can be changed here and the buffer exported as a
+// Chrome trace. The list is only refreshed while the panel is visible.
+//
+// The list is a model over the panel's own copy of the events. Each
+// refresh fetches only what was recorded since the last one and adds it
+// as new rows; the view keeps its place unless it is at the top.
+class PerfPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit PerfPanel(StallWatchdog *watchdog, QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void refresh();
+    void exportTrace();
+    void clearTrace();
+
+private:
+    class EventModel;
+
+    StallWatchdog *watchdog;
+    EventModel *events;
+    QTreeView *eventList;
+    QSpinBox *thresholdBox;
+    QTimer *refreshTimer;
+    quint64 shown = 0;
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "perftrace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+const size_t Capacity = 8192;
+
+struct Trace
+{
+    Trace()
+    {
+        clock.start();
+        ring.reserve(Capacity);
+    }
+
+    QMutex lock;
+    QElapsedTimer clock;
+    std::vector<PerfTrace::Event> ring;
+    size_t head = 0;                     // next slot once the ring is full
+    quint64 total = 0;
+    QHash<quint64, PerfTrace::Event> open;
+    quint64 nextId = 0;
+    QStringList guiScopes;
+    QHash<quint32, QString> threadNames;
+};
+
+Trace &trace()
+{
+    static Trace instance;
+    return instance;
+}
+
+// Caller holds the lock
+void push(Trace &t, PerfTrace::Event &&event)
+{
+    if (t.ring.size() < Capacity) {
+        t.ring.push_back(std::move(event));
+    } else {
+        t.ring[t.head] = std::move(event);
+        t.head = (t.head + 1) % Capacity;
+    }
+    ++t.total;
+}
+
+QString label(const QString &name, const QString &detail)
+{
+    return detail.isEmpty() ? name : name + ": " + detail;
+}
+
+std::atomic<quint32> threadCount { 0 };
+
+} // namespace
+
+qint64 PerfTrace::now()
+{
+    return trace().clock.nsecsElapsed();
+}
+
+bool PerfTrace::onGuiThread()
+{
+    const QCoreApplication *app = QCoreApplication::instance();
+    return app && QThread::currentThread() == app->thread();
+}
+
+// Small numbers, handed out on first use, read better in a trace viewer
+// than native thread ids
+quint32 PerfTrace::currentThread()
+{
+    thread_local quint32 id = 0;
+    if (id == 0) {
+        id = ++threadCount;
+        QString name = onGuiThread() ? QString("GUI") : QThread::currentThread()->objectName();
+        if (name.isEmpty())
+            name = QString("Worker %1").arg(id);
+
+        Trace &t = trace();
+        QMutexLocker locker(&t.lock);
+        t.threadNames.insert(id, name);
+    }
+    return id;
+}
+
+QString PerfTrace::threadName(quint32 thread)
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    return t.threadNames.value(thread);
+}
+
+QHash<quint32, QString> PerfTrace::threadNames()
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    return t.threadNames;
+}
+
+void PerfTrace::record(Event event)
+{
+    event.thread = currentThread();
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    push(t, std::move(event));
+}
+
+void PerfTrace::complete(const QString &name, const QString &detail, qint64 durationNs)
+{
+    Event event;
+    event.name = name;
+    event.detail = detail;
+    event.durationNs = durationNs;
+    event.startNs = now() - durationNs;
+    record(std::move(event));
+}
+
+void PerfTrace::instant(const QString &name, const QString &detail)
+{
+    Event event;
+    event.name = name;
+    event.detail = detail;
+    event.startNs = now();
+    event.kind = Instant;
+    record(std::move(event));
+}
+
+quint64 PerfTrace::begin(const QString &name, const QString &detail)
+{
+    Event event;
+    event.name = name;
+    event.detail = detail;
+    event.startNs = now();
+    event.thread = currentThread();
+    event.kind = Async;
+
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    event.id = ++t.nextId;
+    t.open.insert(event.id, event);
+    return event.id;
+}
+
+void PerfTrace::end(quint64 id, const QString &outcome)
+{
+    const qint64 finished = now();
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    auto it = t.open.find(id);
+    if (it == t.open.end())
+        return;
+
+    Event event = it.value();
+    t.open.erase(it);
+    event.durationNs = finished - event.startNs;
+    if (!outcome.isEmpty())
+        event.detail = event.detail.isEmpty() ? outcome : event.detail + " (" + outcome + ")";
+    push(t, std::move(event));
+}
+
+QList<PerfTrace::Event> PerfTrace::events()
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+
+    QList<Event> result;
+    result.reserve(qsizetype(t.ring.size()));
+    for (size_t i = 0; i < t.ring.size(); ++i)
+        result.append(t.ring[(t.head + i) % t.ring.size()]);
+    return result;
+}
+
+QList<PerfTrace::Event> PerfTrace::eventsAfter(quint64 seen, quint64 *total)
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    *total = t.total;
+
+    // The ring holds the last ring.size() events recorded
+    const quint64 held = quint64(t.ring.size());
+    const quint64 fresh = std::min(held, t.total - std::min(seen, t.total));
+    QList<Event> result;
+    result.reserve(qsizetype(fresh));
+    for (size_t i = size_t(held - fresh); i < t.ring.size(); ++i)
+        result.append(t.ring[(t.head + i) % t.ring.size()]);
+    return result;
+}
+
+quint64 PerfTrace::recorded()
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    return t.total;
+}
+
+void PerfTrace::clear()
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    t.ring.clear();
+    t.head = 0;
+}
+
+QStringList PerfTrace::running()
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    return t.guiScopes;
+}
+
+QStringList PerfTrace::inFlight()
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    QStringList result;
+    for (const Event &event : std::as_const(t.open))
+        result.append(label(event.name, event.detail));
+    return result;
+}
+
+void PerfTrace::enter(const QString &name)
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    t.guiScopes.append(name);
+}
+
+void PerfTrace::leave()
+{
+    Trace &t = trace();
+    QMutexLocker locker(&t.lock);
+    if (!t.guiScopes.isEmpty())
+        t.guiScopes.removeLast();
+}
+
+QByteArray PerfTrace::toChromeTrace()
+{
+    const QList<Event> all = events();
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray out;
+
+    QHash<quint32, QString> names;
+    {
+        Trace &t = trace();
+        QMutexLocker locker(&t.lock);
+        names = t.threadNames;
+    }
+    for (auto it = names.cbegin(); it != names.cend(); ++it) {
+        out.append(QJsonObject {
+            { "name", "thread_name" }, { "ph", "M" }, { "pid", pid }, { "tid", qint64(it.key()) },
+            { "args", QJsonObject { { "name", it.value() } } }
+        });
+    }
+
+    // Timestamps are in microseconds
+    for (const Event &event : all) {
+        QJsonObject object {
+            { "name", event.name },
+            { "cat", "explorer" },
+            { "pid", pid },
+            { "tid", qint64(event.thread) },
+            { "ts", event.startNs / 1000.0 },
+            { "args", QJsonObject { { "detail", event.detail } } }
+        };
+
+        switch (event.kind) {
+        case Complete:
+            object.insert("ph", "X");
+            object.insert("dur", event.durationNs / 1000.0);
+            out.append(object);
+            break;
+        case Instant:
+            object.insert("ph", "i");
+            object.insert("s", "t");
+            out.append(object);
+            break;
+        case Async: {
+            // Async work overlaps freely, so it gets a begin and an end
+            // of its own rather than a slice on its thread
+            object.insert("ph", "b");
+            object.insert("id", QString::number(event.id));
+            out.append(object);
+            object.insert("ph", "e");
+            object.insert("ts", (event.startNs + event.durationNs) / 1000.0);
+            object.remove("args");
+            out.append(object);
+            break;
+        }
+        }
+    }
+
+    const QJsonObject document {
+        { "traceEvents", out },
+        { "displayTimeUnit", "ms" }
+    };
+    return QJsonDocument(document).toJson(QJsonDocument::Compact);
+}
+
+PerfScope::PerfScope(const QString &name, const QString &detail)
+    : name(name), detail(detail), start(PerfTrace::now()), gui(PerfTrace::onGuiThread())
+{
+    if (gui)
+        PerfTrace::enter(label(name, detail));
+}
+
+PerfScope::~PerfScope()
+{
+    if (gui)
+        PerfTrace::leave();
+
+    PerfTrace::Event event;
+    event.name = name;
+    event.detail = detail;
+    event.startNs = start;
+    event.durationNs = PerfTrace::now() - start;
+    PerfTrace::record(std::move(event));
+}
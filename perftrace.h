@@ -0,0 +1,97 @@
+#ifndef PERFTRACE_H
+#define PERFTRACE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// Timings of the explorer's major operations, to find out what made it
+// hang.
+//
+// Events go into one fixed-size ring buffer shared by all threads. The
+// oldest ones are overwritten, so tracing is always on and never grows.
+// Work done inside one call is timed with a PerfScope on the stack; work
+// that outlives the call that starts it, like a search or a paste, is
+// bracketed with begin() and end().
+//
+// The scopes open on the GUI thread double as "what is running now",
+// which the StallWatchdog reads when the event loop stops turning.
+//
+// toChromeTrace() writes the buffer in the Trace Event format, which
+// chrome://tracing and Perfetto open.
+class PerfTrace
+{
+public:
+    enum Kind { Complete, Async, Instant };
+
+    struct Event
+    {
+        QString name;
+        QString detail;
+        qint64 startNs = 0;       // since the trace started
+        qint64 durationNs = 0;
+        quint32 thread = 0;
+        Kind kind = Complete;
+        quint64 id = 0;           // pairs the ends of async events
+    };
+
+    // Nanoseconds since the trace started
+    static qint64 now();
+
+    // An event that ends now and took durationNs
+    static void complete(const QString &name, const QString &detail, qint64 durationNs);
+    static void instant(const QString &name, const QString &detail = QString());
+
+    // Work that finishes later, maybe after other events have started
+    static quint64 begin(const QString &name, const QString &detail = QString());
+    static void end(quint64 id, const QString &outcome = QString());
+
+    // Oldest first
+    static QList<Event> events();
+    // Those of the events still held that were recorded after the first
+    // seen ones; *total is set to recorded() as of the same moment
+    static QList<Event> eventsAfter(quint64 seen, quint64 *total);
+    // Events recorded since start, overwritten and cleared ones included
+    static quint64 recorded();
+    static void clear();
+
+    static QString threadName(quint32 thread);
+    static QHash<quint32, QString> threadNames();
+
+    // Scopes open on the GUI thread, outermost first, and async work in flight
+    static QStringList running();
+    static QStringList inFlight();
+
+    static QByteArray toChromeTrace();
+
+private:
+    friend class PerfScope;
+    static void record(Event event);
+    static quint32 currentThread();
+    static bool onGuiThread();
+    static void enter(const QString &name);
+    static void leave();
+};
+
+// Times the rest of the enclosing block
+class PerfScope
+{
+public:
+    explicit PerfScope(const QString &name, const QString &detail = QString());
+    ~PerfScope();
+
+    void setDetail(const QString &text) { detail = text; }
+
+    PerfScope(const PerfScope &) = delete;
+    PerfScope &operator=(const PerfScope &) = delete;
+
+private:
+    QString name;
+    QString detail;
+    qint64 start;
+    bool gui;
+};
+
+#endif
@@ -1,8 +1,27 @@
+
 #include "propertiesdialog.h"
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QFileInfo>
 #include <QDir>
+#include <QLocale>
+#include <QDateTime>
+#include <QTreeWidget>
+#include <QTreeWidgetItem>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QDialogButtonBox>
+#include <algorithm>
+
+namespace {
+
+QString sizeText(qint64 bytes)
+{
+    QLocale locale;
+    return locale.formattedDataSize(bytes) + " (" + locale.toString(bytes) + " bytes)";
+}
+
+} // namespace
 
 PropertiesDialog::PropertiesDialog(const QString &path, QWidget *parent)
     : QDialog(parent)
@@ -15,23 +34,132 @@ PropertiesDialog::PropertiesDialog(const QString &path, QWidget *parent)
     text += "<b>Name:</b> " + info.fileName() + "<br>";
     text += "<b>Path:</b> " + path + "<br>";
     text += "<b>Type:</b> " + (info.isDir() ? "Folder" : info.suffix()) + "<br>";
-    text += "<b>Size:</b> " + QString::number(info.size()) + " bytes<br>";
+    if (!info.isDir())
+        text += "<b>Size:</b> " + sizeText(info.size()) + "<br>";
     text += "<b>Created:</b> " + info.birthTime().toString() + "<br>";
     text += "<b>Modified:</b> " + info.lastModified().toString() + "<br>";
     text += "<b>Hidden:</b> " + QString(info.isHidden() ? "Yes" : "No") + "<br>";
     text += "<b>Readable:</b> " + QString(info.isReadable() ? "Yes" : "No") + "<br>";
     text += "<b>Writable:</b> " + QString(info.isWritable() ? "Yes" : "No") + "<br>";
 
-    if (info.isDir()) {
-        QDir dir(path);
-        QFileInfoList list = dir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllEntries);
-        text += "<b>Contains:</b> " + QString::number(list.size()) + " items<br>";
-    }
-
     QLabel *label = new QLabel(text);
     label->setTextInteractionFlags(Qt::TextSelectableByMouse);
 
     QVBoxLayout *layout = new QVBoxLayout(this);
     layout->addWidget(label);
+
+    // Folder totals come in from the background as the tree is walked
+    if (info.isDir()) {
+        sizeLabel = new QLabel(this);
+        sizeLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+        layout->addWidget(sizeLabel);
+        showFolderSize(FolderSize(), false);
+
+        calculator = new SizeCalculator(this);
+        connect(calculator, &SizeCalculator::progress, this, [this](const FolderSize &size) {
+            showFolderSize(size, false);
+        });
+        connect(calculator, &SizeCalculator::finished, this, [this](const FolderSize &size) {
+            showFolderSize(size, true);
+        });
+        calculator->start(path);
+    }
+
+    setLayout(layout);
+}
+
+void PropertiesDialog::showFolderSize(const FolderSize &size, bool done)
+{
+    const QString pending = done ? QString() : " <i>(calculating…)</i>";
+    sizeLabel->setText("<b>Size:</b> " + sizeText(size.bytes) + pending + "<br>"
+                       + "<b>Size on disk:</b> " + sizeText(size.allocated) + "<br>"
+                       + "<b>Contains:</b> "
+                       + QString("%1 files, %2 folders").arg(size.files).arg(size.folders));
+}
+
+PropertiesDialog::PropertiesDialog(const QStringList &paths, QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(QString("Properties — %1 items").arg(paths.size()));
+
+    sizeLabel = new QLabel(this);
+    sizeLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+    typeList = new QTreeWidget(this);
+    typeList->setRootIsDecorated(false);
+    typeList->setHeaderLabels({ "Type", "Files", "Size" });
+    typeList->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    cancelButton = buttons->addButton("Stop", QDialogButtonBox::ActionRole);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(sizeLabel);
+    layout->addWidget(typeList);
+    layout->addWidget(buttons);
     setLayout(layout);
+    resize(420, 480);
+
+    calculator = new SizeCalculator(this);
+    connect(calculator, &SizeCalculator::summaryProgress, this,
+            [this](const SelectionSummary &summary) {
+                // A report queued before Stop must not undo it
+                if (!stopped)
+                    showSummary(summary, "calculating…");
+            });
+    connect(calculator, &SizeCalculator::summaryFinished, this,
+            [this](const SelectionSummary &summary) {
+                showSummary(summary, QString());
+                cancelButton->setEnabled(false);
+            });
+    connect(cancelButton, &QPushButton::clicked, this, [this]() {
+        calculator->cancel();
+        stopped = true;
+        cancelButton->setEnabled(false);
+        showSummary(lastSummary, "stopped");
+    });
+
+    showSummary(SelectionSummary(), "calculating…");
+    calculator->summarize(paths);
+}
+
+void PropertiesDialog::showSummary(const SelectionSummary &summary, const QString &state)
+{
+    QLocale locale;
+    const FolderSize &total = summary.total;
+    lastSummary = summary;
+
+    QString text;
+    text += "<b>Size:</b> " + sizeText(total.bytes) + "<br>";
+    text += "<b>Size on disk:</b> " + sizeText(total.allocated) + "<br>";
+    text += "<b>Contains:</b> "
+            + QString("%1 files, %2 folders").arg(total.files).arg(total.folders) + "<br>";
+    if (summary.oldestMs && summary.newestMs) {
+        const QDateTime oldest = QDateTime::fromMSecsSinceEpoch(*summary.oldestMs);
+        const QDateTime newest = QDateTime::fromMSecsSinceEpoch(*summary.newestMs);
+        text += "<b>Modified:</b> " + locale.toString(oldest, QLocale::ShortFormat)
+                + " – " + locale.toString(newest, QLocale::ShortFormat);
+    }
+    if (!state.isEmpty())
+        text += " <i>(" + state + ")</i>";
+    sizeLabel->setText(text);
+
+    // Largest types first
+    QList<QPair<QString, TypeTotal>> types;
+    for (auto it = summary.types.cbegin(); it != summary.types.cend(); ++it)
+        types.append({ it.key(), it.value() });
+    std::sort(types.begin(), types.end(), [](const auto &a, const auto &b) {
+        return a.second.bytes > b.second.bytes;
+    });
+
+    typeList->clear();
+    for (const auto &type : std::as_const(types)) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(typeList);
+        item->setText(0, type.first.isEmpty() ? "(no extension)" : type.first);
+        item->setText(1, locale.toString(type.second.files));
+        item->setText(2, locale.formattedDataSize(type.second.bytes));
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        item->setTextAlignment(2, Qt::AlignRight | Qt::AlignVCenter);
+    }
 }
@@ -3,12 +3,31 @@
 
 #include <QDialog>
 
+#include "sizecalculator.h"
+
+class QLabel;
+class QTreeWidget;
+class QPushButton;
+
 class PropertiesDialog : public QDialog
 {
     Q_OBJECT
 public:
     explicit PropertiesDialog(const QString &path, QWidget *parent=nullptr);
+
+    // Totals for many selected items, filled in as the workers get through them
+    explicit PropertiesDialog(const QStringList &paths, QWidget *parent=nullptr);
+
+private:
+    void showFolderSize(const FolderSize &size, bool done);
+    void showSummary(const SelectionSummary &summary, const QString &state);
+
+    QLabel *sizeLabel = nullptr;
+    QTreeWidget *typeList = nullptr;
+    QPushButton *cancelButton = nullptr;
+    SizeCalculator *calculator = nullptr;
+    SelectionSummary lastSummary;
+    bool stopped = false;
 };
 
 #endif
-
@@ -0,0 +1,182 @@
+#include "searchengine.h"
+#include "fileindex.h"
+#include "parallelwalker.h"
+#include "namematcher.h"
+#include "contentscanner.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QtConcurrent>
+
+namespace {
+
+// The first match is sent on its own so something shows up immediately;
+// after that, matches are grouped to keep the GUI thread's work per batch small.
+const int MaxBatchSize = 256;
+const int MaxBatchDelayMs = 50;
+
+// Shared by all walker threads of one search. add() only sees the clock
+// when a match arrives, so the walker also calls poll() as it goes; a
+// match followed by a long stretch of misses still shows up on time.
+class BatchSender
+{
+public:
+    BatchSender(SearchEngine *engine, quint64 gen)
+        : engine(engine), gen(gen)
+    {
+        clock.start();
+    }
+
+    void add(const SearchHit &hit)
+    {
+        QMutexLocker locker(&lock);
+        batch.append(hit);
+        queued.store(batch.size(), std::memory_order_relaxed);
+        ++total;
+        if (total == 1 || batch.size() >= MaxBatchSize || due())
+            send();
+    }
+
+    // Cheap enough to call per entry: no lock unless a batch is overdue
+    void poll()
+    {
+        if (queued.load(std::memory_order_relaxed) == 0 || !due())
+            return;
+        QMutexLocker locker(&lock);
+        if (due())
+            send();
+    }
+
+    void flush()
+    {
+        QMutexLocker locker(&lock);
+        send();
+    }
+
+    int count() const { return total; }
+
+private:
+    bool due() const
+    {
+        return clock.elapsed() - sentAt.load(std::memory_order_relaxed) >= MaxBatchDelayMs;
+    }
+
+    void send()
+    {
+        if (batch.isEmpty())
+            return;
+        emit engine->resultsReady(gen, batch);
+        batch.clear();
+        queued.store(0, std::memory_order_relaxed);
+        sentAt.store(clock.elapsed(), std::memory_order_relaxed);
+    }
+
+    QMutex lock;
+    SearchEngine *engine;
+    quint64 gen;
+    QList<SearchHit> batch;
+    QElapsedTimer clock;                 // started once, read by every thread
+    std::atomic<qint64> sentAt { 0 };
+    std::atomic<int> queued { 0 };
+    int total = 0;
+};
+
+} // namespace
+
+SearchEngine::SearchEngine(QObject *parent)
+    : QObject(parent)
+{
+}
+
+SearchEngine::~SearchEngine()
+{
+    cancel();
+    for (QFuture<void> &job : jobs)
+        job.waitForFinished();
+}
+
+quint64 SearchEngine::start(const QString &root, const QString &text, Mode mode,
+                            QSharedPointer<FileIndex> index)
+{
+    quint64 gen = ++generation;
+
+    jobs.removeIf([](const QFuture<void> &job) { return job.isFinished(); });
+    jobs.append(QtConcurrent::run([=]() { run(gen, root, text, mode, index); }));
+
+    return gen;
+}
+
+void SearchEngine::cancel()
+{
+    ++generation;
+}
+
+void SearchEngine::run(quint64 gen, const QString &root, const QString &text, Mode mode,
+                       QSharedPointer<FileIndex> index)
+{
+    auto stale = [&]() { return generation.load(std::memory_order_relaxed) != gen; };
+
+    BatchSender sender(this, gen);
+
+    // Walkers check this per entry and while idle, which doubles as the
+    // tick that sends a batch whose delay has run out
+    auto progress = [&]() {
+        sender.poll();
+        return stale();
+    };
+
+    if (mode == ContentSearch) {
+        // Files are scanned on the walker threads themselves
+        ContentScanner scanner(text);
+        if (scanner.isValid()) {
+            ParallelWalker walker;
+            walker.setCancelCheck(progress);
+            walker.walk({ root }, [&](const WalkEntry &entry) {
+                if (entry.isDir)
+                    return true;
+
+                const QString path = entry.filePath();
+                QFileInfo info;
+                scanner.scanFile(path, [&](const ContentMatch &match) {
+                    if (info.filePath().isEmpty())
+                        info = QFileInfo(path);
+
+                    SearchHit hit;
+                    hit.info = info;
+                    hit.matchText = match.matchText;
+                    hit.lineText = match.lineText;
+                    hit.line = match.line;
+                    hit.offset = match.offset;
+                    sender.add(hit);
+                    return !stale();
+                });
+                return true;
+            });
+        }
+    } else if (index) {
+        const QStringList paths = index->query(text);
+        for (const QString &path : paths) {
+            if (progress())
+                return;
+            QFileInfo info(path);
+            if (info.exists())   // index may predate a delete
+                sender.add({ info, info.isDir(), text });
+        }
+    } else {
+        // QFileInfo (and its stat) only for the entries that match
+        NameMatcher matcher(text);
+        ParallelWalker walker;
+        walker.setCancelCheck(progress);
+        walker.walk({ root }, [&](const WalkEntry &entry) {
+            if (matcher.matches(entry.rawName))
+                sender.add({ QFileInfo(entry.filePath()), entry.isDir, text });
+            return true;
+        });
+    }
+
+    if (stale())
+        return;
+
+    sender.flush();
+    emit finished(gen, sender.count());
+}
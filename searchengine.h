@@ -0,0 +1,60 @@
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+#include <QObject>
+#include <QFileInfo>
+#include <QList>
+#include <QFuture>
+#include <QSharedPointer>
+#include <QMetaType>
+
+#include <atomic>
+
+class FileIndex;
+
+struct SearchHit
+{
+    QFileInfo info;
+    bool isDir = false;   // known when found, so the GUI need not stat
+    QString matchText;    // text to highlight
+    QString lineText;     // content matches only
+    qint64 line = 0;      // 1-based, 0 for name matches
+    qint64 offset = -1;   // byte offset of a content match
+};
+Q_DECLARE_METATYPE(SearchHit)
+
+// Runs recursive searches off the GUI thread and streams matches back
+// in small batches. Every start() gets a new generation number; workers of
+// older generations notice the change and stop at the next entry, and
+// receivers drop any batch whose generation is no longer current.
+class SearchEngine : public QObject
+{
+    Q_OBJECT
+public:
+    enum Mode {
+        NameSearch,      // file and folder names
+        ContentSearch    // lines inside files, see ContentScanner
+    };
+
+    explicit SearchEngine(QObject *parent = nullptr);
+    ~SearchEngine() override;
+
+    quint64 start(const QString &root, const QString &text, Mode mode = NameSearch,
+                  QSharedPointer<FileIndex> index = {});
+    void cancel();
+
+    quint64 currentGeneration() const { return generation.load(); }
+
+signals:
+    void resultsReady(quint64 generation, const QList<SearchHit> &batch);
+    void finished(quint64 generation, int total);
+
+private:
+    void run(quint64 gen, const QString &root, const QString &text, Mode mode,
+             QSharedPointer<FileIndex> index);
+
+    std::atomic<quint64> generation { 0 };
+    QList<QFuture<void>> jobs;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "searchresultsmodel.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+using Span = SearchResultsModel::Span;
+
+// Every occurrence of term in text, from offset on, in text order.
+// A term that is not found as a whole is tried word by word, so
+// multi-term queries still light up the parts that matched.
+void findSpans(QStringView text, qsizetype offset, const QString &term,
+               std::vector<Span> &spans)
+{
+    const size_t first = spans.size();
+    const qsizetype limit = std::numeric_limits<quint16>::max();
+
+    auto addAll = [&](QStringView needle) {
+        if (needle.isEmpty())
+            return;
+        for (qsizetype pos = text.indexOf(needle, offset, Qt::CaseInsensitive);
+             pos >= 0 && pos + needle.size() <= limit;
+             pos = text.indexOf(needle, pos + needle.size(), Qt::CaseInsensitive))
+            spans.push_back({ quint16(pos), quint16(needle.size()) });
+    };
+
+    addAll(term);
+    if (spans.size() == first && term.contains(' ')) {
+        const QList<QStringView> words = QStringView(term).split(' ', Qt::SkipEmptyParts);
+        for (QStringView word : words)
+            addAll(word);
+        std::sort(spans.begin() + first, spans.end(), [](const Span &a, const Span &b) {
+            return a.start < b.start;
+        });
+    }
+}
+
+} // namespace
+
+SearchResultsModel::SearchResultsModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+void SearchResultsModel::clear(const QString &text)
+{
+    beginResetModel();
+    query = text;
+    paths.clear();
+    pathEnds.clear();
+    details.clear();
+    folders.clear();
+    contentDetails.clear();
+    spanEnds.clear();
+    allSpans.clear();
+    for (auto *array : { &pathEnds, &details, &spanEnds })
+        array->shrink_to_fit();
+    folders.shrink_to_fit();
+    contentDetails.shrink_to_fit();
+    allSpans.shrink_to_fit();
+    ++resets;
+    endResetModel();
+}
+
+void SearchResultsModel::append(const QList<SearchHit> &hits)
+{
+    if (hits.isEmpty())
+        return;
+
+    const int first = int(pathEnds.size());
+    beginInsertRows(QModelIndex(), first, first + int(hits.size()) - 1);
+    for (const SearchHit &hit : hits) {
+        paths += hit.info.absoluteFilePath();
+        pathEnds.push_back(quint32(paths.size()));
+        folders.push_back(hit.isDir ? 1 : 0);
+
+        if (hit.line > 0 || hit.matchText != query) {
+            details.push_back(quint32(contentDetails.size()));
+            contentDetails.push_back({ hit.matchText, hit.lineText, hit.line, hit.offset });
+        } else {
+            details.push_back(NoDetail);
+        }
+
+        // Content hits are highlighted in the line, not in the name
+        const QString label = displayText(int(pathEnds.size()) - 1);
+        const qsizetype from = hit.line > 0 ? label.size() - hit.lineText.size() : 0;
+        findSpans(label, from, hit.matchText, allSpans);
+        spanEnds.push_back(quint32(allSpans.size()));
+    }
+    endInsertRows();
+}
+
+QString SearchResultsModel::path(int row) const
+{
+    const quint32 start = row > 0 ? pathEnds[row - 1] : 0;
+    return paths.mid(start, pathEnds[row] - start);
+}
+
+SearchResultsModel::SpanRange SearchResultsModel::spans(int row) const
+{
+    const quint32 start = row > 0 ? spanEnds[row - 1] : 0;
+    return { allSpans.data() + start, allSpans.data() + spanEnds[row] };
+}
+
+// Content hits show where in the file they matched
+QString SearchResultsModel::displayText(int row) const
+{
+    const QString filePath = path(row);
+    QString label = filePath.mid(filePath.lastIndexOf('/') + 1);
+
+    const quint32 detail = details[row];
+    if (detail != NoDetail && contentDetails[detail].line > 0)
+        label += QString(":%1: %2").arg(QString::number(contentDetails[detail].line),
+                                        contentDetails[detail].lineText);
+    return label;
+}
+
+int SearchResultsModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(pathEnds.size());
+}
+
+QVariant SearchResultsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= int(pathEnds.size()))
+        return QVariant();
+
+    const int row = index.row();
+    const ContentDetail *detail =
+        details[row] == NoDetail ? nullptr : &contentDetails[details[row]];
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return displayText(row);
+    case PathRole:
+        return path(row);
+    case MatchRole:
+        return detail ? detail->matchText : query;
+    case LineRole:
+        return detail && detail->line > 0 ? QVariant(detail->line) : QVariant();
+    case OffsetRole:
+        return detail && detail->line > 0 ? QVariant(detail->offset) : QVariant();
+    case IsDirRole:
+        return folders[row] != 0;
+    default:
+        return QVariant();
+    }
+}
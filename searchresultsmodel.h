@@ -0,0 +1,91 @@
+#ifndef SEARCHRESULTSMODEL_H
+#define SEARCHRESULTSMODEL_H
+
+#include <QAbstractListModel>
+#include <QString>
+
+#include <vector>
+
+#include "searchengine.h"
+
+// Read-only list of search hits, built for result sets in the millions.
+//
+// All paths are appended to one string buffer and each row is an offset
+// into it plus a flag byte; nothing is allocated per row. Content hits
+// also keep their line details in a side table. Appending a batch is a
+// single rows-inserted notification.
+//
+// The ranges to highlight in each row's text are found once, when the
+// row is added, and kept as packed spans for the delegate.
+//
+// Roles keep the contract of the old item model:
+// Qt::UserRole is the full path, +1 the text to highlight, +2 and +3 the
+// line and byte offset of a content match, +4 whether it is a folder.
+class SearchResultsModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles {
+        PathRole = Qt::UserRole,
+        MatchRole,
+        LineRole,
+        OffsetRole,
+        IsDirRole
+    };
+
+    struct Span
+    {
+        quint16 start;
+        quint16 length;
+    };
+
+    struct SpanRange
+    {
+        const Span *first;
+        const Span *last;
+        const Span *begin() const { return first; }
+        const Span *end() const { return last; }
+    };
+
+    explicit SearchResultsModel(QObject *parent = nullptr);
+
+    // Drops all rows; hits without their own match text highlight query
+    void clear(const QString &query);
+    void append(const QList<SearchHit> &hits);
+
+    QString path(int row) const;
+
+    // Highlight ranges in the display text of row
+    SpanRange spans(int row) const;
+
+    // Changes on every clear(), so row numbers can be used as cache keys
+    quint64 generation() const { return resets; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    QString displayText(int row) const;
+
+    struct ContentDetail
+    {
+        QString matchText;
+        QString lineText;
+        qint64 line = 0;
+        qint64 offset = -1;
+    };
+
+    static const quint32 NoDetail = 0xffffffff;
+
+    QString query;
+    QString paths;                      // every path, back to back
+    std::vector<quint32> pathEnds;      // row -> end of its path in paths
+    std::vector<quint32> details;       // row -> index into contentDetails
+    std::vector<quint8> folders;
+    std::vector<ContentDetail> contentDetails;
+    std::vector<quint32> spanEnds;      // row -> end of its spans in allSpans
+    std::vector<Span> allSpans;
+    quint64 resets = 0;
+};
+
+#endif
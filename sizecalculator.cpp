@@ -0,0 +1,631 @@
+#include "sizecalculator.h"
+#include "parallelwalker.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+#include <QtConcurrent>
+
+#include <functional>
+#include <thread>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+const int ProgressIntervalMs = 100;
+const quint32 CacheMagic = 0x46535a43;   // "FSZC"
+const quint32 CacheVersion = 2;
+const int MaxCachedTrees = 256;
+const int MaxStampedFolders = 20000;     // bigger trees are not cached
+
+// Checking a cached tree costs one stat per folder, walking it one per
+// entry. Trees with fewer than this many entries per folder are walked.
+const int MinEntriesPerFolder = 4;
+
+struct EntryStat
+{
+    bool ok = false;
+    bool isDir = false;
+    quint64 device = 0;
+    quint64 inode = 0;
+    quint64 links = 1;
+    qint64 size = 0;
+    qint64 allocated = 0;
+    qint64 mtimeNs = 0;
+};
+
+#ifdef Q_OS_LINUX
+EntryStat fromStat(const struct stat &st)
+{
+    EntryStat s;
+    s.ok = true;
+    s.isDir = S_ISDIR(st.st_mode);
+    s.device = quint64(st.st_dev);
+    s.inode = quint64(st.st_ino);
+    s.links = quint64(st.st_nlink);
+    s.size = qint64(st.st_size);
+    s.allocated = qint64(st.st_blocks) * 512;
+    s.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return s;
+}
+#endif
+
+EntryStat statPath(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0)
+        return EntryStat();
+    return fromStat(st);
+#else
+    QFileInfo info(path);
+    EntryStat s;
+    s.ok = info.exists();
+    s.isDir = info.isDir();
+    s.size = info.size();
+    s.allocated = s.size;
+    s.mtimeNs = info.lastModified().toMSecsSinceEpoch() * 1000000;
+    return s;
+#endif
+}
+
+// Like statPath(), but a symlink is described rather than followed
+EntryStat lstatPath(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    struct stat st;
+    if (::lstat(QFile::encodeName(path).constData(), &st) != 0)
+        return EntryStat();
+    return fromStat(st);
+#else
+    QFileInfo info(path);
+    if (!info.isSymLink())
+        return statPath(path);
+    EntryStat s;
+    s.ok = true;
+    return s;
+#endif
+}
+
+EntryStat statEntry(const WalkEntry &entry)
+{
+#ifdef Q_OS_LINUX
+    struct stat st;
+    const QByteArray name = entry.rawName.toByteArray();
+    if (::fstatat(entry.dirFd, name.constData(), &st, AT_SYMLINK_NOFOLLOW) != 0)
+        return EntryStat();
+    return fromStat(st);
+#else
+    QFileInfo info(entry.filePath());
+    EntryStat s;
+    s.ok = info.exists() || info.isSymLink();
+    s.isDir = info.isDir() && !info.isSymLink();
+    s.size = info.size();
+    s.allocated = s.size;
+    s.mtimeNs = info.lastModified().toMSecsSinceEpoch() * 1000000;
+    return s;
+#endif
+}
+
+//-------------------------------------------
+// Cache
+//-------------------------------------------
+
+// A folder below the cached root, as it was when the totals were taken
+struct FolderStamp
+{
+    QString relativePath;
+    quint64 inode = 0;
+    qint64 mtimeNs = 0;
+};
+
+struct CacheEntry
+{
+    QString root;
+    quint64 device = 0;
+    quint64 inode = 0;
+    qint64 mtimeNs = 0;
+    FolderSize size;
+    QList<FolderStamp> folders;
+};
+
+QDataStream &operator<<(QDataStream &out, const FolderStamp &stamp)
+{
+    return out << stamp.relativePath << stamp.inode << stamp.mtimeNs;
+}
+
+QDataStream &operator>>(QDataStream &in, FolderStamp &stamp)
+{
+    return in >> stamp.relativePath >> stamp.inode >> stamp.mtimeNs;
+}
+
+QDataStream &operator<<(QDataStream &out, const CacheEntry &entry)
+{
+    return out << entry.root << entry.device << entry.inode << entry.mtimeNs
+               << entry.size.bytes << entry.size.allocated << entry.size.files
+               << entry.size.folders << entry.folders;
+}
+
+QDataStream &operator>>(QDataStream &in, CacheEntry &entry)
+{
+    return in >> entry.root >> entry.device >> entry.inode >> entry.mtimeNs
+              >> entry.size.bytes >> entry.size.allocated >> entry.size.files
+              >> entry.size.folders >> entry.folders;
+}
+
+// One file per tree, so storing a result writes only that tree and
+// nothing is held in memory between lookups. A file's mtime is its
+// last use, which is what eviction goes by.
+class SizeCache
+{
+public:
+    static SizeCache &instance()
+    {
+        static SizeCache cache;
+        return cache;
+    }
+
+    bool lookup(const QString &root, const EntryStat &rootStat, FolderSize &size);
+    void store(const QString &root, const EntryStat &rootStat, const FolderSize &size,
+               const QList<FolderStamp> &folders);
+
+private:
+    static QString directory()
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/sizes";
+    }
+
+    static QString filePath(const QString &root)
+    {
+        const QByteArray key = QCryptographicHash::hash(root.toUtf8(), QCryptographicHash::Sha1);
+        return directory() + "/" + QString::fromLatin1(key.toHex()) + ".dat";
+    }
+
+    SizeCache()
+    {
+        // Version 1 kept every tree in one file
+        QFile::remove(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                      + "/sizes.dat");
+    }
+
+    void evict();
+
+    QMutex lock;   // serializes writers and eviction
+};
+
+bool SizeCache::lookup(const QString &root, const EntryStat &rootStat, FolderSize &size)
+{
+    QFile file(filePath(root));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != CacheMagic || version != CacheVersion)
+        return false;
+
+    // The root first, so a tree that moved on is dismissed before the stamps
+    CacheEntry entry;
+    in >> entry.root >> entry.device >> entry.inode >> entry.mtimeNs;
+    if (in.status() != QDataStream::Ok || entry.root != root
+        || entry.device != rootStat.device || entry.inode != rootStat.inode
+        || entry.mtimeNs != rootStat.mtimeNs)
+        return false;
+
+    in >> entry.size.bytes >> entry.size.allocated >> entry.size.files
+       >> entry.size.folders >> entry.folders;
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    // Any folder below that gained, lost or renamed an entry has a new mtime
+    const QDir dir(root);
+    for (const FolderStamp &stamp : std::as_const(entry.folders)) {
+        const EntryStat s = statPath(dir.filePath(stamp.relativePath));
+        if (!s.ok || s.inode != stamp.inode || s.mtimeNs != stamp.mtimeNs)
+            return false;
+    }
+
+    file.close();
+    file.open(QIODevice::ReadWrite);
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    size = entry.size;
+    return true;
+}
+
+void SizeCache::store(const QString &root, const EntryStat &rootStat, const FolderSize &size,
+                      const QList<FolderStamp> &folders)
+{
+    // Not worth it when checking would cost about as much as walking
+    if (folders.size() > MaxStampedFolders
+        || qint64(folders.size()) * MinEntriesPerFolder > size.files + size.folders) {
+        QFile::remove(filePath(root));
+        return;
+    }
+
+    CacheEntry entry;
+    entry.root = root;
+    entry.device = rootStat.device;
+    entry.inode = rootStat.inode;
+    entry.mtimeNs = rootStat.mtimeNs;
+    entry.size = size;
+    entry.folders = folders;
+
+    QMutexLocker locker(&lock);
+    QDir().mkpath(directory());
+
+    QSaveFile file(filePath(root));
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out << CacheMagic << CacheVersion << entry;
+    if (file.commit())
+        evict();
+}
+
+// Forget the trees looked at least recently
+void SizeCache::evict()
+{
+    const QFileInfoList files = QDir(directory()).entryInfoList(
+        { "*.dat" }, QDir::Files, QDir::Time);
+    for (qsizetype i = MaxCachedTrees; i < files.size(); ++i)
+        QFile::remove(files.at(i).absoluteFilePath());
+}
+
+//-------------------------------------------
+// Selection summary
+//-------------------------------------------
+
+const int ShardCount = 16;
+
+// Accumulates a summary from many threads. Each thread adds into the
+// shard its id hashes to, so the locks are practically uncontended.
+class SummaryBuilder
+{
+public:
+    // False if this file was already counted through another hard link
+    bool addFile(const EntryStat &s, QByteArrayView name)
+    {
+        if (s.links > 1) {
+            QMutexLocker locker(&linkLock);
+            const QPair<quint64, quint64> key(s.device, s.inode);
+            if (linked.contains(key))
+                return false;
+            linked.insert(key);
+        }
+
+        const qsizetype dot = name.lastIndexOf('.');
+        const QString type = dot > 0 ? QString::fromUtf8(name.mid(dot + 1)).toLower() : QString();
+        const qint64 mtimeMs = s.mtimeNs / 1000000;
+
+        Shard &shard = currentShard();
+        QMutexLocker locker(&shard.lock);
+        SelectionSummary &sum = shard.summary;
+        ++sum.total.files;
+        sum.total.bytes += s.size;
+        sum.total.allocated += s.allocated;
+        TypeTotal &t = sum.types[type];
+        ++t.files;
+        t.bytes += s.size;
+        if (!sum.oldestMs || mtimeMs < *sum.oldestMs)
+            sum.oldestMs = mtimeMs;
+        if (!sum.newestMs || mtimeMs > *sum.newestMs)
+            sum.newestMs = mtimeMs;
+        return true;
+    }
+
+    void addFolder(const EntryStat &s)
+    {
+        Shard &shard = currentShard();
+        QMutexLocker locker(&shard.lock);
+        ++shard.summary.total.folders;
+        shard.summary.total.allocated += s.allocated;
+    }
+
+    SelectionSummary snapshot()
+    {
+        SelectionSummary merged;
+        for (Shard &shard : shards) {
+            QMutexLocker locker(&shard.lock);
+            const SelectionSummary &sum = shard.summary;
+            merged.total.bytes += sum.total.bytes;
+            merged.total.allocated += sum.total.allocated;
+            merged.total.files += sum.total.files;
+            merged.total.folders += sum.total.folders;
+            for (auto it = sum.types.cbegin(); it != sum.types.cend(); ++it) {
+                TypeTotal &t = merged.types[it.key()];
+                t.files += it->files;
+                t.bytes += it->bytes;
+            }
+            if (sum.oldestMs && (!merged.oldestMs || *sum.oldestMs < *merged.oldestMs))
+                merged.oldestMs = sum.oldestMs;
+            if (sum.newestMs && (!merged.newestMs || *sum.newestMs > *merged.newestMs))
+                merged.newestMs = sum.newestMs;
+        }
+        return merged;
+    }
+
+private:
+    struct Shard
+    {
+        QMutex lock;
+        SelectionSummary summary;
+    };
+
+    Shard &currentShard()
+    {
+        return shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % ShardCount];
+    }
+
+    Shard shards[ShardCount];
+    QMutex linkLock;
+    QSet<QPair<quint64, quint64>> linked;
+};
+
+// Hands a report from a worker to the GUI thread. It is dropped there if
+// the calculator is gone or has moved on from the job that sent it.
+template <typename Report>
+void post(const QPointer<SizeCalculator> &self,
+          const QSharedPointer<std::atomic<bool>> &stopped, Report report)
+{
+    QMetaObject::invokeMethod(QCoreApplication::instance(), [self, stopped, report]() {
+        if (self && !stopped->load())
+            report(self.data());
+    }, Qt::QueuedConnection);
+}
+
+} // namespace
+
+//-------------------------------------------
+// Calculator
+//-------------------------------------------
+SizeCalculator::SizeCalculator(QObject *parent)
+    : QObject(parent)
+{
+}
+
+// A job stuck in a stat on a dead mount cannot be stopped, so nothing
+// waits for one: it only sees its own flag, and reports reach the
+// calculator only if it still exists and has not cancelled the job.
+SizeCalculator::~SizeCalculator()
+{
+    cancel();
+}
+
+void SizeCalculator::cancel()
+{
+    if (stopped)
+        *stopped = true;
+}
+
+QSharedPointer<std::atomic<bool>> SizeCalculator::newJob()
+{
+    cancel();
+    stopped = QSharedPointer<std::atomic<bool>>::create(false);
+    return stopped;
+}
+
+void SizeCalculator::start(const QString &path)
+{
+    const QSharedPointer<std::atomic<bool>> cancelled = newJob();
+    const QString root = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+    const QString prefix = root.endsWith('/') ? root : root + "/";
+
+    const QPointer<SizeCalculator> self(this);
+    auto finish = [self, cancelled](const FolderSize &size, bool fromCache) {
+        post(self, cancelled, [size, fromCache](SizeCalculator *calculator) {
+            emit calculator->finished(size, fromCache);
+        });
+    };
+
+    QtConcurrent::run([self, cancelled, finish, root, prefix]() {
+        const EntryStat rootStat = statPath(root);
+        if (!rootStat.ok) {
+            finish(FolderSize(), false);
+            return;
+        }
+
+        // Like du, anything but a folder counts as itself
+        if (!rootStat.isDir) {
+            FolderSize size;
+            size.bytes = rootStat.size;
+            size.allocated = rootStat.allocated;
+            size.files = 1;
+            finish(size, false);
+            return;
+        }
+
+        FolderSize cached;
+        if (SizeCache::instance().lookup(root, rootStat, cached)) {
+            finish(cached, true);
+            return;
+        }
+
+        std::atomic<qint64> bytes { 0 };
+        std::atomic<qint64> allocated { rootStat.allocated };
+        std::atomic<qint64> files { 0 };
+        std::atomic<qint64> folders { 0 };
+
+        auto snapshot = [&]() {
+            FolderSize size;
+            size.bytes = bytes.load();
+            size.allocated = allocated.load();
+            size.files = files.load();
+            size.folders = folders.load();
+            return size;
+        };
+
+        QMutex lock;
+        QSet<QPair<quint64, quint64>> linked;   // (device, inode) of files with several links
+        QList<FolderStamp> stamps;
+
+        QElapsedTimer clock;
+        clock.start();
+        std::atomic<qint64> nextReport { ProgressIntervalMs };
+
+        ParallelWalker walker;
+        walker.setFilters(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files | QDir::Hidden
+                          | QDir::System);
+        walker.setCancelCheck([cancelled]() { return cancelled->load(); });
+        walker.walk({ root }, [&](const WalkEntry &entry) {
+            const EntryStat s = statEntry(entry);
+            if (!s.ok)
+                return false;
+
+            if (s.isDir) {
+                ++folders;
+                allocated += s.allocated;
+                // One past the cap is enough for store() to turn the tree down
+                QMutexLocker locker(&lock);
+                if (stamps.size() <= MaxStampedFolders)
+                    stamps.append({ entry.filePath().mid(prefix.size()), s.inode, s.mtimeNs });
+                return true;
+            }
+
+            if (s.links > 1) {
+                QMutexLocker locker(&lock);
+                const QPair<quint64, quint64> key(s.device, s.inode);
+                if (linked.contains(key))
+                    return false;
+                linked.insert(key);
+            }
+
+            ++files;
+            bytes += s.size;
+            allocated += s.allocated;
+
+            // Whoever crosses the deadline first reports
+            qint64 due = nextReport.load();
+            const qint64 now = clock.elapsed();
+            if (now >= due && nextReport.compare_exchange_strong(due, now + ProgressIntervalMs))
+            {
+                const FolderSize size = snapshot();
+                post(self, cancelled, [size](SizeCalculator *calculator) {
+                    emit calculator->progress(size);
+                });
+            }
+            return false;
+        });
+
+        if (cancelled->load())
+            return;
+
+        const FolderSize total = snapshot();
+        finish(total, false);
+        SizeCache::instance().store(root, rootStat, total, stamps);
+    });
+}
+
+void SizeCalculator::summarize(const QStringList &paths)
+{
+    const QSharedPointer<std::atomic<bool>> cancelled = newJob();
+    const QPointer<SizeCalculator> self(this);
+
+    QtConcurrent::run([self, cancelled, paths]() {
+        SummaryBuilder builder;
+        QElapsedTimer clock;
+        clock.start();
+        std::atomic<qint64> nextReport { ProgressIntervalMs };
+
+        auto maybeReport = [&]() {
+            qint64 due = nextReport.load();
+            const qint64 now = clock.elapsed();
+            if (now >= due && nextReport.compare_exchange_strong(due, now + ProgressIntervalMs))
+            {
+                const SelectionSummary summary = builder.snapshot();
+                post(self, cancelled, [summary](SizeCalculator *calculator) {
+                    emit calculator->summaryProgress(summary);
+                });
+            }
+        };
+
+        QStringList selected;
+        QList<EntryStat> stats;
+        QSet<QString> folders;
+        for (const QString &path : paths) {
+            if (cancelled->load())
+                return;
+
+            const QString clean = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+            const EntryStat s = lstatPath(clean);
+            if (!s.ok)
+                continue;
+            selected.append(clean);
+            stats.append(s);
+            if (s.isDir)
+                folders.insert(clean);
+        }
+
+        // Anything below another selected folder is counted by that folder's walk
+        auto coveredByFolder = [&](const QString &path) {
+            const qsizetype first = path.indexOf('/');
+            for (qsizetype slash = path.lastIndexOf('/'); slash >= 0;
+                 slash = slash > 0 ? path.lastIndexOf('/', slash - 1) : -1) {
+                // A root keeps its slash: "/", "C:/"
+                const QString parent = path.left(slash == first ? slash + 1 : slash);
+                if (parent != path && folders.contains(parent))
+                    return true;
+            }
+            return false;
+        };
+
+        // Selected files count right away; selected folders are walked together
+        QStringList roots;
+        QSet<QString> seen;
+        for (qsizetype i = 0; i < selected.size(); ++i) {
+            const QString &path = selected.at(i);
+            if (seen.contains(path) || coveredByFolder(path))
+                continue;
+            seen.insert(path);
+
+            const EntryStat &s = stats.at(i);
+            if (s.isDir) {
+                builder.addFolder(s);
+                roots.append(path);
+            } else {
+                builder.addFile(s, QFileInfo(path).fileName().toUtf8());
+            }
+            maybeReport();
+        }
+
+        ParallelWalker walker;
+        walker.setFilters(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files | QDir::Hidden
+                          | QDir::System);
+        walker.setCancelCheck([cancelled]() { return cancelled->load(); });
+        walker.walk(roots, [&](const WalkEntry &entry) {
+            const EntryStat s = statEntry(entry);
+            if (!s.ok)
+                return false;
+
+            if (s.isDir)
+                builder.addFolder(s);
+            else
+                builder.addFile(s, entry.rawName);
+            maybeReport();
+            return s.isDir;
+        });
+
+        if (!cancelled->load()) {
+            const SelectionSummary summary = builder.snapshot();
+            post(self, cancelled, [summary](SizeCalculator *calculator) {
+                emit calculator->summaryFinished(summary);
+            });
+        }
+    });
+}
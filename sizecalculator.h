@@ -0,0 +1,84 @@
+#ifndef SIZECALCULATOR_H
+#define SIZECALCULATOR_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QMetaType>
+#include <QHash>
+#include <QStringList>
+
+#include <atomic>
+#include <optional>
+
+struct FolderSize
+{
+    qint64 bytes = 0;        // apparent size of the files below
+    qint64 allocated = 0;    // disk space in use, folders included
+    qint64 files = 0;
+    qint64 folders = 0;
+};
+Q_DECLARE_METATYPE(FolderSize)
+
+struct TypeTotal
+{
+    qint64 files = 0;
+    qint64 bytes = 0;
+};
+
+// Totals for a whole selection, folders walked recursively
+struct SelectionSummary
+{
+    FolderSize total;            // selected folders count as folders too
+    QHash<QString, TypeTotal> types;   // by lower-case suffix, "" for none
+    std::optional<qint64> oldestMs;    // file modification times, unset if no files
+    std::optional<qint64> newestMs;
+};
+Q_DECLARE_METATYPE(SelectionSummary)
+
+// Adds up a folder tree in the background, like du.
+//
+// The walk runs on the parallel walker and stats every entry once.
+// Hard-linked files are counted once, by inode. Running totals are
+// reported as the walk goes.
+//
+// Finished totals are cached on disk under the folder's inode and mtime,
+// together with the inode and mtime of every folder below it. Asking
+// again for an unchanged tree only re-stats those folders. The check
+// sees files added, removed or renamed anywhere in the tree. It does not
+// see a file that changed size in place. Trees with very many folders, or
+// so few files per folder that the check would cost about as much as the
+// walk, are not cached.
+//
+// summarize() does the same for a whole selection and also breaks the
+// files down by type and records their date range. Workers add into
+// per-thread shards, which are merged only when a report is due. A path
+// inside another selected folder is left to that folder's walk, so it is
+// not counted twice. This mode always walks; the cache holds totals only.
+class SizeCalculator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SizeCalculator(QObject *parent = nullptr);
+    ~SizeCalculator() override;
+
+    // A path that is not a folder reports its own size as one file
+    void start(const QString &path);
+    void summarize(const QStringList &paths);
+    void cancel();
+
+signals:
+    void progress(const FolderSize &size);
+    void finished(const FolderSize &size, bool fromCache);
+
+    void summaryProgress(const SelectionSummary &summary);
+    void summaryFinished(const SelectionSummary &summary);
+
+private:
+    QSharedPointer<std::atomic<bool>> newJob();
+
+    // Set when the running job is cancelled or replaced; the job keeps
+    // its own reference, so nothing has to wait for it to finish
+    QSharedPointer<std::atomic<bool>> stopped;
+};
+
+#endif
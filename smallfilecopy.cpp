@@ -0,0 +1,703 @@
+#include "smallfilecopy.h"
+#include "fastcopy.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+
+const int MaxThreads = 16;
+
+#if defined(Q_OS_LINUX) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING
+
+const int ReadBufferSize = 128 * 1024;
+
+//-------------------------------------------
+// Ring
+//-------------------------------------------
+
+// Bare io_uring on raw syscalls; only what the copier needs.
+class Ring
+{
+public:
+    ~Ring();
+
+    bool init(unsigned entries);
+    bool supports(std::initializer_list<int> ops);
+
+    // Null when the submission queue is full
+    io_uring_sqe *nextSqe();
+
+    // Hands queued entries to the kernel and waits for at least waitFor
+    // completions.
+    bool submit(unsigned waitFor);
+
+    template <typename Handler>
+    void drain(Handler handler);
+
+private:
+    int fd = -1;
+    void *sqRing = MAP_FAILED;
+    void *cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe *cqes = nullptr;
+
+    unsigned localTail = 0;
+    unsigned unsubmitted = 0;
+};
+
+Ring::~Ring()
+{
+    if (sqes != MAP_FAILED)
+        ::munmap(sqes, sqesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+        ::munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+        ::munmap(sqRing, sqRingSize);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool Ring::init(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = int(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0)
+        return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sqRingSize = cqRingSize = qMax(sqRingSize, cqRingSize);
+
+    sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+        return false;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cqRing = sqRing;
+    } else {
+        cqRing = ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+            return false;
+    }
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED)
+        return false;
+
+    char *sq = static_cast<char *>(sqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+
+    char *cq = static_cast<char *>(cqRing);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    localTail = *sqTail;
+    return true;
+}
+
+bool Ring::supports(std::initializer_list<int> ops)
+{
+    // The probe reports every opcode up to IORING_OP_LAST
+    const size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<char> buffer(size, 0);
+    io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+    if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+        return false;
+
+    for (int op : ops) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            return false;
+    }
+    return true;
+}
+
+io_uring_sqe *Ring::nextSqe()
+{
+    const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (localTail - head >= sqEntries)
+        return nullptr;
+
+    const unsigned index = localTail & sqMask;
+    sqArray[index] = index;
+    io_uring_sqe *sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++localTail;
+    ++unsubmitted;
+    return sqe;
+}
+
+bool Ring::submit(unsigned waitFor)
+{
+    __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+
+    for (;;) {
+        const unsigned flags = waitFor ? IORING_ENTER_GETEVENTS : 0;
+        const int rc = int(::syscall(__NR_io_uring_enter, fd, unsubmitted, waitFor, flags,
+                                     nullptr, 0));
+        if (rc >= 0) {
+            unsubmitted -= unsigned(rc);
+            return true;
+        }
+        if (errno == EINTR)
+            continue;
+        // EAGAIN/EBUSY: the kernel is short of resources or completions;
+        // reaping some is what frees them.
+        return errno == EAGAIN || errno == EBUSY;
+    }
+}
+
+template <typename Handler>
+void Ring::drain(Handler handler)
+{
+    unsigned head = *cqHead;
+    for (;;) {
+        const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail)
+            break;
+        const io_uring_cqe cqe = cqes[head & cqMask];
+        ++head;
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        handler(cqe.user_data, cqe.res);
+    }
+}
+
+//-------------------------------------------
+// Pipeline
+//-------------------------------------------
+
+enum Op {
+    OpOpenSource,
+    OpStat,
+    OpOpenTarget,
+    OpRead,
+    OpWrite,
+    OpCloseSource,
+    OpCloseTarget
+};
+
+enum Stage {
+    Idle,
+    Opening,
+    OpeningTarget,
+    Reading,
+    Writing,
+    Closing
+};
+
+struct Slot
+{
+    int task = -1;
+    Stage stage = Idle;
+    int pending = 0;
+    bool failed = false;
+    bool abandoned = false;
+    bool targetCreated = false;
+
+    // Kept alive until the kernel is done with them
+    QByteArray source;
+    QByteArray target;
+    struct statx stx;
+
+    int in = -1;
+    int out = -1;
+    qint64 offset = 0;
+    int chunk = 0;
+    int written = 0;
+    std::vector<char> buffer;
+};
+
+// One thread, one ring. A slot advances a step each time one of its
+// operations completes, so at most two entries per slot are ever queued.
+class RingCopy
+{
+public:
+    RingCopy(Ring &ring, const QList<SmallFileCopy::Task> &tasks,
+             const SmallFileCopy::Progress &progress, int slotCount)
+        : ring(ring), tasks(tasks), progress(progress), slots(size_t(slotCount)),
+          reported(size_t(tasks.size()), false)
+    {
+    }
+
+    enum Outcome { Finished, Stopped, Broken };
+
+    Outcome run();
+
+    // Tasks that never reached the progress callback
+    QList<int> unfinished() const;
+
+private:
+    void start(int slotIndex, int task);
+    void handle(quint64 userData, int res);
+    void queue(int slotIndex, Op op, const std::function<void(io_uring_sqe *)> &fill);
+    void read(int slotIndex);
+    void write(int slotIndex);
+    void close(int slotIndex);
+    void complete(int slotIndex);
+
+    Ring &ring;
+    const QList<SmallFileCopy::Task> &tasks;
+    const SmallFileCopy::Progress &progress;
+    std::vector<Slot> slots;
+    std::vector<bool> reported;
+    int nextTask = 0;
+    int active = 0;
+    bool stopped = false;
+    bool broken = false;
+};
+
+RingCopy::Outcome RingCopy::run()
+{
+    for (size_t i = 0; i < slots.size() && nextTask < tasks.size(); ++i)
+        start(int(i), nextTask++);
+
+    while (active > 0) {
+        if (!ring.submit(1)) {
+            // The ring itself failed; nothing more will complete
+            broken = true;
+            break;
+        }
+        ring.drain([this](quint64 userData, int res) { handle(userData, res); });
+    }
+
+    if (broken) {
+        // Targets are left for the fallback to overwrite, so their names
+        // stay taken
+        for (Slot &slot : slots) {
+            if (slot.in >= 0)
+                ::close(slot.in);
+            if (slot.out >= 0)
+                ::close(slot.out);
+        }
+        return Broken;
+    }
+    return stopped ? Stopped : Finished;
+}
+
+QList<int> RingCopy::unfinished() const
+{
+    QList<int> result;
+    for (int i = 0; i < tasks.size(); ++i) {
+        if (!reported[size_t(i)])
+            result.append(i);
+    }
+    return result;
+}
+
+void RingCopy::queue(int slotIndex, Op op, const std::function<void(io_uring_sqe *)> &fill)
+{
+    io_uring_sqe *sqe = ring.nextSqe();
+    while (!sqe) {
+        ring.submit(0);
+        sqe = ring.nextSqe();
+    }
+    fill(sqe);
+    sqe->user_data = (quint64(slotIndex) << 8) | quint64(op);
+    ++slots[size_t(slotIndex)].pending;
+}
+
+void RingCopy::start(int slotIndex, int task)
+{
+    Slot &slot = slots[size_t(slotIndex)];
+    std::vector<char> buffer = std::move(slot.buffer);
+    slot = Slot();
+    slot.buffer = std::move(buffer);
+    slot.task = task;
+    slot.stage = Opening;
+    slot.source = QFile::encodeName(tasks.at(task).source);
+    slot.target = QFile::encodeName(tasks.at(task).target);
+    slot.buffer.resize(ReadBufferSize);
+    ++active;
+
+    // O_NONBLOCK so a FIFO cannot hang the open; regular files ignore it
+    queue(slotIndex, OpOpenSource, [&slot](io_uring_sqe *sqe) {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = quint64(quintptr(slot.source.constData()));
+        sqe->open_flags = O_RDONLY | O_CLOEXEC | O_NONBLOCK;
+    });
+    queue(slotIndex, OpStat, [&slot](io_uring_sqe *sqe) {
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = quint64(quintptr(slot.source.constData()));
+        sqe->len = STATX_MODE;
+        sqe->off = quint64(quintptr(&slot.stx));
+        sqe->statx_flags = AT_STATX_SYNC_AS_STAT;
+    });
+}
+
+void RingCopy::handle(quint64 userData, int res)
+{
+    const int slotIndex = int(userData >> 8);
+    const Op op = Op(userData & 0xff);
+    Slot &slot = slots[size_t(slotIndex)];
+    --slot.pending;
+
+    switch (op) {
+    case OpOpenSource:
+        if (res >= 0)
+            slot.in = res;
+        else
+            slot.failed = true;
+        break;
+    case OpStat:
+        if (res < 0 || !S_ISREG(slot.stx.stx_mode))
+            slot.failed = true;
+        break;
+    case OpOpenTarget:
+        if (res >= 0) {
+            slot.out = res;
+            slot.targetCreated = true;
+        } else {
+            slot.failed = true;
+        }
+        break;
+    case OpRead:
+        if (res < 0) {
+            slot.failed = true;
+        } else if (res == 0) {
+            close(slotIndex);   // end of file
+            return;
+        } else if (stopped) {
+            slot.abandoned = true;
+        } else {
+            slot.chunk = res;
+            slot.written = 0;
+            write(slotIndex);
+            return;
+        }
+        break;
+    case OpWrite:
+        if (res <= 0) {
+            slot.failed = true;
+        } else {
+            slot.written += res;
+            if (slot.written < slot.chunk) {
+                write(slotIndex);
+            } else {
+                slot.offset += slot.chunk;
+                if (stopped)
+                    slot.abandoned = true;
+                else
+                    read(slotIndex);
+            }
+            if (!slot.abandoned)
+                return;
+        }
+        break;
+    case OpCloseSource:
+        slot.in = -1;
+        break;
+    case OpCloseTarget:
+        slot.out = -1;
+        if (res < 0)
+            slot.failed = true;   // delayed write errors show up here
+        break;
+    }
+
+    if (slot.pending > 0)
+        return;
+
+    if (stopped)
+        slot.abandoned = true;
+
+    switch (slot.stage) {
+    case Opening:
+        if (slot.failed || slot.abandoned) {
+            close(slotIndex);
+            return;
+        }
+        slot.stage = OpeningTarget;
+        queue(slotIndex, OpOpenTarget, [&slot](io_uring_sqe *sqe) {
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = quint64(quintptr(slot.target.constData()));
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            sqe->len = slot.stx.stx_mode & 07777;
+        });
+        break;
+    case OpeningTarget:
+        if (slot.failed || slot.abandoned)
+            close(slotIndex);
+        else
+            read(slotIndex);
+        break;
+    case Reading:
+    case Writing:
+        close(slotIndex);
+        break;
+    case Closing:
+        complete(slotIndex);
+        break;
+    case Idle:
+        break;
+    }
+}
+
+void RingCopy::read(int slotIndex)
+{
+    Slot &slot = slots[size_t(slotIndex)];
+    slot.stage = Reading;
+    queue(slotIndex, OpRead, [&slot](io_uring_sqe *sqe) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = slot.in;
+        sqe->addr = quint64(quintptr(slot.buffer.data()));
+        sqe->len = unsigned(slot.buffer.size());
+        sqe->off = quint64(slot.offset);
+    });
+}
+
+void RingCopy::write(int slotIndex)
+{
+    Slot &slot = slots[size_t(slotIndex)];
+    slot.stage = Writing;
+    queue(slotIndex, OpWrite, [&slot](io_uring_sqe *sqe) {
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = slot.out;
+        sqe->addr = quint64(quintptr(slot.buffer.data() + slot.written));
+        sqe->len = unsigned(slot.chunk - slot.written);
+        sqe->off = quint64(slot.offset + slot.written);
+    });
+}
+
+void RingCopy::close(int slotIndex)
+{
+    Slot &slot = slots[size_t(slotIndex)];
+    slot.stage = Closing;
+    if (slot.in >= 0) {
+        queue(slotIndex, OpCloseSource, [&slot](io_uring_sqe *sqe) {
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = slot.in;
+        });
+    }
+    if (slot.out >= 0) {
+        queue(slotIndex, OpCloseTarget, [&slot](io_uring_sqe *sqe) {
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = slot.out;
+        });
+    }
+    if (slot.pending == 0)
+        complete(slotIndex);
+}
+
+void RingCopy::complete(int slotIndex)
+{
+    Slot &slot = slots[size_t(slotIndex)];
+    const bool ok = !slot.failed && !slot.abandoned;
+    if (!ok && slot.targetCreated)
+        ::unlink(slot.target.constData());
+
+    const int task = slot.task;
+    const qint64 bytes = slot.offset;
+    slot.stage = Idle;
+    slot.task = -1;
+    --active;
+
+    if (slot.abandoned || stopped)
+        return;
+    reported[size_t(task)] = true;
+    if (progress && !progress(task, ok, bytes)) {
+        stopped = true;
+        return;
+    }
+    if (nextTask < tasks.size())
+        start(slotIndex, nextTask++);
+}
+
+bool probeRing()
+{
+    Ring ring;
+    return ring.init(4)
+           && ring.supports({ IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+                              IORING_OP_WRITE, IORING_OP_CLOSE });
+}
+
+unsigned roundUpPow2(unsigned value)
+{
+    unsigned result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+#endif
+
+} // namespace
+
+SmallFileCopy::SmallFileCopy(int maxOpenFiles)
+    : maxOpenFiles(qMax(2, maxOpenFiles))
+{
+}
+
+bool SmallFileCopy::copy(const QList<Task> &tasks, const Progress &progress)
+{
+    if (tasks.isEmpty())
+        return true;
+
+#ifdef HAVE_IO_URING
+    if (ioUringAvailable()) {
+        const int slotCount = int(qMin<qsizetype>(maxOpenFiles / 2, tasks.size()));
+        auto ring = std::make_unique<Ring>();
+        if (ring->init(roundUpPow2(unsigned(slotCount) * 2))) {
+            used = IoUring;
+            RingCopy ringCopy(*ring, tasks, progress, slotCount);
+            const RingCopy::Outcome outcome = ringCopy.run();
+
+            // Closing the ring cancels whatever is still queued, before the
+            // slot buffers go away and before any thread touches the targets
+            ring.reset();
+
+            switch (outcome) {
+            case RingCopy::Finished:
+                return true;
+            case RingCopy::Stopped:
+                return false;
+            case RingCopy::Broken:
+                break;
+            }
+
+            // Whatever the ring did not finish goes through the threads,
+            // reported under its original index
+            const QList<int> remaining = ringCopy.unfinished();
+            QList<Task> rest;
+            for (int index : remaining)
+                rest.append(tasks.at(index));
+            used = ThreadPool;
+            return copyThreaded(rest, [&](int index, bool ok, qint64 bytes) {
+                return !progress || progress(remaining.at(index), ok, bytes);
+            });
+        }
+    }
+#endif
+
+    used = ThreadPool;
+    return copyThreaded(tasks, progress);
+}
+
+// Fallback: a few threads each copying whole files through FastCopy.
+// Results are handed back so the callback still runs on the calling thread.
+bool SmallFileCopy::copyThreaded(const QList<Task> &tasks, const Progress &progress)
+{
+    struct Result
+    {
+        int index;
+        bool ok;
+        qint64 bytes;
+    };
+
+    std::atomic<int> next { 0 };
+    std::atomic<bool> stop { false };
+    QMutex lock;
+    QWaitCondition ready;
+    QList<Result> results;
+
+    auto worker = [&]() {
+        for (;;) {
+            const int index = next.fetch_add(1);
+            if (index >= tasks.size() || stop.load())
+                return;
+
+            qint64 bytes = 0;
+            const bool ok = FastCopy::copyFile(tasks.at(index).source, tasks.at(index).target,
+                                               [&](qint64 n, FastCopy::Method) {
+                bytes += n;
+                return !stop.load();
+            });
+
+            QMutexLocker locker(&lock);
+            results.append({ index, ok, bytes });
+            ready.wakeOne();
+        }
+    };
+
+    const int threadCount = int(qMin<qsizetype>(
+        qMin(maxOpenFiles / 2, qBound(2, QThread::idealThreadCount() * 2, MaxThreads)),
+        tasks.size()));
+    std::vector<QThread *> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.push_back(QThread::create(worker));
+        threads.back()->start();
+    }
+
+    bool cancelled = false;
+    for (qsizetype finished = 0; finished < tasks.size() && !cancelled;) {
+        QList<Result> batch;
+        {
+            QMutexLocker locker(&lock);
+            while (results.isEmpty())
+                ready.wait(&lock);
+            batch.swap(results);
+        }
+        for (const Result &result : std::as_const(batch)) {
+            ++finished;
+            if (!cancelled && progress && !progress(result.index, result.ok, result.bytes)) {
+                cancelled = true;
+                stop = true;
+            }
+        }
+    }
+
+    for (QThread *thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+    return !cancelled;
+}
+
+QString SmallFileCopy::backendName(Backend backend)
+{
+    return backend == IoUring ? "io_uring" : "parallel";
+}
+
+bool SmallFileCopy::ioUringAvailable()
+{
+#ifdef HAVE_IO_URING
+    // Setup can fail for many reasons: old kernels, io_uring_disabled,
+    // seccomp in containers. Probing once is enough.
+    static const bool available = probeRing();
+    return available;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef SMALLFILECOPY_H
+#define SMALLFILECOPY_H
+
+#include <QString>
+#include <QList>
+
+#include <functional>
+
+// Copies many small files with lots of operations in flight.
+//
+// Small files are bound by syscall count and latency rather than bandwidth,
+// so copying them one after another leaves the disk idle most of the time.
+// On Linux the copier drives an io_uring: every slot walks one file through
+// open, statx, read, write and close, and all slots share one ring, so a
+// single thread keeps dozens of files moving. Where io_uring is missing or
+// disabled, a few threads copy through FastCopy instead, and so does
+// whatever is left if the ring fails part way.
+//
+// Target folders must already exist.
+class SmallFileCopy
+{
+public:
+    struct Task
+    {
+        QString source;
+        QString target;
+    };
+
+    enum Backend {
+        IoUring,
+        ThreadPool
+    };
+
+    // Files up to this size are worth sending through the pipeline
+    static constexpr qint64 SmallFileLimit = 256 * 1024;
+
+    // Called on the calling thread once per finished task. Returning false
+    // stops the copy; files still in flight are abandoned and removed.
+    using Progress = std::function<bool(int index, bool ok, qint64 bytes)>;
+
+    // Each file in flight holds two descriptors, so this also bounds how
+    // many files are copied at once.
+    explicit SmallFileCopy(int maxOpenFiles = 64);
+
+    // Every task gets exactly one progress call unless the copy is stopped.
+    // Returns false when stopped through the progress callback.
+    bool copy(const QList<Task> &tasks, const Progress &progress);
+
+    Backend backend() const { return used; }
+    static QString backendName(Backend backend);
+
+    static bool ioUringAvailable();
+
+private:
+    bool copyThreaded(const QList<Task> &tasks, const Progress &progress);
+
+    int maxOpenFiles;
+    Backend used = ThreadPool;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "stallwatchdog.h"
+#include "perftrace.h"
+
+#include <QDebug>
+#include <QTimer>
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+const int HeartbeatMs = 25;
+
+QString describeRunning()
+{
+    const QStringList scopes = PerfTrace::running();
+    const QStringList background = PerfTrace::inFlight();
+
+    QString text = scopes.isEmpty() ? QString("no traced operation")
+                                    : scopes.join(" > ");
+    if (!background.isEmpty())
+        text += "; in flight: " + background.join(", ");
+    return text;
+}
+
+} // namespace
+
+StallWatchdog::StallWatchdog(QObject *parent)
+    : QObject(parent)
+{
+    lastBeatNs = PerfTrace::now();
+
+    heartbeat = new QTimer(this);
+    heartbeat->setInterval(HeartbeatMs);
+    connect(heartbeat, &QTimer::timeout, this, &StallWatchdog::beat);
+    heartbeat->start();
+
+    monitor = std::thread([this]() { watch(); });
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    {
+        std::lock_guard<std::mutex> locker(stopLock);
+        stopping = true;
+    }
+    stopSignal.notify_all();
+    monitor.join();
+}
+
+void StallWatchdog::beat()
+{
+    const qint64 now = PerfTrace::now();
+    const qint64 last = lastBeatNs.exchange(now);
+    const qint64 lateMs = (now - last) / 1000000 - HeartbeatMs;
+
+    QString running;
+    bool seen;
+    {
+        QMutexLocker locker(&snapshotLock);
+        seen = caught;
+        running = snapshot;
+        caught = false;
+    }
+
+    // Short stalls can slip between two checks of the monitor
+    if (!seen && lateMs < thresholdMs)
+        return;
+    if (!seen)
+        running = "ended before it was caught";
+
+    PerfTrace::complete("GUI stall", running, now - last);
+    emit stalled(lateMs, running);
+}
+
+void StallWatchdog::watch()
+{
+    std::unique_lock<std::mutex> locker(stopLock);
+    for (;;) {
+        const int threshold = thresholdMs;
+        const auto step = std::chrono::milliseconds(std::max(10, threshold / 4));
+        if (stopSignal.wait_for(locker, step, [this]() { return stopping; }))
+            return;
+
+        const qint64 blockedMs = (PerfTrace::now() - lastBeatNs) / 1000000 - HeartbeatMs;
+        if (blockedMs < threshold)
+            continue;
+
+        // Checked again under the lock, in case the beat came meanwhile
+        QMutexLocker snapshotLocker(&snapshotLock);
+        if (caught || (PerfTrace::now() - lastBeatNs) / 1000000 - HeartbeatMs < threshold)
+            continue;
+        caught = true;
+        snapshot = describeRunning();
+        PerfTrace::instant("GUI blocked", snapshot);
+        qWarning("GUI thread blocked for %lld ms in %s", blockedMs, qPrintable(snapshot));
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QObject>
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class QTimer;
+
+// Notices when the GUI thread stops processing events.
+//
+// A timer on the GUI thread ticks a heartbeat. A monitor thread checks
+// it, and once the heartbeat is older than the threshold it notes what
+// the GUI thread is in the middle of (its open PerfScopes, and the async
+// work in flight) and logs a warning, while the hang is still going on.
+// When the event loop turns again, the whole stall goes into the trace
+// with its length and what was running, and stalled() is emitted.
+class StallWatchdog : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StallWatchdog(QObject *parent = nullptr);
+    ~StallWatchdog() override;
+
+    void setThreshold(int ms) { thresholdMs = ms; }
+    int threshold() const { return thresholdMs; }
+
+signals:
+    void stalled(qint64 elapsedMs, const QString &running);
+
+private:
+    void beat();
+    void watch();
+
+    QTimer *heartbeat;
+    std::atomic<qint64> lastBeatNs { 0 };
+    std::atomic<int> thresholdMs { 200 };
+
+    // What the monitor saw during the current stall, if it caught one
+    QMutex snapshotLock;
+    QString snapshot;
+    bool caught = false;
+
+    std::thread monitor;
+    std::mutex stopLock;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "statuscounter.h"
+
+#include <QFileSystemModel>
+#include <QItemSelectionModel>
+#include <QSortFilterProxyModel>
+#include <QTimer>
+
+namespace {
+
+const int UpdateIntervalMs = 100;
+
+} // namespace
+
+StatusCounter::StatusCounter(QFileSystemModel *model, QObject *parent)
+    : QObject(parent), model(model), updateTimer(new QTimer(this))
+{
+    updateTimer->setSingleShot(true);
+    updateTimer->setInterval(UpdateIntervalMs);
+    connect(updateTimer, &QTimer::timeout, this, &StatusCounter::countsChanged);
+
+    connect(model, &QAbstractItemModel::rowsInserted, this,
+            [this](const QModelIndex &parent, int first, int last) {
+                if (root.isValid() && parent == root)
+                    addRows(first, last);
+            });
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+            [this](const QModelIndex &parent, int first, int last) {
+                if (root.isValid() && parent == root)
+                    removeRows(first, last);
+            });
+    connect(model, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                if (root.isValid() && topLeft.parent() == root)
+                    updateRows(topLeft.row(), bottomRight.row());
+            });
+    connect(model, &QAbstractItemModel::modelReset, this, [this]() {
+        root = model->index(rootPath);
+        recount();
+    });
+}
+
+void StatusCounter::setRootPath(const QString &path)
+{
+    const QModelIndex index = model->index(path);
+    if (path == rootPath && index == root)
+        return;
+
+    rootPath = path;
+    root = index;
+    recount();
+}
+
+void StatusCounter::setSelectionModel(QItemSelectionModel *selection,
+                                      QSortFilterProxyModel *proxyModel)
+{
+    disconnect(selectionConnection);
+    selectionModel = selection;
+    proxy = proxyModel;
+
+    if (selection) {
+        selectionConnection = connect(selection, &QItemSelectionModel::selectionChanged, this,
+                                      [this](const QItemSelection &selected,
+                                             const QItemSelection &deselected) {
+                                          select(deselected, false);
+                                          select(selected, true);
+                                          scheduleUpdate();
+                                      });
+    }
+    recount();
+}
+
+// Only a full count when the folder or the model changes under us;
+// everything else is incremental.
+void StatusCounter::recount()
+{
+    current = StatusCounts();
+    fileSizes.clear();
+    selectedSizes.clear();
+
+    if (root.isValid()) {
+        const int rows = model->rowCount(root);
+        if (rows > 0)
+            addRows(0, rows - 1);
+    }
+    if (selectionModel && proxy)
+        select(selectionModel->selection(), true);
+
+    scheduleUpdate();
+}
+
+void StatusCounter::addRows(int first, int last)
+{
+    for (int row = first; row <= last; ++row) {
+        const QModelIndex index = model->index(row, 0, root);
+        ++current.items;
+        if (model->isDir(index)) {
+            ++current.folders;
+        } else {
+            const qint64 size = model->size(index);
+            ++current.files;
+            current.bytes += size;
+            fileSizes.insert(model->fileName(index), size);
+        }
+    }
+    scheduleUpdate();
+}
+
+void StatusCounter::removeRows(int first, int last)
+{
+    for (int row = first; row <= last; ++row) {
+        const QModelIndex index = model->index(row, 0, root);
+        const QString name = model->fileName(index);
+        --current.items;
+
+        auto file = fileSizes.find(name);
+        if (file != fileSizes.end()) {
+            --current.files;
+            current.bytes -= file.value();
+            fileSizes.erase(file);
+        } else {
+            --current.folders;
+        }
+
+        auto selected = selectedSizes.find(name);
+        if (selected != selectedSizes.end()) {
+            --current.selected;
+            current.selectedBytes -= selected.value();
+            selectedSizes.erase(selected);
+        }
+    }
+    scheduleUpdate();
+}
+
+void StatusCounter::updateRows(int first, int last)
+{
+    for (int row = first; row <= last; ++row) {
+        const QModelIndex index = model->index(row, 0, root);
+        const QString name = model->fileName(index);
+
+        auto file = fileSizes.find(name);
+        if (file == fileSizes.end())
+            continue;
+
+        const qint64 size = model->size(index);
+        current.bytes += size - file.value();
+        file.value() = size;
+
+        auto selected = selectedSizes.find(name);
+        if (selected != selectedSizes.end()) {
+            current.selectedBytes += size - selected.value();
+            selected.value() = size;
+        }
+    }
+    scheduleUpdate();
+}
+
+void StatusCounter::select(const QItemSelection &selection, bool selected)
+{
+    if (!proxy || !root.isValid())
+        return;
+
+    for (const QItemSelectionRange &range : selection) {
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            const QModelIndex index = proxy->mapToSource(range.model()->index(row, 0, range.parent()));
+            if (index.parent() != root)
+                continue;
+
+            const QString name = model->fileName(index);
+            if (selected) {
+                if (selectedSizes.contains(name))
+                    continue;
+                const qint64 size = model->isDir(index) ? 0 : model->size(index);
+                selectedSizes.insert(name, size);
+                ++current.selected;
+                current.selectedBytes += size;
+            } else {
+                auto it = selectedSizes.find(name);
+                if (it == selectedSizes.end())
+                    continue;
+                --current.selected;
+                current.selectedBytes -= it.value();
+                selectedSizes.erase(it);
+            }
+        }
+    }
+}
+
+void StatusCounter::scheduleUpdate()
+{
+    if (!updateTimer->isActive())
+        updateTimer->start();
+}
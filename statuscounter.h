@@ -0,0 +1,73 @@
+#ifndef STATUSCOUNTER_H
+#define STATUSCOUNTER_H
+
+#include <QObject>
+#include <QHash>
+#include <QPersistentModelIndex>
+#include <QPointer>
+#include <QItemSelection>
+
+class QFileSystemModel;
+class QItemSelectionModel;
+class QSortFilterProxyModel;
+class QTimer;
+
+struct StatusCounts
+{
+    int items = 0;
+    int files = 0;
+    int folders = 0;
+    qint64 bytes = 0;
+    int selected = 0;
+    qint64 selectedBytes = 0;
+};
+
+// Keeps the status bar numbers for one folder of a QFileSystemModel.
+//
+// Counts follow the model's row signals as it loads and as the folder
+// changes, so the folder is never read a second time just to count it.
+// Selection totals follow the view's selectionChanged the same way.
+// countsChanged() is coalesced, so a folder loading in big batches
+// updates the status bar a few times a second at most.
+class StatusCounter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StatusCounter(QFileSystemModel *model, QObject *parent = nullptr);
+
+    void setRootPath(const QString &path);
+
+    // The selection of a view showing model through proxy; null to stop
+    void setSelectionModel(QItemSelectionModel *selection, QSortFilterProxyModel *proxy);
+
+    const StatusCounts &counts() const { return current; }
+
+signals:
+    void countsChanged();
+
+private:
+    void recount();
+    void addRows(int first, int last);
+    void removeRows(int first, int last);
+    void updateRows(int first, int last);
+    void select(const QItemSelection &selection, bool selected);
+    void scheduleUpdate();
+
+    QFileSystemModel *model;
+    QPointer<QItemSelectionModel> selectionModel;
+    QSortFilterProxyModel *proxy = nullptr;
+    QMetaObject::Connection selectionConnection;
+
+    QString rootPath;
+    QPersistentModelIndex root;
+    StatusCounts current;
+
+    // Last known size of every file and of every selected row, by name,
+    // so changes and removals can be subtracted exactly.
+    QHash<QString, qint64> fileSizes;
+    QHash<QString, qint64> selectedSizes;
+
+    QTimer *updateTimer;
+};
+
+#endif
@@ -0,0 +1,11 @@
+QT += testlib
+QT -= gui
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = tst_contentscanner
+
+include(../../core.pri)
+
+SOURCES += \
+    tst_contentscanner.cpp
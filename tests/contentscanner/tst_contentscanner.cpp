@@ -0,0 +1,106 @@
+#include "contentscanner.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+// The scanner looks for a literal taken from the query before it runs the
+// regular expression, so a literal the pattern does not actually require
+// makes real matches disappear. Each row is checked against the regex too.
+class TestContentScanner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void matches_data();
+    void matches();
+
+private:
+    bool scan(const QString &query, const QByteArray &content);
+
+    QTemporaryDir dir;
+    int files = 0;
+};
+
+void TestContentScanner::initTestCase()
+{
+    QVERIFY(dir.isValid());
+}
+
+bool TestContentScanner::scan(const QString &query, const QByteArray &content)
+{
+    QFile file(dir.filePath(QString::number(files++)));
+    if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size())
+        return false;
+    file.close();
+
+    bool found = false;
+    ContentScanner scanner(query);
+    scanner.scanFile(file.fileName(), [&](const ContentMatch &) {
+        found = true;
+        return false;
+    });
+    return found;
+}
+
+void TestContentScanner::matches_data()
+{
+    QTest::addColumn<QString>("query");
+    QTest::addColumn<QByteArray>("content");
+    QTest::addColumn<bool>("expected");
+
+    // Quantifiers
+    QTest::newRow("braces") << "/a{2,3}b/" << QByteArray("xaab\n") << true;
+    QTest::newRow("braces too few") << "/a{2,3}b/" << QByteArray("xab\n") << false;
+    QTest::newRow("braces exact") << "/ab{2}c/" << QByteArray("abbc\n") << true;
+    QTest::newRow("braces zero") << "/x{0,1}yz/" << QByteArray("yz\n") << true;
+    QTest::newRow("class braces") << "/[0-9]{3}-[0-9]{4}/" << QByteArray("555-1234\n") << true;
+    QTest::newRow("optional") << "/colou?r/" << QByteArray("color\n") << true;
+    QTest::newRow("star") << "/ab*c/" << QByteArray("ac\n") << true;
+    QTest::newRow("plus") << "/ab+c/" << QByteArray("abbbc\n") << true;
+    QTest::newRow("lazy") << "/ab??c/" << QByteArray("ac\n") << true;
+
+    // Alternation
+    QTest::newRow("alternation") << "/cat|dog/" << QByteArray("hotdog\n") << true;
+    QTest::newRow("group alternation") << "/(foo|bar)baz/" << QByteArray("barbaz\n") << true;
+    QTest::newRow("alternation miss") << "/cat|dog/" << QByteArray("bird\n") << false;
+
+    // Escapes
+    QTest::newRow("escaped dot") << "/foo\\.bar/" << QByteArray("foo.bar\n") << true;
+    QTest::newRow("escaped dot miss") << "/foo\\.bar/" << QByteArray("fooxbar\n") << false;
+    QTest::newRow("escaped optional") << "/ab\\.?c/" << QByteArray("abc\n") << true;
+    QTest::newRow("hex") << "/\\x41bc/" << QByteArray("abc\n") << true;
+    QTest::newRow("hex braces") << "/\\x{41}bc/" << QByteArray("abc\n") << true;
+    QTest::newRow("digits") << "/\\d{3}x/" << QByteArray("123x\n") << true;
+    QTest::newRow("word boundary") << "/\\bword\\b/" << QByteArray("a word here\n") << true;
+    QTest::newRow("property") << "/\\pLxyz/" << QByteArray("qxyz\n") << true;
+    QTest::newRow("backreference") << "/(a)\\1bc/" << QByteArray("aabc\n") << true;
+    QTest::newRow("quoted") << "/\\Qa+b\\E/" << QByteArray("a+b\n") << true;
+
+    // Classes and modes
+    QTest::newRow("bracket member") << "/[]x]yz/" << QByteArray("]yz\n") << true;
+    QTest::newRow("escaped bracket") << "/[\\]]yz/" << QByteArray("]yz\n") << true;
+    QTest::newRow("extended") << "/(?x) a b c /" << QByteArray("abc\n") << true;
+
+    // Plain text
+    QTest::newRow("plain") << "hello world" << QByteArray("Hello World\n") << true;
+    QTest::newRow("plain braces") << "a{2}" << QByteArray("a{2}\n") << true;
+}
+
+void TestContentScanner::matches()
+{
+    QFETCH(QString, query);
+    QFETCH(QByteArray, content);
+    QFETCH(bool, expected);
+
+    if (query.startsWith('/')) {
+        const QRegularExpression regex(query.mid(1, query.size() - 2),
+                                       QRegularExpression::CaseInsensitiveOption);
+        QVERIFY(regex.isValid());
+        QCOMPARE(regex.match(QString::fromUtf8(content)).hasMatch(), expected);
+    }
+    QCOMPARE(scan(query, content), expected);
+}
+
+QTEST_GUILESS_MAIN(TestContentScanner)
+#include "tst_contentscanner.moc"
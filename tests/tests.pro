@@ -0,0 +1,5 @@
+# Unit tests; run with "qmake tests/tests.pro && make check"
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    contentscanner
@@ -0,0 +1,226 @@
+#include "thumbnailer.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QUrl>
+
+#include <algorithm>
+
+namespace {
+
+const int ThumbnailSize = 128;                 // the spec's "normal" size
+const qint64 MaxSourceBytes = 200 * 1024 * 1024;
+const int MemoryCacheKb = 96 * 1024;
+const qint64 FailureRecheckMs = 10000;
+
+QString cacheRoot()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + "/thumbnails";
+}
+
+QString cacheDir()
+{
+    return cacheRoot() + "/normal";
+}
+
+QString cacheFile(const QString &uri)
+{
+    const QByteArray hash = QCryptographicHash::hash(uri.toUtf8(), QCryptographicHash::Md5);
+    return cacheDir() + "/" + QString::fromLatin1(hash.toHex()) + ".png";
+}
+
+QImage loadCached(const QString &file, const QString &uri, qint64 mtime)
+{
+    QImageReader reader(file, "png");
+    if (!reader.canRead())
+        return QImage();
+    if (reader.text("Thumb::URI") != uri
+        || reader.text("Thumb::MTime").toLongLong() != mtime)
+        return QImage();
+    return reader.read();
+}
+
+// The spec wants the cache private to the user and written atomically
+void saveCached(QImage image, const QString &file, const QString &uri, qint64 mtime,
+                qint64 size)
+{
+    const QString dir = cacheDir();
+    if (!QDir().mkpath(dir))
+        return;
+    QFile::setPermissions(cacheRoot(), QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    QFile::setPermissions(dir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    image.setText("Thumb::URI", uri);
+    image.setText("Thumb::MTime", QString::number(mtime));
+    image.setText("Thumb::Size", QString::number(size));
+    image.setText("Software", "File Explorer");
+
+    QSaveFile out(file);
+    if (!out.open(QIODevice::WriteOnly))
+        return;
+    out.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    if (image.save(&out, "png"))
+        out.commit();
+}
+
+QImage makeThumbnail(const QFileInfo &info, qint64 mtime)
+{
+    const QString path = info.filePath();
+    if (!info.isFile() || info.size() > MaxSourceBytes)
+        return QImage();
+
+    const QString uri = QUrl::fromLocalFile(info.absoluteFilePath()).toString(QUrl::FullyEncoded);
+    const QString file = cacheFile(uri);
+
+    QImage image = loadCached(file, uri, mtime);
+    if (!image.isNull())
+        return image;
+
+    // Let the decoder scale while decoding; JPEG does this far cheaper
+    // than decoding the full image and shrinking it afterwards
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    const QSize full = reader.size();
+    if (full.isValid() && (full.width() > ThumbnailSize || full.height() > ThumbnailSize))
+        reader.setScaledSize(full.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio));
+
+    image = reader.read();
+    if (image.isNull())
+        return QImage();
+    if (image.width() > ThumbnailSize || image.height() > ThumbnailSize)
+        image = image.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio,
+                             Qt::SmoothTransformation);
+
+    saveCached(image, file, uri, mtime, info.size());
+    return image;
+}
+
+} // namespace
+
+Thumbnailer::Thumbnailer(QObject *parent)
+    : QObject(parent)
+{
+    // Leave a core for the GUI thread so scrolling stays smooth
+    pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+    cache.setMaxCost(MemoryCacheKb);
+    clock.start();
+}
+
+Thumbnailer::~Thumbnailer()
+{
+    stopping = true;
+    {
+        QMutexLocker locker(&mutex);
+        queue.clear();
+    }
+    pool.waitForDone();
+}
+
+bool Thumbnailer::canThumbnail(const QString &path)
+{
+    static const QSet<QString> suffixes = []() {
+        QSet<QString> result;
+        const QList<QByteArray> formats = QImageReader::supportedImageFormats();
+        for (const QByteArray &format : formats)
+            result.insert(QString::fromLatin1(format).toLower());
+        return result;
+    }();
+
+    // Never thumbnail the thumbnails
+    static const QString ownCache = cacheRoot() + "/";
+    if (path.startsWith(ownCache))
+        return false;
+
+    return suffixes.contains(QFileInfo(path).suffix().toLower());
+}
+
+QPixmap Thumbnailer::thumbnail(const QString &path) const
+{
+    const QPixmap *pixmap = cache.object(path);
+    return pixmap ? *pixmap : QPixmap();
+}
+
+void Thumbnailer::setWanted(const QStringList &paths)
+{
+    QMutexLocker locker(&mutex);
+
+    queue.clear();
+    const qint64 now = clock.elapsed();
+    for (const QString &path : paths) {
+        if (cache.contains(path) || running.contains(path) || !canThumbnail(path))
+            continue;
+        const auto failure = failed.constFind(path);
+        if (failure != failed.cend() && now - failure->checkedMs < FailureRecheckMs)
+            continue;
+        queue.push_back(path);
+    }
+
+    while (workers < pool.maxThreadCount() && workers < int(queue.size())) {
+        ++workers;
+        pool.start([this]() { work(); });
+    }
+}
+
+void Thumbnailer::clear()
+{
+    QMutexLocker locker(&mutex);
+    queue.clear();
+    cache.clear();
+    failed.clear();
+}
+
+// Each worker keeps taking the front of the queue, so a new setWanted()
+// reorders work that has not started yet
+void Thumbnailer::work()
+{
+    for (;;) {
+        QString path;
+        qint64 failedMtime = -1;
+        {
+            QMutexLocker locker(&mutex);
+            if (stopping || queue.empty()) {
+                --workers;
+                return;
+            }
+            path = queue.front();
+            queue.pop_front();
+            running.insert(path);
+            const auto failure = failed.constFind(path);
+            if (failure != failed.cend())
+                failedMtime = failure->mtime;
+        }
+
+        // The same file that failed before fails again without a decode
+        const QFileInfo info(path);
+        const qint64 mtime = info.lastModified().toSecsSinceEpoch();
+        const QImage image = mtime == failedMtime ? QImage() : makeThumbnail(info, mtime);
+        QMetaObject::invokeMethod(this, [this, path, image, mtime]() {
+            deliver(path, image, mtime);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void Thumbnailer::deliver(const QString &path, const QImage &image, qint64 mtime)
+{
+    {
+        QMutexLocker locker(&mutex);
+        running.remove(path);
+        if (image.isNull()) {
+            failed.insert(path, { mtime, clock.elapsed() });
+            return;
+        }
+        failed.remove(path);
+    }
+
+    QPixmap *pixmap = new QPixmap(QPixmap::fromImage(image));
+    const int costKb = std::max(1, int(qint64(image.width()) * image.height() * 4 / 1024));
+    cache.insert(path, pixmap, costKb);
+    emit thumbnailReady(path);
+}
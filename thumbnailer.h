@@ -0,0 +1,76 @@
+#ifndef THUMBNAILER_H
+#define THUMBNAILER_H
+
+#include <QObject>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QPixmap>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <deque>
+
+// Image thumbnails for the thumbnail view.
+//
+// Images are decoded and scaled on a small worker pool. The view says
+// which files it wants through setWanted(), visible ones first; the
+// queue is replaced each time, so files scrolled out of view are dropped
+// before they are decoded. Decodes already running are allowed to
+// finish and land in the cache.
+//
+// Thumbnails go to the shared freedesktop cache (~/.cache/thumbnails/
+// normal), keyed by the MD5 of the file URI and checked against the
+// file's mtime, so other desktop apps reuse ours and we reuse theirs.
+// Finished ones are also kept in memory for painting.
+//
+// A file that could not be read is remembered with its mtime. It is
+// looked at again every few seconds while wanted, and decoded again
+// only once its mtime moved, e.g. when a download finishes.
+class Thumbnailer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Thumbnailer(QObject *parent = nullptr);
+    ~Thumbnailer() override;
+
+    // True for files with an image suffix Qt can read
+    static bool canThumbnail(const QString &path);
+
+    // From memory only; a null pixmap if it is not ready yet
+    QPixmap thumbnail(const QString &path) const;
+
+    // Files to make thumbnails for, most important first
+    void setWanted(const QStringList &paths);
+
+    void clear();
+
+signals:
+    void thumbnailReady(const QString &path);
+
+private:
+    struct Failure
+    {
+        qint64 mtime = 0;         // of the file that failed
+        qint64 checkedMs = 0;     // when that was last confirmed
+    };
+
+    void work();
+    void deliver(const QString &path, const QImage &image, qint64 mtime);
+
+    QThreadPool pool;
+    QMutex mutex;                 // guards queue, running, workers and failed
+    std::deque<QString> queue;
+    QSet<QString> running;
+    int workers = 0;
+    std::atomic<bool> stopping { false };
+
+    QCache<QString, QPixmap> cache;
+    QHash<QString, Failure> failed;
+    QElapsedTimer clock;
+};
+
+#endif
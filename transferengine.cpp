@@ -0,0 +1,879 @@
+#include "transferengine.h"
+#include "parallelwalker.h"
+#include "fastcopy.h"
+#include "smallfilecopy.h"
+#include "trash.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QSet>
+#include <QMap>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+
+const int ProgressIntervalMs = 100;
+const int DefaultConcurrentJobs = 2;
+const int ConcurrentDeleteJobs = 2;
+const int MinBatchedFiles = 16;
+const int MaxOpenFiles = 64;     // per job, for the small file batch
+const int MaxReportedFailures = 100;
+const int MaxClaimAttempts = 100;
+
+bool isUnder(const QString &path, const QString &dir)
+{
+    return path == dir || path.startsWith(dir.endsWith('/') ? dir : dir + "/");
+}
+
+// The link text exactly as stored, so relative links stay relative
+QString linkText(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    QByteArray buffer(4096, Qt::Uninitialized);
+    const ssize_t n = ::readlink(QFile::encodeName(path).constData(),
+                                 buffer.data(), size_t(buffer.size()));
+    if (n >= 0 && n < buffer.size())
+        return QFile::decodeName(buffer.left(n));
+#endif
+    return QFileInfo(path).symLinkTarget();
+}
+
+bool createLink(const QString &text, const QString &target)
+{
+#ifdef Q_OS_LINUX
+    return ::symlink(QFile::encodeName(text).constData(),
+                     QFile::encodeName(target).constData()) == 0;
+#else
+    return QFile::link(text, target);
+#endif
+}
+
+} // namespace
+
+//-------------------------------------------
+// Shared state
+//-------------------------------------------
+
+// Token bucket shared by every running job. Allows up to one second of
+// burst, then makes callers sleep until the average is back under the limit.
+class TransferThrottle
+{
+public:
+    TransferThrottle() { clock.start(); }
+
+    void setLimit(qint64 bytesPerSecond) { rate.store(bytesPerSecond); }
+    qint64 limit() const { return rate.load(); }
+
+    qint64 reserve(qint64 bytes)
+    {
+        const qint64 bps = rate.load();
+        if (bps <= 0)
+            return 0;
+
+        QMutexLocker locker(&lock);
+        const qint64 now = clock.elapsed();
+        tokens = qMin(double(bps), tokens + double(now - last) * bps / 1000.0);
+        last = now;
+        tokens -= double(bytes);
+        return tokens < 0 ? qint64(-tokens * 1000.0 / bps) : 0;
+    }
+
+private:
+    std::atomic<qint64> rate { 0 };
+    QMutex lock;
+    QElapsedTimer clock;
+    qint64 last = 0;
+    double tokens = 0;
+};
+
+class TransferJob
+{
+public:
+    int id = 0;
+    TransferEngine::JobKind kind = TransferEngine::Copy;
+    QStringList sources;
+    QString destinationDir;
+
+    std::atomic<bool> cancelled { false };
+    std::atomic<bool> paused { false };
+    QMutex pauseLock;
+    QWaitCondition resumed;
+
+    // Returns the time spent paused, so it can be left out of throughput
+    qint64 waitWhilePaused()
+    {
+        if (!paused.load())
+            return 0;
+
+        QElapsedTimer t;
+        t.start();
+        QMutexLocker locker(&pauseLock);
+        while (paused.load() && !cancelled.load())
+            resumed.wait(&pauseLock, 200);
+        return t.elapsed();
+    }
+};
+
+namespace {
+
+// Executes one job on a pool thread.
+class TransferRunner
+{
+public:
+    TransferRunner(TransferEngine *engine, TransferJob &job, TransferThrottle &throttle)
+        : engine(engine), job(job), throttle(throttle)
+    {
+    }
+
+    bool run(QStringList &errors);
+
+private:
+    enum ItemType { DirItem, FileItem, LinkItem };
+
+    struct Item
+    {
+        QString source;
+        QString target;
+        ItemType type = FileItem;
+        qint64 size = 0;
+        int top = 0;     // index of the selected item it belongs to
+        bool isTop = false;
+    };
+
+    void transfer(QStringList &errors);
+    void trash(QStringList &errors);
+    void purge(QStringList &errors);
+    QStringList moveByRename(const QStringList &sources, QStringList &errors);
+    void plan(const QStringList &sources, QStringList &errors);
+    bool claimTop(int top);
+    bool copyItem(const Item &item);
+    QSet<int> copySmallFiles(const QSet<int> &failedTops,
+                             const std::function<void(const Item &)> &fail);
+    bool verifyTop(int top) const;
+    bool removeTop(int top);
+    bool copyFile(const QString &source, const QString &target);
+    void checkPause();
+    void throttleFor(qint64 bytes);
+    void report(bool force = false);
+
+    TransferEngine *engine;
+    TransferJob &job;
+    TransferThrottle &throttle;
+
+    QList<Item> items;
+    QStringList tops;
+    QList<int> topItems;     // index in items of each selected item
+    TransferProgress progress;
+    QElapsedTimer clock;
+    QElapsedTimer lastReport;
+    qint64 pausedMs = 0;
+};
+
+// Cut within one file system: a rename per selected item, however large.
+// Returns the sources that still need copying.
+QStringList TransferRunner::moveByRename(const QStringList &sources, QStringList &errors)
+{
+    const QString dest = QDir::cleanPath(job.destinationDir);
+    QStringList remaining;
+
+    for (const QString &source : sources) {
+        if (job.cancelled.load())
+            break;
+
+        QFileInfo info(source);
+        const bool isFolder = info.isDir() && !info.isSymLink();
+        if (!FastCopy::sameFileSystem(source, dest)
+            || (isFolder && isUnder(dest, QDir::cleanPath(source)))) {
+            remaining.append(source);   // plan() copies it or reports the error
+            continue;
+        }
+
+        ++progress.filesTotal;
+        progress.currentFile = source;
+
+        // Already where it should go
+        if (QDir::cleanPath(info.absolutePath()) == dest) {
+            ++progress.filesDone;
+            continue;
+        }
+
+        QString target = dest + "/" + info.fileName();
+        FastCopy::RenameResult result = FastCopy::renameNoReplace(source, target);
+
+        // Name taken: pick a free one, as a copy would. Retried in case
+        // another process grabs that one first.
+        for (int attempt = 0; result == FastCopy::TargetExists && attempt < 3; ++attempt) {
+            target = dest + "/" + TransferEngine::uniqueName(dest, info.fileName());
+            result = FastCopy::renameNoReplace(source, target);
+        }
+
+        switch (result) {
+        case FastCopy::Renamed:
+            ++progress.filesDone;
+            if (!progress.methods.contains(FastCopy::methodName(FastCopy::Rename)))
+                progress.methods.append(FastCopy::methodName(FastCopy::Rename));
+            break;
+        case FastCopy::CrossDevice:     // e.g. two bind mounts of one device
+            --progress.filesTotal;
+            remaining.append(source);
+            break;
+        case FastCopy::TargetExists:
+        case FastCopy::RenameFailed:
+            errors.append("Unable to move: " + info.fileName());
+            break;
+        }
+        report();
+    }
+
+    return remaining;
+}
+
+void TransferRunner::plan(const QStringList &sources, QStringList &errors)
+{
+    const QString dest = QDir::cleanPath(job.destinationDir);
+    QMutex itemsLock;
+
+    for (const QString &source : sources) {
+        QFileInfo info(source);
+        if (!info.exists() && !info.isSymLink()) {
+            errors.append("Source no longer exists: " + source);
+            continue;
+        }
+
+        if (info.isDir() && !info.isSymLink() && isUnder(dest, QDir::cleanPath(source))) {
+            errors.append("Cannot paste a folder into itself: " + info.fileName());
+            continue;
+        }
+
+        // The name actually used is claimed at copy time, see claimTop()
+        const QString target = dest + "/" + info.fileName();
+
+        const int top = tops.size();
+        tops.append(source);
+        topItems.append(int(items.size()));
+
+        if (info.isSymLink()) {
+            items.append({ source, target, LinkItem, 0, top, true });
+            continue;
+        }
+        if (!info.isDir()) {
+            items.append({ source, target, FileItem, info.size(), top, true });
+            continue;
+        }
+
+        items.append({ source, target, DirItem, 0, top, true });
+
+        // A folder's entry is always recorded before anything inside it,
+        // because the walker only reads a folder after visiting it.
+        const QString srcRoot = QDir::cleanPath(info.absoluteFilePath());
+        ParallelWalker walker;
+        walker.setFilters(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files | QDir::Hidden);
+        walker.setCancelCheck([this]() { return job.cancelled.load(); });
+        walker.walk({ srcRoot }, [&](const WalkEntry &entry) {
+            Item item;
+            item.source = entry.filePath();
+            item.target = target + item.source.mid(srcRoot.size());
+            item.top = top;
+            if (entry.isSymLink)
+                item.type = LinkItem;
+            else if (entry.isDir)
+                item.type = DirItem;
+            else
+                item.size = QFileInfo(item.source).size();
+
+            QMutexLocker locker(&itemsLock);
+            items.append(item);
+            return true;
+        });
+    }
+
+    for (const Item &item : std::as_const(items)) {
+        if (item.type != DirItem) {
+            progress.bytesTotal += item.size;
+            ++progress.filesTotal;
+        }
+    }
+}
+
+bool TransferRunner::run(QStringList &errors)
+{
+    clock.start();
+    lastReport.start();
+
+    switch (job.kind) {
+    case TransferEngine::Copy:
+    case TransferEngine::Move:
+        transfer(errors);
+        break;
+    case TransferEngine::Trash:
+        trash(errors);
+        break;
+    case TransferEngine::Delete:
+        purge(errors);
+        break;
+    }
+
+    report(true);
+    return errors.isEmpty() && !job.cancelled.load();
+}
+
+void TransferRunner::transfer(QStringList &errors)
+{
+    QStringList sources = job.sources;
+    if (job.kind == TransferEngine::Move)
+        sources = moveByRename(sources, errors);
+
+    plan(sources, errors);
+    report(true);
+
+    QSet<int> failedTops;
+    auto fail = [&](const Item &item) {
+        if (job.cancelled.load() || failedTops.contains(item.top))
+            return;
+        errors.append("Unable to paste: " + QFileInfo(item.source).fileName());
+        failedTops.insert(item.top);
+    };
+
+    // Every selected item gets its name before anything is written. Files
+    // are claimed as empty placeholders that the copy then fills in.
+    for (int top = 0; top < tops.size(); ++top) {
+        if (job.cancelled.load())
+            break;
+        if (!claimTop(top))
+            fail(items.at(topItems.at(top)));
+    }
+
+    // Folders first, so the small file batch never waits on one
+    for (const Item &item : std::as_const(items)) {
+        if (job.cancelled.load())
+            break;
+        if (item.type == DirItem && !failedTops.contains(item.top) && !copyItem(item))
+            fail(item);
+    }
+
+    const QSet<int> batched = copySmallFiles(failedTops, fail);
+
+    for (int i = 0; i < items.size(); ++i) {
+        const Item &item = items.at(i);
+        if (job.cancelled.load())
+            break;
+        checkPause();
+
+        if (item.type == DirItem || batched.contains(i) || failedTops.contains(item.top))
+            continue;
+
+        if (!copyItem(item))
+            fail(item);
+    }
+
+    // Placeholders of files that were never copied
+    if (job.cancelled.load()) {
+        for (int top = 0; top < tops.size(); ++top) {
+            const Item &item = items.at(topItems.at(top));
+            if (item.type == FileItem && !failedTops.contains(top)) {
+                QFileInfo target(item.target);
+                if (target.exists() && target.size() == 0 && item.size > 0)
+                    QFile::remove(item.target);
+            }
+        }
+    }
+
+    // Cut across file systems: remove originals only once their copy checks out
+    if (job.kind == TransferEngine::Move && !job.cancelled.load()) {
+        for (int i = 0; i < tops.size(); ++i) {
+            if (failedTops.contains(i))
+                continue;
+            const QString name = QFileInfo(tops.at(i)).fileName();
+            if (!verifyTop(i))
+                errors.append("Copy of " + name + " could not be verified, original kept");
+            else if (!removeTop(i))
+                errors.append("Some items in " + name + " changed during the move and were left in place");
+        }
+    }
+}
+
+void TransferRunner::trash(QStringList &errors)
+{
+    progress.filesTotal = int(job.sources.size());
+
+    for (const QString &source : std::as_const(job.sources)) {
+        if (job.cancelled.load())
+            break;
+        checkPause();
+
+        progress.currentFile = source;
+        QString error;
+        if (!Trash::moveToTrash(source, &error))
+            errors.append("Unable to move " + QFileInfo(source).fileName() + " to the trash: " + error);
+
+        ++progress.filesDone;
+        report();
+    }
+}
+
+// Permanent delete. The walker threads unlink files as they find them;
+// folders are removed afterwards, one depth level at a time from the
+// deepest, with the levels spread over the thread pool as well.
+void TransferRunner::purge(QStringList &errors)
+{
+    QMutex lock;
+    QStringList dirs;
+    QStringList failures;
+    std::atomic<int> failureCount { 0 };
+    std::atomic<int> removed { 0 };
+
+    auto fail = [&](const QString &path) {
+        if (++failureCount > MaxReportedFailures)
+            return;
+        QMutexLocker locker(&lock);
+        failures.append("Unable to delete: " + path);
+    };
+
+    // Only one thread reports at a time; the others just honour a pause
+    QMutex reportLock;
+    auto tick = [&]() {
+        const int count = ++removed;
+        if (reportLock.tryLock()) {
+            progress.filesDone = count;
+            checkPause();
+            report();
+            reportLock.unlock();
+        } else {
+            job.waitWhilePaused();
+        }
+    };
+
+    QStringList roots;
+    for (const QString &source : std::as_const(job.sources)) {
+        QFileInfo info(source);
+        if (info.isDir() && !info.isSymLink()) {
+            roots.append(QDir::cleanPath(info.absoluteFilePath()));
+            dirs.append(roots.last());
+        } else if (info.exists() || info.isSymLink()) {
+            progress.currentFile = source;
+            if (!QFile::remove(source))
+                fail(source);
+            tick();
+        }
+    }
+
+    ParallelWalker walker;
+    walker.setFilters(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files | QDir::Hidden
+                      | QDir::System);
+    walker.setCancelCheck([this]() { return job.cancelled.load(); });
+    walker.walk(roots, [&](const WalkEntry &entry) {
+        if (entry.isDir && !entry.isSymLink) {
+            QMutexLocker locker(&lock);
+            dirs.append(entry.filePath());
+            return true;
+        }
+
+#ifdef Q_OS_LINUX
+        const QByteArray name = entry.rawName.toByteArray();
+        if (::unlinkat(entry.dirFd, name.constData(), 0) != 0 && errno != ENOENT)
+            fail(entry.filePath());
+#else
+        if (!QFile::remove(entry.filePath()))
+            fail(entry.filePath());
+#endif
+        tick();
+        return true;
+    });
+
+    // Children before parents: deepest level first
+    QMap<int, QStringList> levels;
+    for (const QString &dir : std::as_const(dirs))
+        levels[int(dir.count('/'))].append(dir);
+
+    for (auto it = levels.crbegin(); it != levels.crend() && !job.cancelled.load(); ++it) {
+        QtConcurrent::blockingMap(it.value(), [&](const QString &dir) {
+            if (job.cancelled.load())
+                return;
+            // Once something failed, its folders cannot go either; only
+            // the first failure is worth reporting.
+            if (!QDir().rmdir(dir) && QFileInfo::exists(dir) && failureCount.load() == 0)
+                fail(dir);
+            tick();
+        });
+    }
+
+    if (failureCount.load() > MaxReportedFailures)
+        failures.append(QString("%1 more items could not be deleted")
+                            .arg(failureCount.load() - MaxReportedFailures));
+    errors.append(failures);
+}
+
+// Two jobs pasting the same name must not pick the same target. The kernel
+// refuses an existing name atomically (O_EXCL, mkdir, symlink), so the name
+// is claimed by creating it, and the next free "_copy" name is tried when
+// someone got there first. Everything under a claimed folder follows it.
+bool TransferRunner::claimTop(int top)
+{
+    Item &item = items[topItems.at(top)];
+    const QString wanted = item.target;
+    const QFileInfo wantedInfo(wanted);
+    const QString dir = wantedInfo.absolutePath();
+
+    QString target = wanted;
+    for (int attempt = 0; attempt < MaxClaimAttempts; ++attempt) {
+        bool claimed = false;
+        switch (item.type) {
+        case DirItem:
+            claimed = QDir().mkdir(target);
+            break;
+        case LinkItem:
+            claimed = createLink(linkText(item.source), target);
+            break;
+        case FileItem: {
+            QFile placeholder(target);
+            claimed = placeholder.open(QIODevice::WriteOnly | QIODevice::NewOnly);
+            break;
+        }
+        }
+
+        if (claimed) {
+            if (target != wanted) {
+                for (Item &other : items) {
+                    if (other.top == top)
+                        other.target = target + other.target.mid(wanted.size());
+                }
+            }
+            return true;
+        }
+
+        // Anything but a taken name is a real error
+        QFileInfo taken(target);
+        if (!taken.exists() && !taken.isSymLink())
+            return false;
+        target = dir + "/" + TransferEngine::uniqueName(dir, wantedInfo.fileName());
+    }
+    return false;
+}
+
+bool TransferRunner::copyItem(const Item &item)
+{
+    progress.currentFile = item.source;
+
+    // A selected folder or link was created when its name was claimed
+    switch (item.type) {
+    case DirItem:
+        return item.isTop || QDir().mkpath(item.target);
+    case LinkItem: {
+        bool ok = item.isTop || createLink(linkText(item.source), item.target);
+        ++progress.filesDone;
+        report();
+        return ok;
+    }
+    case FileItem:
+        break;
+    }
+
+    bool ok = copyFile(item.source, item.target);
+    ++progress.filesDone;
+    report();
+    return ok;
+}
+
+// Sends small files through one pipelined batch, where many are in flight
+// at once, and returns the indexes it reported on. Anything else is left
+// to the one-by-one loop, or has already failed its selected item.
+QSet<int> TransferRunner::copySmallFiles(const QSet<int> &failedTops,
+                                         const std::function<void(const Item &)> &fail)
+{
+    QList<int> indexes;
+    QList<SmallFileCopy::Task> tasks;
+    for (int i = 0; i < items.size(); ++i) {
+        const Item &item = items.at(i);
+        if (item.type == FileItem && item.size <= SmallFileCopy::SmallFileLimit
+            && !failedTops.contains(item.top)) {
+            indexes.append(i);
+            tasks.append({ item.source, item.target });
+        }
+    }
+
+    // Not worth setting up a pipeline for
+    if (tasks.size() < MinBatchedFiles || job.cancelled.load())
+        return {};
+
+    QSet<int> reported;
+    SmallFileCopy copier(MaxOpenFiles);
+    const bool finished = copier.copy(tasks, [&](int index, bool ok, qint64 bytes) {
+        const Item &item = items.at(indexes.at(index));
+        reported.insert(indexes.at(index));
+        progress.currentFile = item.source;
+        checkPause();
+        throttleFor(bytes);
+
+        if (!ok)
+            fail(item);
+
+        const QString name = SmallFileCopy::backendName(copier.backend());
+        if (!progress.methods.contains(name))
+            progress.methods.append(name);
+
+        progress.bytesDone += bytes;
+        ++progress.filesDone;
+        report();
+        return !job.cancelled.load();
+    });
+
+    // A task the batch never reported on was not copied, whatever the
+    // reason; it must not pass for done
+    if (!finished && !job.cancelled.load()) {
+        for (int i = 0; i < indexes.size(); ++i) {
+            if (!reported.contains(indexes.at(i)))
+                fail(items.at(indexes.at(i)));
+        }
+    }
+
+    return reported;
+}
+
+// Every planned item must exist at the target, with files the same size as
+// when they were planned and the source still at that size.
+bool TransferRunner::verifyTop(int top) const
+{
+    for (const Item &item : items) {
+        if (item.top != top)
+            continue;
+
+        QFileInfo target(item.target);
+        switch (item.type) {
+        case DirItem:
+            if (!target.isDir())
+                return false;
+            break;
+        case LinkItem:
+            if (!target.isSymLink())
+                return false;
+            break;
+        case FileItem:
+            if (!target.exists() || target.size() != item.size
+                || QFileInfo(item.source).size() != item.size)
+                return false;
+            break;
+        }
+    }
+    return true;
+}
+
+// Deletes only what was copied, children before parents, so anything that
+// appeared in the source meanwhile keeps its folder alive.
+bool TransferRunner::removeTop(int top)
+{
+    bool ok = true;
+    for (qsizetype i = items.size() - 1; i >= 0; --i) {
+        const Item &item = items.at(i);
+        if (item.top != top)
+            continue;
+        if (item.type == DirItem)
+            ok = QDir().rmdir(item.source) && ok;
+        else
+            ok = QFile::remove(item.source) && ok;
+    }
+    return ok;
+}
+
+bool TransferRunner::copyFile(const QString &source, const QString &target)
+{
+    return FastCopy::copyFile(source, target, [this](qint64 bytes, FastCopy::Method method) {
+        if (job.cancelled.load())
+            return false;
+        checkPause();
+
+        // A reflink moves no data, so it does not count against the limit
+        if (method != FastCopy::Reflink)
+            throttleFor(bytes);
+
+        const QString name = FastCopy::methodName(method);
+        if (!progress.methods.contains(name))
+            progress.methods.append(name);
+
+        progress.bytesDone += bytes;
+        report();
+        return !job.cancelled.load();
+    });
+}
+
+void TransferRunner::checkPause()
+{
+    if (!job.paused.load())
+        return;
+
+    emit engine->jobStateChanged(job.id, TransferEngine::Paused);
+    pausedMs += job.waitWhilePaused();
+    if (!job.cancelled.load())
+        emit engine->jobStateChanged(job.id, TransferEngine::Running);
+}
+
+// Sleeps in short slices so pause and cancel stay responsive under a
+// low bandwidth limit.
+void TransferRunner::throttleFor(qint64 bytes)
+{
+    qint64 waitMs = throttle.reserve(bytes);
+    while (waitMs > 0 && !job.cancelled.load()) {
+        const qint64 slice = qMin<qint64>(waitMs, 50);
+        QThread::msleep(slice);
+        waitMs -= slice;
+        report();
+    }
+}
+
+void TransferRunner::report(bool force)
+{
+    if (!force && lastReport.elapsed() < ProgressIntervalMs)
+        return;
+    lastReport.restart();
+
+    const qint64 activeMs = qMax<qint64>(1, clock.elapsed() - pausedMs);
+    progress.bytesPerSecond = progress.bytesDone * 1000.0 / activeMs;
+    progress.etaSeconds = progress.bytesPerSecond > 0
+        ? qint64((progress.bytesTotal - progress.bytesDone) / progress.bytesPerSecond)
+        : -1;
+
+    emit engine->jobProgress(job.id, progress);
+}
+
+} // namespace
+
+//-------------------------------------------
+// Engine
+//-------------------------------------------
+TransferEngine::TransferEngine(QObject *parent)
+    : QObject(parent),
+      pool(new QThreadPool(this)),
+      deletePool(new QThreadPool(this)),
+      throttle(new TransferThrottle)
+{
+    pool->setMaxThreadCount(DefaultConcurrentJobs);
+    deletePool->setMaxThreadCount(ConcurrentDeleteJobs);
+}
+
+TransferEngine::~TransferEngine()
+{
+    for (const QSharedPointer<TransferJob> &job : std::as_const(jobs)) {
+        job->cancelled = true;
+        job->resumed.wakeAll();
+    }
+    pool->waitForDone();
+    deletePool->waitForDone();
+}
+
+int TransferEngine::enqueue(JobKind kind, const QStringList &sources,
+                            const QString &destinationDir)
+{
+    QSharedPointer<TransferJob> job(new TransferJob);
+    job->id = nextId++;
+    job->kind = kind;
+    job->sources = sources;
+    job->destinationDir = destinationDir;
+    jobs.insert(job->id, job);
+
+    emit jobAdded(job->id, kind, sources, destinationDir);
+    emit jobStateChanged(job->id, Queued);
+
+    // A trash or delete is quick and should not queue behind long copies
+    QThreadPool *lane = (kind == Trash || kind == Delete) ? deletePool : pool;
+    lane->start([this, job]() { run(job); });
+    return job->id;
+}
+
+void TransferEngine::run(QSharedPointer<TransferJob> job)
+{
+    QStringList errors;
+
+    if (!job->cancelled.load()) {
+        emit jobStateChanged(job->id, Running);
+        TransferRunner runner(this, *job, *throttle);
+        runner.run(errors);
+    }
+
+    JobState state = job->cancelled.load() ? Cancelled
+                     : errors.isEmpty()    ? Finished
+                                           : Failed;
+    emit jobStateChanged(job->id, state);
+    emit jobFinished(job->id, state == Finished, errors);
+
+    const int id = job->id;
+    QMetaObject::invokeMethod(this, [this, id]() { jobs.remove(id); },
+                              Qt::QueuedConnection);
+}
+
+void TransferEngine::pause(int id)
+{
+    if (QSharedPointer<TransferJob> job = jobs.value(id))
+        job->paused = true;
+}
+
+void TransferEngine::resume(int id)
+{
+    if (QSharedPointer<TransferJob> job = jobs.value(id)) {
+        QMutexLocker locker(&job->pauseLock);
+        job->paused = false;
+        job->resumed.wakeAll();
+    }
+}
+
+void TransferEngine::cancel(int id)
+{
+    if (QSharedPointer<TransferJob> job = jobs.value(id)) {
+        QMutexLocker locker(&job->pauseLock);
+        job->cancelled = true;
+        job->resumed.wakeAll();
+    }
+}
+
+void TransferEngine::setBandwidthLimit(qint64 bytesPerSecond)
+{
+    throttle->setLimit(bytesPerSecond);
+}
+
+qint64 TransferEngine::bandwidthLimit() const
+{
+    return throttle->limit();
+}
+
+void TransferEngine::setMaxConcurrentJobs(int count)
+{
+    pool->setMaxThreadCount(qMax(1, count));
+}
+
+QString TransferEngine::uniqueName(const QString &dirPath, const QString &fileName)
+{
+    QFileInfo info(fileName);
+    QString base = info.completeBaseName();
+    QString ext  = info.suffix();
+
+    QString newName = base + "_copy";
+    if (!ext.isEmpty())
+        newName += "." + ext;
+
+    int counter = 1;
+    QString fullPath = dirPath + "/" + newName;
+
+    while (QFile::exists(fullPath)) {
+        newName = base + "_copy_" + QString::number(counter++);
+        if (!ext.isEmpty())
+            newName += "." + ext;
+        fullPath = dirPath + "/" + newName;
+    }
+
+    return newName;
+}
@@ -0,0 +1,98 @@
+#ifndef TRANSFERENGINE_H
+#define TRANSFERENGINE_H
+
+#include <QObject>
+#include <QStringList>
+#include <QHash>
+#include <QSharedPointer>
+#include <QMetaType>
+
+class QThreadPool;
+class TransferJob;
+class TransferThrottle;
+
+struct TransferProgress
+{
+    qint64 bytesDone = 0;
+    qint64 bytesTotal = 0;
+    int filesDone = 0;
+    int filesTotal = 0;
+    double bytesPerSecond = 0;
+    qint64 etaSeconds = -1;    // -1 while unknown
+    QString currentFile;
+    QStringList methods;       // copy mechanisms used so far, see FastCopy
+};
+Q_DECLARE_METATYPE(TransferProgress)
+
+// Copies and moves files on background threads.
+//
+// Pastes are queued as jobs and run on a small private pool, so a few can
+// proceed together while the rest wait their turn. Each job reports bytes,
+// files, throughput and ETA through signals and can be paused, resumed or
+// cancelled. An optional bandwidth limit is shared by all running jobs.
+// File data goes through FastCopy, and the mechanisms it picked are
+// reported with the progress.
+//
+// Deleting runs as a job too: Trash moves items into the trash, Delete
+// removes them for good with the walker threads unlinking in parallel.
+// Both have a pool of their own, so they never wait behind copies.
+class TransferEngine : public QObject
+{
+    Q_OBJECT
+public:
+    enum JobKind {
+        Copy,
+        Move,
+        Trash,
+        Delete
+    };
+    Q_ENUM(JobKind)
+
+    enum JobState {
+        Queued,
+        Running,
+        Paused,
+        Finished,
+        Failed,
+        Cancelled
+    };
+    Q_ENUM(JobState)
+
+    explicit TransferEngine(QObject *parent = nullptr);
+    ~TransferEngine() override;
+
+    // destinationDir is ignored for Trash and Delete
+    int enqueue(JobKind kind, const QStringList &sources,
+                const QString &destinationDir = QString());
+
+    void pause(int id);
+    void resume(int id);
+    void cancel(int id);
+
+    // Bytes per second across all jobs; 0 means unlimited
+    void setBandwidthLimit(qint64 bytesPerSecond);
+    qint64 bandwidthLimit() const;
+
+    // Copies and moves only; deletes have their own lane
+    void setMaxConcurrentJobs(int count);
+
+    static QString uniqueName(const QString &dirPath, const QString &fileName);
+
+signals:
+    void jobAdded(int id, TransferEngine::JobKind kind, const QStringList &sources,
+                  const QString &destinationDir);
+    void jobProgress(int id, const TransferProgress &progress);
+    void jobStateChanged(int id, TransferEngine::JobState state);
+    void jobFinished(int id, bool success, const QStringList &errors);
+
+private:
+    void run(QSharedPointer<TransferJob> job);
+
+    QThreadPool *pool;          // copies and moves
+    QThreadPool *deletePool;    // trash and delete
+    QSharedPointer<TransferThrottle> throttle;
+    QHash<int, QSharedPointer<TransferJob>> jobs;
+    int nextId = 1;
+};
+
+#endif
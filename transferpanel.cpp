@@ -0,0 +1,204 @@
+#include "transferpanel.h"
+
+#include <QTreeWidget>
+#include <QTreeWidgetItem>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QLabel>
+#include <QLocale>
+#include <QFileInfo>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+
+namespace {
+
+enum Column {
+    NameColumn,
+    ProgressColumn,
+    FilesColumn,
+    SpeedColumn,
+    EtaColumn,
+    MethodColumn,
+    StateColumn
+};
+
+QString stateText(TransferEngine::JobState state)
+{
+    switch (state) {
+    case TransferEngine::Queued:    return "Queued";
+    case TransferEngine::Running:   return "Running";
+    case TransferEngine::Paused:    return "Paused";
+    case TransferEngine::Finished:  return "Done";
+    case TransferEngine::Failed:    return "Failed";
+    case TransferEngine::Cancelled: return "Cancelled";
+    }
+    return QString();
+}
+
+QString kindText(TransferEngine::JobKind kind)
+{
+    switch (kind) {
+    case TransferEngine::Copy:   return "Copy";
+    case TransferEngine::Move:   return "Move";
+    case TransferEngine::Trash:  return "Trash";
+    case TransferEngine::Delete: return "Delete";
+    }
+    return QString();
+}
+
+QString etaText(qint64 seconds)
+{
+    if (seconds < 0)
+        return "—";
+    if (seconds < 60)
+        return QString("%1 s").arg(seconds);
+    if (seconds < 3600)
+        return QString("%1 min %2 s").arg(seconds / 60).arg(seconds % 60);
+    return QString("%1 h %2 min").arg(seconds / 3600).arg((seconds % 3600) / 60);
+}
+
+} // namespace
+
+TransferPanel::TransferPanel(TransferEngine *engine, QWidget *parent)
+    : QWidget(parent), engine(engine)
+{
+    jobList = new QTreeWidget(this);
+    jobList->setRootIsDecorated(false);
+    jobList->setHeaderLabels({ "Transfer", "Progress", "Files", "Speed", "ETA", "Method", "State" });
+
+    QPushButton *pauseBtn = new QPushButton("Pause", this);
+    QPushButton *resumeBtn = new QPushButton("Resume", this);
+    QPushButton *cancelBtn = new QPushButton("Cancel", this);
+    QPushButton *clearBtn = new QPushButton("Clear Finished", this);
+
+    limitBox = new QSpinBox(this);
+    limitBox->setRange(0, 100000);
+    limitBox->setSuffix(" MB/s");
+    limitBox->setSpecialValueText("Unlimited");
+    limitBox->setToolTip("Bandwidth shared by all running transfers");
+
+    connect(pauseBtn, &QPushButton::clicked, this, [=]() {
+        if (int id = selectedJob())
+            engine->pause(id);
+    });
+    connect(resumeBtn, &QPushButton::clicked, this, [=]() {
+        if (int id = selectedJob())
+            engine->resume(id);
+    });
+    connect(cancelBtn, &QPushButton::clicked, this, [=]() {
+        if (int id = selectedJob())
+            engine->cancel(id);
+    });
+    connect(clearBtn, &QPushButton::clicked, this, &TransferPanel::clearFinished);
+    connect(limitBox, &QSpinBox::valueChanged, this, [=](int mb) {
+        engine->setBandwidthLimit(qint64(mb) * 1024 * 1024);
+    });
+
+    connect(engine, &TransferEngine::jobAdded, this, &TransferPanel::onJobAdded);
+    connect(engine, &TransferEngine::jobProgress, this, &TransferPanel::onJobProgress);
+    connect(engine, &TransferEngine::jobStateChanged, this, &TransferPanel::onJobStateChanged);
+
+    QHBoxLayout *buttons = new QHBoxLayout();
+    buttons->addWidget(pauseBtn);
+    buttons->addWidget(resumeBtn);
+    buttons->addWidget(cancelBtn);
+    buttons->addWidget(clearBtn);
+    buttons->addStretch();
+    buttons->addWidget(new QLabel("Limit:", this));
+    buttons->addWidget(limitBox);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(jobList);
+    layout->addLayout(buttons);
+}
+
+int TransferPanel::selectedJob() const
+{
+    QTreeWidgetItem *item = jobList->currentItem();
+    return item ? item->data(NameColumn, Qt::UserRole).toInt() : 0;
+}
+
+void TransferPanel::onJobAdded(int id, TransferEngine::JobKind kind,
+                               const QStringList &sources, const QString &destinationDir)
+{
+    QString what = sources.size() == 1
+                       ? QFileInfo(sources.first()).fileName()
+                       : QString("%1 items").arg(sources.size());
+
+    QTreeWidgetItem *item = new QTreeWidgetItem(jobList);
+    if (destinationDir.isEmpty())
+        item->setText(NameColumn, kindText(kind) + " " + what);
+    else
+        item->setText(NameColumn, QString("%1 %2 → %3").arg(kindText(kind), what, destinationDir));
+    item->setToolTip(NameColumn, sources.join('\n'));
+    item->setData(NameColumn, Qt::UserRole, id);
+
+    // A permanent delete does not count its entries up front
+    QProgressBar *bar = new QProgressBar(jobList);
+    bar->setRange(0, kind == TransferEngine::Delete ? 0 : 1000);
+    bar->setValue(0);
+    jobList->setItemWidget(item, ProgressColumn, bar);
+
+    items.insert(id, item);
+    bars.insert(id, bar);
+}
+
+void TransferPanel::onJobProgress(int id, const TransferProgress &progress)
+{
+    QTreeWidgetItem *item = items.value(id);
+    if (!item)
+        return;
+
+    QLocale locale;
+    if (progress.bytesTotal > 0)
+        bars.value(id)->setValue(int(progress.bytesDone * 1000 / progress.bytesTotal));
+    else if (progress.filesTotal > 0)
+        bars.value(id)->setValue(int(qint64(progress.filesDone) * 1000 / progress.filesTotal));
+
+    item->setText(FilesColumn, progress.filesTotal > 0
+                                   ? QString("%1 / %2").arg(progress.filesDone).arg(progress.filesTotal)
+                                   : QString::number(progress.filesDone));
+    item->setText(SpeedColumn, locale.formattedDataSize(qint64(progress.bytesPerSecond)) + "/s");
+    item->setText(EtaColumn, etaText(progress.etaSeconds));
+    item->setText(MethodColumn, progress.methods.join(", "));
+    item->setToolTip(ProgressColumn, QString("%1 of %2\n%3")
+                                         .arg(locale.formattedDataSize(progress.bytesDone))
+                                         .arg(locale.formattedDataSize(progress.bytesTotal))
+                                         .arg(progress.currentFile));
+}
+
+void TransferPanel::onJobStateChanged(int id, TransferEngine::JobState state)
+{
+    QTreeWidgetItem *item = items.value(id);
+    if (!item)
+        return;
+
+    states.insert(id, state);
+    item->setText(StateColumn, stateText(state));
+
+    QProgressBar *bar = bars.value(id);
+    if (state == TransferEngine::Finished || state == TransferEngine::Failed
+        || state == TransferEngine::Cancelled) {
+        if (bar->maximum() == 0)
+            bar->setRange(0, 1000);   // stop the busy indicator
+        if (state == TransferEngine::Finished)
+            bar->setValue(bar->maximum());
+    }
+}
+
+void TransferPanel::clearFinished()
+{
+    for (auto it = states.begin(); it != states.end();) {
+        TransferEngine::JobState state = it.value();
+        if (state == TransferEngine::Finished || state == TransferEngine::Failed
+            || state == TransferEngine::Cancelled) {
+            delete items.take(it.key());   // also deletes the item widget
+            bars.remove(it.key());
+            it = states.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
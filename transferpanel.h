@@ -0,0 +1,40 @@
+#ifndef TRANSFERPANEL_H
+#define TRANSFERPANEL_H
+
+#include <QWidget>
+#include <QHash>
+
+#include "transferengine.h"
+
+class QTreeWidget;
+class QTreeWidgetItem;
+class QProgressBar;
+class QSpinBox;
+
+// Lists the jobs of a TransferEngine with their progress and lets the user
+// pause, resume or cancel them and set the shared bandwidth limit.
+class TransferPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit TransferPanel(TransferEngine *engine, QWidget *parent = nullptr);
+
+private slots:
+    void onJobAdded(int id, TransferEngine::JobKind kind, const QStringList &sources,
+                    const QString &destinationDir);
+    void onJobProgress(int id, const TransferProgress &progress);
+    void onJobStateChanged(int id, TransferEngine::JobState state);
+    void clearFinished();
+
+private:
+    int selectedJob() const;
+
+    TransferEngine *engine;
+    QTreeWidget *jobList;
+    QSpinBox *limitBox;
+    QHash<int, QTreeWidgetItem *> items;
+    QHash<int, QProgressBar *> bars;
+    QHash<int, TransferEngine::JobState> states;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "trash.h"
+#include "fastcopy.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QUrl>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+const int MaxNameAttempts = 1000;
+
+bool lstatPath(const QString &path, struct stat &st)
+{
+    return ::lstat(QFile::encodeName(path).constData(), &st) == 0;
+}
+
+// Creates dir (mode 0700) unless it exists; refuses symlinks
+bool ensurePrivateDir(const QString &dir)
+{
+    const QByteArray encoded = QFile::encodeName(dir);
+    if (::mkdir(encoded.constData(), 0700) == 0)
+        return true;
+    if (errno != EEXIST)
+        return false;
+
+    struct stat st;
+    return ::lstat(encoded.constData(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// The highest folder above path that is still on the same device
+QString mountTopDir(const QString &path, dev_t device)
+{
+    QString dir = QFileInfo(path).absolutePath();
+    for (;;) {
+        const QString parent = QFileInfo(dir).absolutePath();
+        struct stat st;
+        if (parent == dir || !lstatPath(parent, st) || st.st_dev != device)
+            return dir;
+        dir = parent;
+    }
+}
+
+// The trash that can take path with a rename, or empty if there is none
+QString trashDirFor(const QString &path, QString *errorString)
+{
+    struct stat item;
+    if (!lstatPath(path, item)) {
+        *errorString = QString::fromLocal8Bit(std::strerror(errno));
+        return QString();
+    }
+
+    const QString dataHome = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    struct stat home;
+    if (!dataHome.isEmpty() && QDir().mkpath(dataHome) && lstatPath(dataHome, home)
+        && home.st_dev == item.st_dev) {
+        const QString trash = dataHome + "/Trash";
+        if (ensurePrivateDir(trash))
+            return trash;
+    }
+
+    const QString topDir = mountTopDir(path, item.st_dev);
+    const QString uid = QString::number(::getuid());
+
+    // An admin-provided $topdir/.Trash must be a real, sticky folder
+    struct stat shared;
+    const QString sharedTrash = topDir + "/.Trash";
+    if (lstatPath(sharedTrash, shared) && S_ISDIR(shared.st_mode) && (shared.st_mode & S_ISVTX)
+        && ensurePrivateDir(sharedTrash + "/" + uid))
+        return sharedTrash + "/" + uid;
+
+    const QString userTrash = topDir + "/.Trash-" + uid;
+    struct stat own;
+    if (ensurePrivateDir(userTrash) && lstatPath(userTrash, own) && own.st_uid == ::getuid())
+        return userTrash;
+
+    *errorString = "No trash folder is available on this drive";
+    return QString();
+}
+
+bool writeInfo(int fd, const QString &path)
+{
+    const QByteArray info =
+        "[Trash Info]\nPath=" + QUrl::toPercentEncoding(QFileInfo(path).absoluteFilePath(), "/")
+        + "\nDeletionDate="
+        + QDateTime::currentDateTime().toString("yyyy-MM-dd'T'hh:mm:ss").toLatin1() + "\n";
+    return ::write(fd, info.constData(), size_t(info.size())) == info.size();
+}
+#endif
+
+} // namespace
+
+bool Trash::moveToTrash(const QString &path, QString *errorString)
+{
+    QString error;
+    if (!errorString)
+        errorString = &error;
+
+#ifdef Q_OS_LINUX
+    const QString trash = trashDirFor(path, errorString);
+    if (trash.isEmpty())
+        return false;
+    if (!ensurePrivateDir(trash + "/files") || !ensurePrivateDir(trash + "/info")) {
+        *errorString = "Cannot create the trash folder " + trash;
+        return false;
+    }
+
+    const QString fileName = QFileInfo(path).fileName();
+    for (int attempt = 1; attempt <= MaxNameAttempts; ++attempt) {
+        const QString name = attempt == 1
+                                 ? fileName
+                                 : QString("%1.%2").arg(fileName, QString::number(attempt));
+
+        // Claiming the .trashinfo name first is what makes the name ours
+        const QByteArray infoPath = QFile::encodeName(trash + "/info/" + name + ".trashinfo");
+        int fd = ::open(infoPath.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            if (errno == EEXIST)
+                continue;
+            *errorString = QString::fromLocal8Bit(std::strerror(errno));
+            return false;
+        }
+
+        const bool written = writeInfo(fd, path);
+        if (::close(fd) != 0 || !written) {
+            ::unlink(infoPath.constData());
+            *errorString = "Cannot write the trash info file";
+            return false;
+        }
+
+        switch (FastCopy::renameNoReplace(path, trash + "/files/" + name)) {
+        case FastCopy::Renamed:
+            return true;
+        case FastCopy::TargetExists:   // a stray file without info
+            ::unlink(infoPath.constData());
+            continue;
+        case FastCopy::CrossDevice:
+        case FastCopy::RenameFailed:
+            *errorString = QString::fromLocal8Bit(std::strerror(errno));
+            ::unlink(infoPath.constData());
+            return false;
+        }
+    }
+
+    *errorString = "Too many items with this name in the trash";
+    return false;
+#else
+    if (QFile::moveToTrash(path))
+        return true;
+    *errorString = "The item could not be moved to the trash";
+    return false;
+#endif
+}
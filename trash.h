@@ -0,0 +1,20 @@
+#ifndef TRASH_H
+#define TRASH_H
+
+#include <QString>
+
+// Moves files and folders into the desktop trash.
+//
+// On Linux this follows the freedesktop.org trash spec: items on the home
+// file system go to $XDG_DATA_HOME/Trash, items on other mounts go to
+// $topdir/.Trash/$uid or $topdir/.Trash-$uid. Either way the item stays on
+// its own file system, so trashing is a single rename however large it is.
+// An .trashinfo file records where it came from so it can be restored.
+// Elsewhere QFile::moveToTrash() does the work.
+class Trash
+{
+public:
+    static bool moveToTrash(const QString &path, QString *errorString = nullptr);
+};
+
+#endif